@@ -4,7 +4,9 @@
 #include "lib.cartilage/libcartilage.h" /* for glthread, an impl of doubly linked list */
 
 #include <pthread.h> /* for POSIX threads and related functionality */
+#include <stdatomic.h> /* for lock-free work queue positions */
 #include <stdbool.h> /* for common boolean typedefs */
+#include <stddef.h> /* for size_t */
 #include <stdint.h> /* for extended type signatures */
 
 /* Thread Flags */
@@ -91,6 +93,79 @@ typedef struct thread_pool {
 	pthread_mutex_t mutex;
 } thread_pool_t;
 
+/**
+ * @brief A routine and its argument, queued for execution by a work queue
+ * worker
+ */
+typedef struct work_task {
+	void* (*routine)(void*);
+	void* arg;
+} work_task_t;
+
+/**
+ * @brief A slot in a work queue's ring buffer
+ */
+typedef struct work_cell {
+	/* Tells producers and consumers whose turn it is to use the slot */
+	atomic_size_t sequence;
+	work_task_t task;
+} work_cell_t;
+
+/**
+ * @brief A bounded, lock-free, multi-producer multi-consumer task queue
+ * drained by a fixed set of worker threads. Idle workers spin briefly, then
+ * park on a futex (or a condition variable where futexes are unavailable)
+ */
+typedef struct work_queue {
+	/* Ring buffer of `mask + 1` slots */
+	work_cell_t* cells;
+	size_t mask;
+	/* Claimed by producers and consumers respectively; kept on separate cache
+	 * lines so that they don't contend */
+	_Alignas(64) atomic_size_t enqueue_pos;
+	_Alignas(64) atomic_size_t dequeue_pos;
+	/* Bumped on every push; idle workers park on it */
+	_Alignas(64) _Atomic uint32_t task_signal;
+	_Atomic uint32_t idle_workers;
+	/* Bumped on every pop; producers waiting on a full queue park on it */
+	_Atomic uint32_t space_signal;
+	_Atomic uint32_t waiting_producers;
+#ifndef __linux__
+	pthread_mutex_t park_mutex;
+	pthread_cond_t park_cv;
+#endif
+} work_queue_t;
+
+/**
+ * @brief A double-ended task queue owned by a single steal pool worker
+ */
+typedef struct steal_deque {
+	/* Guards the deque against its owner and thieves alike */
+	pthread_mutex_t mutex;
+	/* Ring buffer of `capacity` tasks, `count` of which start at `head` */
+	work_task_t* tasks;
+	size_t capacity;
+	size_t head;
+	size_t count;
+} steal_deque_t;
+
+/**
+ * @brief A work-stealing pool: each worker thread owns a deque of tasks and,
+ * once its own deque runs dry, steals from the back of its peers' deques
+ * before parking
+ */
+typedef struct steal_pool {
+	steal_deque_t* deques;
+	uint32_t num_workers;
+	/* Round-robin cursor for tasks submitted from outside the pool */
+	atomic_uint next_deque;
+	/* Tasks queued across every deque */
+	_Atomic uint32_t pending;
+	_Atomic uint32_t idle_workers;
+	pthread_mutex_t park_mutex;
+	pthread_cond_t park_cv;
+} steal_pool_t;
+
 /**
  * @brief Represents thread execution data for
  * different states
@@ -159,4 +234,30 @@ bool thread_pool_dispatch(
 	bool block_caller
 );
 
+/* Work Queue API */
+
+bool work_queue_init(work_queue_t* queue, size_t capacity, uint32_t num_workers);
+
+bool work_queue_try_push(
+	work_queue_t* queue,
+	void*(*routine)(void*),
+	void* arg
+);
+
+void work_queue_push(
+	work_queue_t* queue,
+	void*(*routine)(void*),
+	void* arg
+);
+
+/* Work-Stealing Pool API */
+
+bool steal_pool_init(steal_pool_t* pool, uint32_t num_workers);
+
+void steal_pool_submit(
+	steal_pool_t* pool,
+	void*(*routine)(void*),
+	void* arg
+);
+
 #endif /* LIB_THREAD_H */
@@ -0,0 +1,282 @@
+#include <sched.h>  /* for sched_yield */
+#include <stdlib.h> /* for calloc, et al */
+
+#include "libthread.h"
+
+/* Number of times an idle worker sweeps its peers' deques before parking */
+#define STEAL_POOL_SPIN_LIMIT 64
+
+/* Initial number of slots in each worker's deque */
+#define STEAL_DEQUE_INITIAL_CAPACITY 64
+
+/**
+ * @brief Startup data for a single steal pool worker
+ */
+typedef struct steal_worker {
+  steal_pool_t* pool;
+  uint32_t index;
+} steal_worker_t;
+
+/* The pool the calling thread works for, if any, and the index of its deque */
+static _Thread_local steal_pool_t* current_pool = NULL;
+static _Thread_local uint32_t current_index = 0;
+
+/* Local Helpers Declarations */
+static bool steal_deque_init(steal_deque_t* deque);
+static void steal_deque_push_back(steal_deque_t* deque, void* (*routine)(void*),
+                                  void* arg);
+static bool steal_deque_pop_front(steal_deque_t* deque, work_task_t* task);
+static bool steal_deque_pop_back(steal_deque_t* deque, work_task_t* task);
+static bool steal_pool_find_task(steal_pool_t* pool, uint32_t index,
+                                 work_task_t* task);
+static void* steal_pool_worker(void* arg);
+
+/* Public API */
+
+/**
+ * @brief Initialize a work-stealing pool and start `num_workers` detached
+ * worker threads, each with a deque of its own
+ *
+ * @param pool
+ * @param num_workers
+ *
+ * @return bool Indicates whether the pool and its workers were created
+ */
+bool steal_pool_init(steal_pool_t* pool, uint32_t num_workers) {
+  if (num_workers == 0) return false;
+
+  if (!(pool->deques = calloc(num_workers, sizeof(steal_deque_t)))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < num_workers; i++) {
+    if (!steal_deque_init(&pool->deques[i])) return false;
+  }
+
+  pool->num_workers = num_workers;
+  atomic_init(&pool->next_deque, 0);
+  atomic_init(&pool->pending, 0);
+  atomic_init(&pool->idle_workers, 0);
+  pthread_mutex_init(&pool->park_mutex, NULL);
+  pthread_cond_init(&pool->park_cv, NULL);
+
+  for (uint32_t i = 0; i < num_workers; i++) {
+    steal_worker_t* worker = malloc(sizeof(steal_worker_t));
+    if (!worker) return false;
+
+    worker->pool = pool;
+    worker->index = i;
+
+    thread_t* thread = thread_init(0, "steal pool worker");
+    thread_set_attr(thread, false);
+
+    if (!thread_run(thread, steal_pool_worker, worker)) return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Submit a task to the pool. A task submitted by one of the pool's own
+ * workers lands on that worker's deque; any other is spread round-robin
+ * across the workers
+ *
+ * @param pool
+ * @param routine
+ * @param arg
+ */
+void steal_pool_submit(steal_pool_t* pool, void* (*routine)(void*),
+                       void* arg) {
+  uint32_t index = current_pool == pool
+                       ? current_index
+                       : atomic_fetch_add(&pool->next_deque, 1) %
+                             pool->num_workers;
+
+  // Count the task before it becomes visible, so that a worker that takes it
+  // straight away never sees `pending` underflow
+  atomic_fetch_add(&pool->pending, 1);
+  steal_deque_push_back(&pool->deques[index], routine, arg);
+
+  if (atomic_load(&pool->idle_workers) > 0) {
+    pthread_mutex_lock(&pool->park_mutex);
+    pthread_cond_signal(&pool->park_cv);
+    pthread_mutex_unlock(&pool->park_mutex);
+  }
+}
+
+/* Helpers */
+
+/**
+ * @brief Initialize an empty deque
+ *
+ * @param deque
+ *
+ * @return bool Indicates whether the deque's buffer was allocated
+ */
+static bool steal_deque_init(steal_deque_t* deque) {
+  if (!(deque->tasks =
+            calloc(STEAL_DEQUE_INITIAL_CAPACITY, sizeof(work_task_t)))) {
+    return false;
+  }
+
+  deque->capacity = STEAL_DEQUE_INITIAL_CAPACITY;
+  deque->head = 0;
+  deque->count = 0;
+  pthread_mutex_init(&deque->mutex, NULL);
+
+  return true;
+}
+
+/**
+ * @brief Append a task to the back of a deque, growing it if it is full
+ *
+ * @param deque
+ * @param routine
+ * @param arg
+ */
+static void steal_deque_push_back(steal_deque_t* deque, void* (*routine)(void*),
+                                  void* arg) {
+  pthread_mutex_lock(&deque->mutex);
+
+  if (deque->count == deque->capacity) {
+    work_task_t* tasks = calloc(deque->capacity * 2, sizeof(work_task_t));
+    if (!tasks) abort();
+
+    // Unwrap the ring so that the front of the deque lands at index 0
+    for (size_t i = 0; i < deque->count; i++) {
+      tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+    }
+
+    free(deque->tasks);
+    deque->tasks = tasks;
+    deque->capacity *= 2;
+    deque->head = 0;
+  }
+
+  work_task_t* slot =
+      &deque->tasks[(deque->head + deque->count) % deque->capacity];
+  slot->routine = routine;
+  slot->arg = arg;
+  deque->count++;
+
+  pthread_mutex_unlock(&deque->mutex);
+}
+
+/**
+ * @brief Take the oldest task from the front of a deque. Used by the deque's
+ * owner, so that its tasks run in the order they were submitted
+ *
+ * @param deque
+ * @param task Receives the task
+ *
+ * @return bool Indicates whether a task was taken
+ */
+static bool steal_deque_pop_front(steal_deque_t* deque, work_task_t* task) {
+  pthread_mutex_lock(&deque->mutex);
+
+  bool found = deque->count > 0;
+  if (found) {
+    *task = deque->tasks[deque->head];
+    deque->head = (deque->head + 1) % deque->capacity;
+    deque->count--;
+  }
+
+  pthread_mutex_unlock(&deque->mutex);
+  return found;
+}
+
+/**
+ * @brief Take the newest task from the back of a deque. Used by thieves, which
+ * thereby take the tasks the owner would otherwise have reached last
+ *
+ * @param deque
+ * @param task Receives the task
+ *
+ * @return bool Indicates whether a task was taken
+ */
+static bool steal_deque_pop_back(steal_deque_t* deque, work_task_t* task) {
+  // Don't bother contending for the lock over an empty deque
+  if (__atomic_load_n(&deque->count, __ATOMIC_RELAXED) == 0) return false;
+
+  pthread_mutex_lock(&deque->mutex);
+
+  bool found = deque->count > 0;
+  if (found) {
+    deque->count--;
+    *task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+  }
+
+  pthread_mutex_unlock(&deque->mutex);
+  return found;
+}
+
+/**
+ * @brief Find the next task for the worker at `index`: first from its own
+ * deque, then from each of its peers' in turn
+ *
+ * @param pool
+ * @param index
+ * @param task Receives the task
+ *
+ * @return bool Indicates whether a task was found
+ */
+static bool steal_pool_find_task(steal_pool_t* pool, uint32_t index,
+                                 work_task_t* task) {
+  bool found = steal_deque_pop_front(&pool->deques[index], task);
+
+  for (uint32_t i = 1; i < pool->num_workers && !found; i++) {
+    found = steal_deque_pop_back(
+        &pool->deques[(index + i) % pool->num_workers], task);
+  }
+
+  if (found) atomic_fetch_sub(&pool->pending, 1);
+
+  return found;
+}
+
+/**
+ * @brief The worker thread routine: runs tasks from its own deque, steals
+ * from its peers once that runs dry, and parks when there is nothing left to
+ * steal
+ *
+ * @param arg The worker's steal_worker_t
+ * @return void*
+ */
+static void* steal_pool_worker(void* arg) {
+  steal_worker_t* worker = (steal_worker_t*)arg;
+  steal_pool_t* pool = worker->pool;
+  uint32_t index = worker->index;
+  free(worker);
+
+  current_pool = pool;
+  current_index = index;
+
+  work_task_t task;
+
+  while (1) {
+    bool found = false;
+
+    for (int i = 0; i < STEAL_POOL_SPIN_LIMIT && !found; i++) {
+      if (!(found = steal_pool_find_task(pool, index, &task))) sched_yield();
+    }
+
+    if (!found) {
+      atomic_fetch_add(&pool->idle_workers, 1);
+
+      // Submitters signal under the lock once they see we're idle, so checking
+      // `pending` under it too ensures we never miss a wakeup
+      pthread_mutex_lock(&pool->park_mutex);
+      while (atomic_load(&pool->pending) == 0) {
+        pthread_cond_wait(&pool->park_cv, &pool->park_mutex);
+      }
+      pthread_mutex_unlock(&pool->park_mutex);
+
+      atomic_fetch_sub(&pool->idle_workers, 1);
+      continue;
+    }
+
+    task.routine(task.arg);
+  }
+
+  return NULL;
+}
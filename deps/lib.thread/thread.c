@@ -25,6 +25,7 @@ thread_t* thread_init(thread_t* thread, char* name) {
   thread->arg = NULL;
   thread->thread_resume_routine = NULL;
   thread->resume_arg = NULL;
+  thread->semaphore = NULL;
   thread->flags = 0;
 
   pthread_mutex_init(&thread->mutex, NULL);
@@ -0,0 +1,261 @@
+#include <sched.h>  /* for sched_yield */
+#include <stdio.h>  /* for perror */
+#include <stdlib.h> /* for calloc, et al */
+
+#ifdef __linux__
+#include <linux/futex.h> /* for FUTEX_WAIT_PRIVATE et al */
+#include <sys/syscall.h> /* for SYS_futex */
+#include <unistd.h>      /* for syscall */
+#endif
+
+#include "libthread.h"
+
+/* Number of times an idle worker polls the queue before parking */
+#define WORK_QUEUE_SPIN_LIMIT 128
+
+/* Local Helpers Declarations */
+static bool work_queue_try_pop(work_queue_t* queue, work_task_t* task);
+static void work_queue_park(work_queue_t* queue, _Atomic uint32_t* word,
+                            uint32_t expected);
+static void work_queue_unpark(work_queue_t* queue, _Atomic uint32_t* word);
+static void* work_queue_worker(void* arg);
+
+/* Public API */
+
+/**
+ * @brief Initialize a work queue with room for at least `capacity` tasks and
+ * start `num_workers` detached worker threads to drain it
+ *
+ * @param queue
+ * @param capacity Rounded up to the next power of two
+ * @param num_workers
+ *
+ * @return bool Indicates whether the queue and its workers were created
+ */
+bool work_queue_init(work_queue_t* queue, size_t capacity,
+                     uint32_t num_workers) {
+  size_t size = 2;
+  while (size < capacity) size <<= 1;
+
+  if (!(queue->cells = calloc(size, sizeof(work_cell_t)))) return false;
+
+  queue->mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&queue->cells[i].sequence, i);
+  }
+
+  atomic_init(&queue->enqueue_pos, 0);
+  atomic_init(&queue->dequeue_pos, 0);
+  atomic_init(&queue->task_signal, 0);
+  atomic_init(&queue->idle_workers, 0);
+  atomic_init(&queue->space_signal, 0);
+  atomic_init(&queue->waiting_producers, 0);
+
+#ifndef __linux__
+  pthread_mutex_init(&queue->park_mutex, NULL);
+  pthread_cond_init(&queue->park_cv, NULL);
+#endif
+
+  for (uint32_t i = 0; i < num_workers; i++) {
+    thread_t* worker = thread_init(0, "work queue worker");
+    thread_set_attr(worker, false);
+
+    if (!thread_run(worker, work_queue_worker, queue)) return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Enqueue a task without ever blocking the caller
+ *
+ * @param queue
+ * @param routine
+ * @param arg
+ *
+ * @return bool Indicates whether the task was enqueued; false if the queue is
+ * full
+ */
+bool work_queue_try_push(work_queue_t* queue, void* (*routine)(void*),
+                         void* arg) {
+  work_cell_t* cell;
+  size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+
+  while (1) {
+    cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0) {
+      // The slot is free; try to claim it
+      if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot still holds a task from the previous lap; the queue is full
+      return false;
+    } else {
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  cell->task.routine = routine;
+  cell->task.arg = arg;
+  atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+  atomic_fetch_add(&queue->task_signal, 1);
+  if (atomic_load(&queue->idle_workers) > 0) {
+    work_queue_unpark(queue, &queue->task_signal);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Enqueue a task, waiting for a worker to free up a slot if the queue is
+ * full
+ *
+ * @param queue
+ * @param routine
+ * @param arg
+ */
+void work_queue_push(work_queue_t* queue, void* (*routine)(void*), void* arg) {
+  while (!work_queue_try_push(queue, routine, arg)) {
+    uint32_t seen = atomic_load(&queue->space_signal);
+    atomic_fetch_add(&queue->waiting_producers, 1);
+
+    // Re-check now that workers can see we're waiting, lest we miss a wakeup
+    if (!work_queue_try_push(queue, routine, arg)) {
+      work_queue_park(queue, &queue->space_signal, seen);
+      atomic_fetch_sub(&queue->waiting_producers, 1);
+      continue;
+    }
+
+    atomic_fetch_sub(&queue->waiting_producers, 1);
+    return;
+  }
+}
+
+/* Helpers */
+
+/**
+ * @brief Dequeue the next task, if any
+ *
+ * @param queue
+ * @param task Receives the dequeued task
+ *
+ * @return bool Indicates whether a task was dequeued
+ */
+static bool work_queue_try_pop(work_queue_t* queue, work_task_t* task) {
+  work_cell_t* cell;
+  size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+
+  while (1) {
+    cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot has yet to be filled; the queue is empty
+      return false;
+    } else {
+      pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    }
+  }
+
+  *task = cell->task;
+  // Hand the slot to the producer one lap ahead
+  atomic_store_explicit(&cell->sequence, pos + queue->mask + 1,
+                        memory_order_release);
+
+  atomic_fetch_add(&queue->space_signal, 1);
+  if (atomic_load(&queue->waiting_producers) > 0) {
+    work_queue_unpark(queue, &queue->space_signal);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Block the calling thread until `word` no longer holds `expected`
+ *
+ * @param queue
+ * @param word
+ * @param expected
+ */
+static void work_queue_park(work_queue_t* queue, _Atomic uint32_t* word,
+                            uint32_t expected) {
+#ifdef __linux__
+  (void)queue;
+  syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+  pthread_mutex_lock(&queue->park_mutex);
+  if (atomic_load(word) == expected) {
+    pthread_cond_wait(&queue->park_cv, &queue->park_mutex);
+  }
+  pthread_mutex_unlock(&queue->park_mutex);
+#endif
+}
+
+/**
+ * @brief Wake a thread parked on `word`
+ *
+ * @param queue
+ * @param word
+ */
+static void work_queue_unpark(work_queue_t* queue, _Atomic uint32_t* word) {
+#ifdef __linux__
+  (void)queue;
+  syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+  (void)word;
+  // Both kinds of waiter share the condition variable, so wake them all
+  pthread_mutex_lock(&queue->park_mutex);
+  pthread_cond_broadcast(&queue->park_cv);
+  pthread_mutex_unlock(&queue->park_mutex);
+#endif
+}
+
+/**
+ * @brief The worker thread routine: runs queued tasks, spinning briefly and
+ * then parking whenever the queue runs dry
+ *
+ * @param arg The work queue
+ * @return void*
+ */
+static void* work_queue_worker(void* arg) {
+  work_queue_t* queue = (work_queue_t*)arg;
+  work_task_t task;
+
+  while (1) {
+    bool found = false;
+
+    for (int i = 0; i < WORK_QUEUE_SPIN_LIMIT && !found; i++) {
+      if (!(found = work_queue_try_pop(queue, &task))) sched_yield();
+    }
+
+    if (!found) {
+      uint32_t seen = atomic_load(&queue->task_signal);
+      atomic_fetch_add(&queue->idle_workers, 1);
+
+      // Re-check now that producers can see we're idle, lest we miss a wakeup
+      if (!(found = work_queue_try_pop(queue, &task))) {
+        work_queue_park(queue, &queue->task_signal, seen);
+      }
+
+      atomic_fetch_sub(&queue->idle_workers, 1);
+    }
+
+    if (found) task.routine(task.arg);
+  }
+
+  return NULL;
+}
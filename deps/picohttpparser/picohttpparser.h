@@ -54,6 +54,29 @@ int phr_parse_request(char *buf, size_t len, char **method, size_t *method_len,
                       struct phr_header *headers, size_t *num_headers,
                       size_t last_len);
 
+/* should be zero-filled before start */
+struct phr_chunked_decoder {
+  size_t bytes_left_in_chunk; /* number of bytes left in current chunk */
+  char consume_trailer;       /* if trailing headers should be consumed */
+  char _hex_count;
+  char _state;
+};
+
+/* the function rewrites the buffer given as (buf, bufsz) removing the chunked-
+ * encoding headers.  When the function returns without an error, bufsz is
+ * updated to the length of the decoded data available.  Applications should
+ * repeatedly call the function while it returns -2 (incomplete) every time
+ * supplying newly arrived data.  If the end of the chunked-encoded data is
+ * found, the function returns a non-negative number indicating the number of
+ * octets left undecoded, that starts from the offset returned by `*bufsz`.
+ * Returns -1 on error.
+ */
+ssize_t phr_decode_chunked(struct phr_chunked_decoder *decoder, char *buf,
+                           size_t *bufsz);
+
+/* returns if the chunked decoder is in middle of chunked data */
+int phr_decode_chunked_is_in_data(struct phr_chunked_decoder *decoder);
+
 #ifdef __cplusplus
 }
 #endif
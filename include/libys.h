@@ -2,6 +2,7 @@
 #define LIB_YS_H
 
 #include <stdbool.h>
+#include <sys/types.h>
 #include <time.h>
 
 #include "libhash/libhash.h"
@@ -262,6 +263,15 @@ typedef struct request_internal* ys_request;
  */
 char* ys_req_get_parameter(ys_request* req, const char* key);
 
+/**
+ * ys_req_get_parameter_int stores in `value` the integer value of the parameter
+ * matching `key`. Returns false if there's no such parameter or its value isn't
+ * a decimal integer that fits in a long long. Parameters of the int and uint
+ * types are parsed once, when matched
+ */
+bool ys_req_get_parameter_int(ys_request* req, const char* key,
+                              long long* value);
+
 /**
  * ys_req_num_parameters returns the number of parameters matched on the given
  * request
@@ -311,13 +321,38 @@ char* ys_req_get_route_path(ys_request* req);
 char* ys_req_get_method(ys_request* req);
 
 /**
- * ys_req_get_body returns the full request body
+ * ys_req_get_body returns the full request body, NUL-terminated. The body may
+ * hold NULs of its own; see `ys_req_get_body_len`. On routes registered with
+ * YS_ROUTE_STREAM_BODY, only the part of the body that arrived along with the
+ * request head is returned, and the body should be read with
+ * `ys_req_read_body` instead
  */
 char* ys_req_get_body(ys_request* req);
 
+/**
+ * ys_req_get_body_len returns the length of the request body, per its
+ * Content-Length. Of a chunked body streamed with `ys_req_read_body`, returns
+ * the number of bytes decoded so far
+ */
+size_t ys_req_get_body_len(ys_request* req);
+
+/**
+ * ys_req_read_body reads up to `len` bytes of the request body into `buf`,
+ * picking up where the previous call left off. On routes registered with
+ * YS_ROUTE_STREAM_BODY, the body is read from the connection as the client
+ * sends it, so that it needn't be held in memory all at once; elsewhere, the
+ * body has already been read in full. A chunked body is handed out decoded, as
+ * each chunk arrives. Returns the number of bytes read, 0 once the whole body
+ * has been read, or -1 if the client hung up, sent nothing for 30 seconds or
+ * sent a malformed or oversized chunked body
+ */
+ssize_t ys_req_read_body(ys_request* req, void* buf, size_t len);
+
 /**
  * ys_req_get_raw returns the entire, raw request as it was received by the
- * server
+ * server. Of a body too large for the server's 4 KiB read buffer, only the part
+ * that arrived along with the head is included. A chunked body is included as
+ * decoded
  */
 char* ys_req_get_raw(ys_request* req);
 
@@ -333,6 +368,13 @@ char* ys_req_get_version(ys_request* req);
  */
 char* ys_req_get_header(ys_request* req, const char* key);
 
+/**
+ * ys_req_alloc allocates `size` bytes that last until the response to the
+ * request has been sent, when they are released along with the rest of the
+ * request. The memory must not be freed
+ */
+void* ys_req_alloc(ys_request* req, size_t size);
+
 /**********************************************************
  * Response
  **********************************************************/
@@ -356,6 +398,54 @@ bool ys_set_header(ys_response* res, const char* key, const char* value);
  */
 void ys_set_body(ys_response* res, const char* fmt, ...);
 
+/**
+ * ys_set_body_file sets the contents of the file at `path` as the response
+ * body. The file is sent straight from the kernel with sendfile(2), without
+ * being read into memory, and may hold any bytes, NULs included. The
+ * Content-Type defaults to application/octet-stream. Returns false if the file
+ * can't be opened or isn't a regular file, in which case the body is left as
+ * it was
+ */
+bool ys_set_body_file(ys_response* res, const char* path);
+
+/**
+ * ys_response_begin starts streaming the response: its status and headers are
+ * sent right away, and the body is then sent piece by piece with
+ * `ys_response_write`, in place of any body set on the response. `len` is the
+ * length of the body, if known, or -1, in which case the body is sent with
+ * Transfer-Encoding: chunked (or, to HTTP/1.0 clients, until the connection
+ * closes). In response to HEAD, only the head is sent, and whatever is written
+ * is dropped. Streaming blocks the handler's thread while the client catches
+ * up, so when REACTORS is set, routes that stream their responses should be
+ * registered with YS_ROUTE_COMPUTE. Returns false if the client can't be
+ * written to
+ */
+bool ys_response_begin(ys_response* res, ssize_t len);
+
+/**
+ * ys_response_write appends `len` bytes of `data` to the streamed response's
+ * body, beginning the response first if need be. Small writes are gathered and
+ * sent together; large ones are sent right away. Returns false if the client
+ * can't be written to, the body has ended or the write would exceed the length
+ * given to `ys_response_begin`
+ */
+bool ys_response_write(ys_response* res, const void* data, size_t len);
+
+/**
+ * ys_response_flush sends whatever of the streamed response's body has been
+ * gathered but not yet sent. Returns false if the client can't be written to
+ */
+bool ys_response_flush(ys_response* res);
+
+/**
+ * ys_response_end sends the rest of the streamed response's body and ends it.
+ * A streamed response is ended for the handler once it returns, if the handler
+ * doesn't end it itself. Returns false if the client can't be written to or
+ * the body fell short of the length given to `ys_response_begin`, in which case
+ * the connection is closed
+ */
+bool ys_response_end(ys_response* res);
+
 /**
  * ys_set_status sets the given status code on the response
  */
@@ -381,7 +471,8 @@ char* ys_get_header(ys_response* res, const char* key);
 /**
  * ys_from_file reads a file into a string buffer, which may then be passed
  * directly to `ys_set_body` e.g. ys_set_body(res,
- * ys_from_file("./index.html"));
+ * ys_from_file("./index.html")); To send a file as-is, prefer
+ * `ys_set_body_file`, which avoids copying it
  */
 char* ys_from_file(const char* filename);
 
@@ -427,6 +518,72 @@ ys_router* ys_router_init(ys_router_attr* attr);
 void __router_register(ys_router* router, const char* path,
                        ys_route_handler* handler, ys_http_method method, ...);
 
+/**
+ * Flags that modify how a registered route's handler is run
+ */
+typedef enum {
+  /**
+   * Run the handler on the compute pool, a separate set of work-stealing
+   * threads, instead of the thread that read the request. Meant for CPU-heavy
+   * or blocking handlers, which would otherwise tie up the threads serving
+   * every other request. The response is handed back to the I/O threads to be
+   * sent
+   */
+  YS_ROUTE_COMPUTE = 1 << 0,
+
+  /**
+   * Hand the request to the handler as soon as its head has been read, and
+   * leave the handler to read the body from the connection with
+   * `ys_req_read_body`, a piece at a time. Meant for uploads too large to
+   * buffer. Unless the route sets a `max_body_size`, its bodies aren't limited
+   * in size. The connection is closed after the response if the handler
+   * leaves any of the body unread. When REACTORS is set, such handlers run on
+   * the compute threads, as with YS_ROUTE_COMPUTE, lest a slow uploader stall
+   * the reactor's other connections
+   */
+  YS_ROUTE_STREAM_BODY = 1 << 1
+} ys_route_flag;
+
+/**
+ * Options for a route registered with `ys_router_register_with_opts`
+ */
+typedef struct {
+  // A bitwise OR of ys_route_flag values
+  unsigned int flags;
+
+  /**
+   * The largest request body, in bytes, the route accepts; larger requests are
+   * refused with a 413 before their body is read. 0 defers to the
+   * MAX_BODY_SIZE config option, or to no limit for YS_ROUTE_STREAM_BODY routes
+   */
+  size_t max_body_size;
+} ys_route_opts;
+
+/**
+ * ys_router_register_with_flags registers a new route record, as with
+ * `ys_router_register`, whose handler is run according to `flags`, a bitwise
+ * OR of ys_route_flag values.
+ */
+#define ys_router_register_with_flags(router, path, handler, flags, ...) \
+  __router_register_with_flags(router, path, handler, flags, __VA_ARGS__, NULL)
+
+void __router_register_with_flags(ys_router* router, const char* path,
+                                  ys_route_handler* handler,
+                                  unsigned int flags, ys_http_method method,
+                                  ...);
+
+/**
+ * ys_router_register_with_opts registers a new route record, as with
+ * `ys_router_register`, configured by the ys_route_opts `opts`.
+ */
+#define ys_router_register_with_opts(router, path, handler, opts, ...) \
+  __router_register_with_opts(router, path, handler, opts, __VA_ARGS__, NULL)
+
+void __router_register_with_opts(ys_router* router, const char* path,
+                                 ys_route_handler* handler,
+                                 const ys_route_opts* opts,
+                                 ys_http_method method, ...);
+
 /**
  * ys_router_free deallocates memory for ys_router `router`
  */
@@ -440,6 +597,26 @@ void ys_router_free(ys_router* router);
 ys_router* ys_router_register_sub(ys_router* parent_router,
                                   ys_router_attr* attr, const char* subpath);
 
+/**
+ * ys_router_serve_dir serves the files under the directory `dir` at the route
+ * prefix `prefix`, e.g. `dir`/css/app.css at `prefix`/css/app.css, and
+ * `dir`/index.html at `prefix`/. Files are served to GET and HEAD requests,
+ * with their Content-Type derived from their extension, and with ETag and
+ * Last-Modified headers that let clients revalidate their copies with a 304.
+ * If a file has a precompressed `.gz` sibling, the sibling is served in its
+ * stead to clients that accept gzip.
+ *
+ * Routes registered on the router take precedence over files of the same
+ * path, and requests for files that don't exist are handled by the router's
+ * 404 handler. Paths that contain a `..` segment or an encoded slash are
+ * refused, and symbolic links are followed only while they stay within `dir`.
+ *
+ * Up to STATIC_CACHE_SIZE bytes of the directory's files are held open, along
+ * with their headers, and invalidated as soon as they change on disk.
+ */
+void ys_router_serve_dir(ys_router* router, const char* prefix,
+                         const char* dir);
+
 /**
  * ys_router_register_404_handler registers the handler to be used for handling
  * requests to a non-registered route. If you do not set a status in this
@@ -465,6 +642,18 @@ void ys_router_register_500_handler(ys_router_attr* attr, ys_route_handler* h);
  * Server
  **********************************************************/
 
+/**
+ * ys_io_engine selects how a ys_server performs network I/O
+ */
+typedef enum {
+  // Wait for readiness via epoll (Linux) or kqueue (macos), then make the
+  // accept/read/write syscalls
+  YS_IO_ENGINE_POLL,
+  // Submit accepts, reads and writes via io_uring (Linux only). Falls back to
+  // YS_IO_ENGINE_POLL if io_uring is unavailable at runtime, or for HTTPs
+  YS_IO_ENGINE_URING
+} ys_io_engine;
+
 /**
  * A server attributes object that stores settings for the ys_server
  */
@@ -498,6 +687,12 @@ void ys_server_set_port(ys_server_attr* attr, int port);
  */
 void ys_server_use_https(ys_server_attr* attr, char* cert_path, char* key_path);
 
+/**
+ * ys_server_set_io_engine selects the I/O engine the server uses. Defaults to
+ * YS_IO_ENGINE_POLL
+ */
+void ys_server_set_io_engine(ys_server_attr* attr, ys_io_engine engine);
+
 /**
  * ys_server_disable_https disables HTTPs support. This is a convenience
  * function typically used for testing, where cert files were set on the
@@ -516,6 +711,27 @@ ys_server* ys_server_init(ys_server_attr*);
  */
 void ys_server_start(ys_server* server);
 
+/**
+ * ys_tls_stats is a snapshot of a ys_server's TLS session resumption and kTLS
+ * counters
+ */
+typedef struct {
+  // Handshakes that resumed a session, from the session cache or a ticket
+  unsigned long resumption_hits;
+  // Handshakes that negotiated a new session
+  unsigned long resumption_misses;
+  // Times the session ticket encryption key has been replaced
+  unsigned long ticket_key_rotations;
+  // Connections whose records the kernel encrypts (kTLS), if enabled
+  unsigned long ktls_connections;
+} ys_tls_stats;
+
+/**
+ * ys_server_get_tls_stats returns the server's TLS session resumption and
+ * kTLS counters. All counters are zero if HTTPs is not enabled
+ */
+ys_tls_stats ys_server_get_tls_stats(ys_server* server);
+
 /**
  * ys_server_free deallocates memory for the provided ys_server* instance
  */
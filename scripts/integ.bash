@@ -30,6 +30,20 @@ run () {
   quietly_kill $pid
 }
 
+run_uring () {
+  ./integ_test USE_URING &
+  pid=$!
+  sleep 1
+
+	declare -a tests=(
+    $(ls $TESTING_DIR | filter not_test_file _shpec.bash | grep -v 'tls_')
+  )
+
+	for_each run_test ${tests[*]}
+
+  quietly_kill $pid
+}
+
 run_ssl () {
   ./integ_test USE_SSL &
   pid=$!
@@ -53,6 +67,7 @@ main () {
   }
 
   run
+  run_uring
   run_ssl
 }
 
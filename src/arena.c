@@ -0,0 +1,69 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+// Allocations are rounded up to keep the next one aligned for any type
+#define ARENA_ALIGN (_Alignof(max_align_t))
+
+/**
+ * block_init allocates a block with room for `cap` bytes
+ */
+static arena_block *block_init(size_t cap, arena_block *next) {
+  arena_block *block = xmalloc(sizeof(arena_block) + cap);
+  block->next = next;
+  block->cap = cap;
+  block->used = 0;
+
+  return block;
+}
+
+arena *arena_init(void) {
+  arena *a = xmalloc(sizeof(arena));
+  a->blocks = block_init(ARENA_BLOCK_SIZE, NULL);
+
+  return a;
+}
+
+void *arena_alloc(arena *a, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  arena_block *block = a->blocks;
+  if (size > block->cap - block->used) {
+    // An allocation too large for a block of its own gets one that fits it
+    block = block_init(size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE,
+                       a->blocks);
+    a->blocks = block;
+  }
+
+  void *ptr = (char *)block->data + block->used;
+  block->used += size;
+
+  return ptr;
+}
+
+char *arena_strndup(arena *a, const char *s, size_t len) {
+  char *copy = arena_alloc(a, len + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+
+  return copy;
+}
+
+void arena_reset(arena *a) {
+  while (a->blocks->next) {
+    arena_block *block = a->blocks;
+    a->blocks = block->next;
+    free(block);
+  }
+
+  a->blocks->used = 0;
+}
+
+void arena_free(arena *a) {
+  arena_reset(a);
+  free(a->blocks);
+  free(a);
+}
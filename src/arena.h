@@ -0,0 +1,56 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// The size of an arena's blocks, short of any allocation too large for one
+#define ARENA_BLOCK_SIZE 8192
+
+/**
+ * arena_block is a block of memory from which an arena hands out allocations
+ */
+typedef struct arena_block {
+  struct arena_block *next;
+  size_t cap;
+  size_t used;
+  max_align_t data[];
+} arena_block;
+
+/**
+ * arena is a bump-pointer allocator for memory that is released all at once,
+ * such as that of a request, which is released once its response has been
+ * sent. Its allocations are never freed individually
+ */
+typedef struct arena {
+  // The block allocations are taken from, followed by those it replaced. The
+  // last of them is the arena's first block, which is kept for reuse
+  arena_block *blocks;
+} arena;
+
+/**
+ * arena_init allocates an arena along with its first block
+ */
+arena *arena_init(void);
+
+/**
+ * arena_alloc allocates `size` bytes from the arena, aligned for any type
+ */
+void *arena_alloc(arena *a, size_t size);
+
+/**
+ * arena_strndup copies `len` bytes of `s` into the arena, NUL-terminated
+ */
+char *arena_strndup(arena *a, const char *s, size_t len);
+
+/**
+ * arena_reset releases everything allocated from the arena, keeping only its
+ * first block for the allocations that follow
+ */
+void arena_reset(arena *a);
+
+/**
+ * arena_free deallocates the arena and everything allocated from it
+ */
+void arena_free(arena *a);
+
+#endif /* ARENA_H */
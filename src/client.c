@@ -0,0 +1,101 @@
+#include "client.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "request.h"
+#include "response.h"
+#include "xmalloc.h"
+
+client_context* client_init(int sockfd, SSL* ssl) {
+  client_context* ctx = xmalloc(sizeof(client_context));
+  ctx->sockfd = sockfd;
+  ctx->ssl = ssl;
+  ctx->handshaking = false;
+  ctx->handshake_status = SSL_ERROR_NONE;
+  ctx->ktls_send = false;
+  ctx->ktls_recv = false;
+  ctx->keep_alive = false;
+  ctx->num_requests = 0;
+  ctx->last_active = 0;
+  ctx->prev = NULL;
+  ctx->next = NULL;
+  ctx->next_returned = NULL;
+  ctx->defer_send = false;
+  ctx->out = NULL;
+  ctx->out_fd = -1;
+  ctx->out_fd_offset = 0;
+  ctx->out_fd_remaining = 0;
+  ctx->inflight = 0;
+  ctx->reactor = NULL;
+  ctx->buflen = 0;
+  ctx->req_len = 0;
+  ctx->body = NULL;
+  ctx->body_cap = 0;
+  ctx->arena = arena_init();
+  client_reset(ctx);
+
+  return ctx;
+}
+
+void client_reset(client_context* ctx) {
+  size_t leftover = ctx->buflen - ctx->req_len;
+  if (leftover > 0) {
+    memmove(ctx->buf, ctx->buf + ctx->req_len, leftover);
+  }
+
+  ctx->state = CONN_READING;
+  ctx->buflen = leftover;
+  ctx->req_len = 0;
+  // The parser has never seen the pipelined bytes as the start of a request
+  ctx->prev_buflen = 0;
+  ctx->buf[ctx->buflen] = '\0';
+
+  // Only a modest body buffer is worth keeping around for the next request
+  if (ctx->body_cap > BODY_BUFFER_RETAIN) {
+    free(ctx->body);
+    ctx->body = NULL;
+    ctx->body_cap = 0;
+  }
+
+  ctx->body_len = 0;
+  ctx->body_expected = 0;
+  ctx->body_undecoded = 0;
+  ctx->pending = NULL;
+  ctx->continued = false;
+
+  arena_reset(ctx->arena);
+}
+
+void client_close(client_context* ctx) {
+  if (ctx->ssl) {
+    // There's no session to shut down if the handshake never completed
+    if (!ctx->handshaking) {
+      SSL_shutdown(ctx->ssl);
+    }
+    SSL_free(ctx->ssl);
+  }
+
+  if (ctx->out) {
+    serialized_response_free(ctx->out);
+  }
+
+  if (ctx->out_fd != -1) {
+    close(ctx->out_fd);
+  }
+
+  if (ctx->pending) {
+    request_free(ctx->pending);
+  }
+
+  free(ctx->body);
+  arena_free(ctx->arena);
+
+  // The socket may already have been closed via io_uring
+  if (ctx->sockfd != -1) {
+    close(ctx->sockfd);
+  }
+  free(ctx);
+}
@@ -2,20 +2,193 @@
 #define CLIENT_H
 
 #include <arpa/inet.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
 
 #include <openssl/ssl.h>
 
+#include "libutil/libutil.h"
+
+// Size of the per-connection read buffer
+#define REQ_BUFFER_SIZE 4096
+
+// The largest request body buffer a connection holds on to between requests
+#define BODY_BUFFER_RETAIN (64 * 1024)
+
+/**
+ * connection_state tracks where a client connection is in its lifecycle
+ */
+typedef enum {
+  // Waiting on the poller to continue the TLS handshake
+  CONN_HANDSHAKING,
+  // Waiting on the poller for request bytes
+  CONN_READING,
+  // A complete request, or a step of the TLS handshake, was handed to a worker
+  CONN_DISPATCHED,
+  // The response is being written to the socket
+  CONN_WRITING,
+  // Waiting on the poller for the socket to drain, so that the reactor can send
+  // the rest of the response
+  CONN_FLUSHING,
+  // The connection is done and its resources may be released
+  CONN_CLOSED
+} connection_state;
+
 /**
  * client_context is a context object to store metadata about a client socket
  * connection
  */
-typedef struct {
+typedef struct client_context {
   SSL* ssl;
 
   /**
    * The socket file descriptor on which the connection has been opened
    */
   int sockfd;
+
+  connection_state state;
+
+  /**
+   * Whether the TLS handshake has yet to complete, and the outcome of its most
+   * recent step as an SSL_ERROR_* code
+   */
+  bool handshaking;
+  int handshake_status;
+
+  /**
+   * Whether the kernel encrypts and decrypts the connection's TLS records
+   * (kTLS), in which case plaintext may be written to and read from the socket
+   * directly
+   */
+  bool ktls_send;
+  bool ktls_recv;
+
+  /**
+   * Bytes read from the socket so far. Always NUL-terminated at `buflen`
+   */
+  char buf[REQ_BUFFER_SIZE + 1];
+  size_t buflen;
+
+  /**
+   * The buffer length as of the last parse attempt, which lets the parser skip
+   * re-scanning bytes it has already seen
+   */
+  size_t prev_buflen;
+
+  /**
+   * The length of the request (head and body) at the front of the buffer, once
+   * it has been parsed. Any bytes beyond it belong to pipelined requests
+   */
+  size_t req_len;
+
+  /**
+   * The body of a request too large for `buf`, read here once the head has been
+   * parsed: `body_len` of its `body_expected` bytes have arrived so far (a
+   * chunked body's length is unknown until its last chunk arrives). The
+   * buffer is kept for the connection's later requests unless it grew past
+   * BODY_BUFFER_RETAIN bytes
+   */
+  char* body;
+  size_t body_len;
+  size_t body_cap;
+  size_t body_expected;
+
+  /**
+   * Bytes of a chunked body read in after the first `body_len` bytes, which
+   * have yet to be decoded
+   */
+  size_t body_undecoded;
+
+  /**
+   * The request whose body is being read into `body`, if any
+   */
+  struct request_internal* pending;
+
+  /**
+   * Backs the memory of the connection's current request and its response,
+   * which is released all at once by client_reset
+   */
+  struct arena* arena;
+
+  /**
+   * Whether the client has been sent a 100 Continue for the current request
+   */
+  bool continued;
+
+  /**
+   * Whether the connection should be held open for further requests once the
+   * current response has been sent
+   */
+  bool keep_alive;
+
+  /**
+   * The number of requests received on this connection so far
+   */
+  unsigned int num_requests;
+
+  /**
+   * Monotonic time (in seconds) at which the connection last went idle
+   */
+  time_t last_active;
+
+  /**
+   * Whether responses should be left in `out` for the reactor to send, rather
+   * than written to the socket directly. Set for io_uring connections, and for
+   * those of a reactor that runs the router itself
+   */
+  bool defer_send;
+
+  /**
+   * A serialized response waiting to be sent by the reactor, less whatever of
+   * it has been sent so far
+   */
+  struct serialized_response* out;
+
+  /**
+   * A file whose contents are sent after `out` as the response body, the
+   * offset of the next byte to send, and how many bytes remain; -1 if the
+   * response has no file body
+   */
+  int out_fd;
+  off_t out_fd_offset;
+  off_t out_fd_remaining;
+
+  /**
+   * The reactor that owns the connection
+   */
+  struct reactor* reactor;
+
+  /**
+   * The number of io_uring operations in flight that reference this connection.
+   * The context may only be freed once this drops to zero
+   */
+  unsigned int inflight;
+
+  // Links for the reactor's list of open connections
+  struct client_context* prev;
+  struct client_context* next;
+
+  // Link for the reactor's queue of connections returned by workers
+  struct client_context* next_returned;
 } client_context;
 
+/**
+ * client_init allocates a new client context for the connection on `sockfd`
+ */
+client_context* client_init(int sockfd, SSL* ssl);
+
+/**
+ * client_reset discards the request that was just served from the connection's
+ * buffer, and releases its memory, so that both can be reused for the next
+ * request. Any pipelined bytes that followed the request are retained.
+ */
+void client_reset(client_context* ctx);
+
+/**
+ * client_close shuts down the connection and deallocates the client context
+ */
+void client_close(client_context* ctx);
+
 #endif /* CLIENT_H */
@@ -0,0 +1,84 @@
+#include "compute.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "lib.thread/libthread.h"
+#include "logger.h"
+#include "reactor.h"
+#include "router.h"
+#include "xmalloc.h"
+
+#define CR(op) (response_internal *)op
+#define CRR(req, res) (ys_request *)req, (ys_response *)res
+
+/**
+ * A handler invocation queued on the compute pool
+ */
+typedef struct {
+  client_context *ctx;
+  request_internal *req;
+  response_internal *res;
+  ys_route_handler *handler;
+} compute_task;
+
+static steal_pool_t compute_pool;
+static pthread_once_t compute_pool_once = PTHREAD_ONCE_INIT;
+
+/**
+ * compute_pool_init starts the compute pool's workers
+ */
+static void compute_pool_init(void) {
+  long num_workers = server_conf.compute_threads;
+  if (num_workers == COMPUTE_THREADS_AUTO) {
+    num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+
+  if (num_workers < 1) {
+    num_workers = 1;
+  }
+
+  if (!steal_pool_init(&compute_pool, (uint32_t)num_workers)) {
+    DIE("[compute::%s] failed to start compute pool\n", __func__);
+  }
+
+  printlogf(YS_LOG_DEBUG, "[compute::%s] started %ld compute threads\n",
+            __func__, num_workers);
+}
+
+/**
+ * compute_thread_handler runs a route handler on a compute pool worker, then
+ * hands the response back to the connection's reactor to be sent
+ */
+static void *compute_thread_handler(void *arg) {
+  compute_task *task = arg;
+  client_context *ctx = task->ctx;
+
+  response_internal *res = CR(task->handler(CRR(task->req, task->res)));
+
+  // Leave the serialized response in `ctx->out` rather than writing it from
+  // this thread
+  bool defer_send = ctx->defer_send;
+  ctx->defer_send = true;
+  router_send_response(ctx, task->req, res);
+  ctx->defer_send = defer_send;
+
+  reactor_complete(ctx->reactor, ctx);
+
+  free(task);
+  return NULL;
+}
+
+void compute_dispatch(client_context *ctx, request_internal *req,
+                      response_internal *res, ys_route_handler *handler) {
+  pthread_once(&compute_pool_once, compute_pool_init);
+
+  compute_task *task = xmalloc(sizeof(compute_task));
+  task->ctx = ctx;
+  task->req = req;
+  task->res = res;
+  task->handler = handler;
+
+  steal_pool_submit(&compute_pool, compute_thread_handler, task);
+}
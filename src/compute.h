@@ -0,0 +1,20 @@
+#ifndef COMPUTE_H
+#define COMPUTE_H
+
+#include "client.h"
+#include "libys.h"
+#include "request.h"
+#include "response.h"
+
+/**
+ * compute_dispatch runs `handler` for the given request on the compute pool,
+ * a work-stealing pool that keeps CPU-heavy and blocking handlers off the I/O
+ * threads. Once the handler returns, its response is serialized and the
+ * connection is handed back to its reactor, which arranges for the response to
+ * be sent. The pool is started on first use, with `server_conf.compute_threads`
+ * workers.
+ */
+void compute_dispatch(client_context *ctx, request_internal *req,
+                      response_internal *res, ys_route_handler *handler);
+
+#endif /* COMPUTE_H */
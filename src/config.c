@@ -17,12 +17,39 @@ static const int CONFIG_MAX_LINE_LEN = 256;
 // Default number of threads to use in the server thread pool
 static const short DEFAULT_NUM_THREADS = 4;
 
+// Default number of requests that may be queued for the worker threads
+static const int DEFAULT_QUEUE_SIZE = 1024;
+
 // Default port number
 static const int DEFAULT_PORT_NUM = 5000;
 
 // Default log level
 static char DEFAULT_LOG_LEVEL[] = "info";
 
+// Default number of seconds an idle keep-alive connection is held open
+static const int DEFAULT_KEEP_ALIVE_TIMEOUT = 5;
+
+// Default maximum number of requests served over a single connection
+static const int DEFAULT_KEEP_ALIVE_MAX_REQUESTS = 1000;
+
+// Default maximum number of sessions in the TLS session cache
+static const int DEFAULT_TLS_SESSION_CACHE_SIZE = 20480;
+
+// Default number of seconds a TLS session may be resumed for
+static const int DEFAULT_TLS_SESSION_TIMEOUT = 300;
+
+// Default number of seconds between TLS session ticket key rotations
+static const int DEFAULT_TLS_TICKET_KEY_ROTATION = 3600;
+
+// Default number of seconds a client is given to complete the TLS handshake
+static const int DEFAULT_TLS_HANDSHAKE_TIMEOUT = 10;
+
+// Default number of bytes of files the static file cache may hold open
+static const long DEFAULT_STATIC_CACHE_SIZE = 64 * 1024 * 1024;
+
+// Default maximum size of a request body, in bytes
+static const long DEFAULT_MAX_BODY_SIZE = 1024 * 1024;
+
 // Environment variable key for user-defined number of threads
 static const char NUM_THREADS_KEY[] = "NUM_THREADS";
 
@@ -35,13 +62,77 @@ static const char LOG_LEVEL_KEY[] = "LOG_LEVEL";
 // Environment variable key for user-defined log file path
 static const char LOG_FILE_KEY[] = "LOG_FILE";
 
+// Environment variable key for user-defined work queue size
+static const char QUEUE_SIZE_KEY[] = "QUEUE_SIZE";
+
+// Environment variable key for user-defined full work queue behavior
+static const char QUEUE_FULL_KEY[] = "QUEUE_FULL";
+
+// Environment variable key for user-defined number of compute threads
+static const char COMPUTE_THREADS_KEY[] = "COMPUTE_THREADS";
+
+// Environment variable key for user-defined number of reactors
+static const char REACTORS_KEY[] = "REACTORS";
+
+// Environment variable key for user-defined reactor CPU pinning
+static const char CPU_AFFINITY_KEY[] = "CPU_AFFINITY";
+
+// Environment variable key for user-defined TLS session cache size
+static const char TLS_SESSION_CACHE_SIZE_KEY[] = "TLS_SESSION_CACHE_SIZE";
+
+// Environment variable key for user-defined TLS session lifetime
+static const char TLS_SESSION_TIMEOUT_KEY[] = "TLS_SESSION_TIMEOUT";
+
+// Environment variable key for user-defined TLS session ticket support
+static const char TLS_SESSION_TICKETS_KEY[] = "TLS_SESSION_TICKETS";
+
+// Environment variable key for user-defined TLS ticket key rotation interval
+static const char TLS_TICKET_KEY_ROTATION_KEY[] = "TLS_TICKET_KEY_ROTATION";
+
+// Environment variable key for user-defined TLS handshake timeout
+static const char TLS_HANDSHAKE_TIMEOUT_KEY[] = "TLS_HANDSHAKE_TIMEOUT";
+
+// Environment variable key for user-defined kernel TLS offload
+static const char TLS_KTLS_KEY[] = "TLS_KTLS";
+
+// Environment variable key for user-defined static file cache size
+static const char STATIC_CACHE_SIZE_KEY[] = "STATIC_CACHE_SIZE";
+
+// Environment variable key for user-defined maximum request body size
+static const char MAX_BODY_SIZE_KEY[] = "MAX_BODY_SIZE";
+
+// Environment variable key for user-defined keep-alive idle timeout
+static const char KEEP_ALIVE_TIMEOUT_KEY[] = "KEEP_ALIVE_TIMEOUT";
+
+// Environment variable key for user-defined max requests per connection
+static const char KEEP_ALIVE_MAX_REQUESTS_KEY[] = "KEEP_ALIVE_MAX_REQUESTS";
+
 /**
  * Default server config
  */
 server_config server_conf = {.log_file = NULL,
                              .log_level = DEFAULT_LOG_LEVEL,
                              .threads = DEFAULT_NUM_THREADS,
-                             .port = DEFAULT_PORT_NUM};
+                             .queue_size = DEFAULT_QUEUE_SIZE,
+                             .queue_full = QUEUE_FULL_WAIT,
+                             .compute_threads = COMPUTE_THREADS_AUTO,
+                             .reactors = 0,
+                             .cpu_affinity = false,
+                             .port = DEFAULT_PORT_NUM,
+                             .keep_alive_timeout = DEFAULT_KEEP_ALIVE_TIMEOUT,
+                             .keep_alive_max_requests =
+                                 DEFAULT_KEEP_ALIVE_MAX_REQUESTS,
+                             .tls_session_cache_size =
+                                 DEFAULT_TLS_SESSION_CACHE_SIZE,
+                             .tls_session_timeout = DEFAULT_TLS_SESSION_TIMEOUT,
+                             .tls_session_tickets = true,
+                             .tls_ticket_key_rotation =
+                                 DEFAULT_TLS_TICKET_KEY_ROTATION,
+                             .tls_handshake_timeout =
+                                 DEFAULT_TLS_HANDSHAKE_TIMEOUT,
+                             .tls_ktls = false,
+                             .static_cache_size = DEFAULT_STATIC_CACHE_SIZE,
+                             .max_body_size = DEFAULT_MAX_BODY_SIZE};
 
 bool parse_config(const char* filename) {
   bool ret = false;
@@ -62,6 +153,21 @@ bool parse_config(const char* filename) {
 
   int port = 0;
   int threads = 0;
+  int queue_size = 0;
+  int queue_full = -1;
+  int compute_threads = 0;
+  int reactors = 0;
+  int cpu_affinity = -1;
+  int keep_alive_timeout = -1;
+  int keep_alive_max_requests = -1;
+  int tls_session_cache_size = -1;
+  int tls_session_timeout = 0;
+  int tls_session_tickets = -1;
+  int tls_ticket_key_rotation = 0;
+  int tls_handshake_timeout = 0;
+  int tls_ktls = -1;
+  long static_cache_size = -1;
+  long max_body_size = -1;
   char* log_level = NULL;
   char* log_file = NULL;
 
@@ -93,6 +199,136 @@ bool parse_config(const char* filename) {
                   __func__);
         goto cleanup;
       }
+    } else if (s_equals(name, QUEUE_SIZE_KEY)) {
+      queue_size = atoi(value);
+
+      if (queue_size <= 0) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid queue size\n", __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, QUEUE_FULL_KEY)) {
+      if (s_equals(value, "wait")) {
+        queue_full = QUEUE_FULL_WAIT;
+      } else if (s_equals(value, "reject")) {
+        queue_full = QUEUE_FULL_REJECT;
+      } else {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid queue full behavior\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, COMPUTE_THREADS_KEY)) {
+      compute_threads =
+          s_equals(value, "auto") ? COMPUTE_THREADS_AUTO : atoi(value);
+
+      if (compute_threads == 0 || compute_threads < COMPUTE_THREADS_AUTO) {
+        printlogf(YS_LOG_INFO,
+                  "[config::%s] Invalid number of compute threads\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, REACTORS_KEY)) {
+      reactors = s_equals(value, "auto") ? REACTORS_AUTO : atoi(value);
+
+      if (reactors == 0 || reactors < REACTORS_AUTO) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid number of reactors\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, CPU_AFFINITY_KEY)) {
+      if (s_equals(value, "true")) {
+        cpu_affinity = true;
+      } else if (s_equals(value, "false")) {
+        cpu_affinity = false;
+      } else {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid CPU affinity\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, KEEP_ALIVE_TIMEOUT_KEY)) {
+      keep_alive_timeout = atoi(value);
+
+      if (keep_alive_timeout < 0) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid keep-alive timeout\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, KEEP_ALIVE_MAX_REQUESTS_KEY)) {
+      keep_alive_max_requests = atoi(value);
+
+      if (keep_alive_max_requests < 0) {
+        printlogf(YS_LOG_INFO,
+                  "[config::%s] Invalid keep-alive max requests\n", __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, TLS_SESSION_CACHE_SIZE_KEY)) {
+      tls_session_cache_size = atoi(value);
+
+      if (tls_session_cache_size < 0) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid TLS session cache size\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, TLS_SESSION_TIMEOUT_KEY)) {
+      tls_session_timeout = atoi(value);
+
+      if (tls_session_timeout <= 0) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid TLS session timeout\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, TLS_SESSION_TICKETS_KEY)) {
+      if (s_equals(value, "true")) {
+        tls_session_tickets = true;
+      } else if (s_equals(value, "false")) {
+        tls_session_tickets = false;
+      } else {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid TLS session tickets\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, TLS_TICKET_KEY_ROTATION_KEY)) {
+      tls_ticket_key_rotation = atoi(value);
+
+      if (tls_ticket_key_rotation <= 0) {
+        printlogf(YS_LOG_INFO,
+                  "[config::%s] Invalid TLS ticket key rotation interval\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, TLS_HANDSHAKE_TIMEOUT_KEY)) {
+      tls_handshake_timeout = atoi(value);
+
+      if (tls_handshake_timeout <= 0) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid TLS handshake timeout\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, TLS_KTLS_KEY)) {
+      if (s_equals(value, "true")) {
+        tls_ktls = true;
+      } else if (s_equals(value, "false")) {
+        tls_ktls = false;
+      } else {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid TLS kTLS setting\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, STATIC_CACHE_SIZE_KEY)) {
+      static_cache_size = strtol(value, NULL, 10);
+
+      if (static_cache_size < 0) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid static cache size\n",
+                  __func__);
+        goto cleanup;
+      }
+    } else if (s_equals(name, MAX_BODY_SIZE_KEY)) {
+      max_body_size = strtol(value, NULL, 10);
+
+      if (max_body_size < 0) {
+        printlogf(YS_LOG_INFO, "[config::%s] Invalid max body size\n",
+                  __func__);
+        goto cleanup;
+      }
     } else if (s_equals(name, LOG_LEVEL_KEY)) {
       if (s_nullish(value)) {
         printlogf(YS_LOG_INFO, "[config::%s] Invalid log level\n", __func__);
@@ -123,6 +359,66 @@ bool parse_config(const char* filename) {
     server_conf.threads = threads;
   }
 
+  if (queue_size) {
+    server_conf.queue_size = queue_size;
+  }
+
+  if (queue_full >= 0) {
+    server_conf.queue_full = queue_full;
+  }
+
+  if (compute_threads) {
+    server_conf.compute_threads = compute_threads;
+  }
+
+  if (reactors) {
+    server_conf.reactors = reactors;
+  }
+
+  if (cpu_affinity >= 0) {
+    server_conf.cpu_affinity = cpu_affinity;
+  }
+
+  if (keep_alive_timeout >= 0) {
+    server_conf.keep_alive_timeout = keep_alive_timeout;
+  }
+
+  if (keep_alive_max_requests >= 0) {
+    server_conf.keep_alive_max_requests = keep_alive_max_requests;
+  }
+
+  if (tls_session_cache_size >= 0) {
+    server_conf.tls_session_cache_size = tls_session_cache_size;
+  }
+
+  if (tls_session_timeout) {
+    server_conf.tls_session_timeout = tls_session_timeout;
+  }
+
+  if (tls_session_tickets >= 0) {
+    server_conf.tls_session_tickets = tls_session_tickets;
+  }
+
+  if (tls_ticket_key_rotation) {
+    server_conf.tls_ticket_key_rotation = tls_ticket_key_rotation;
+  }
+
+  if (tls_handshake_timeout) {
+    server_conf.tls_handshake_timeout = tls_handshake_timeout;
+  }
+
+  if (tls_ktls >= 0) {
+    server_conf.tls_ktls = tls_ktls;
+  }
+
+  if (static_cache_size >= 0) {
+    server_conf.static_cache_size = static_cache_size;
+  }
+
+  if (max_body_size >= 0) {
+    server_conf.max_body_size = max_body_size;
+  }
+
   if (!s_nullish(log_level)) {
     server_conf.log_level = log_level;
   }
@@ -3,6 +3,17 @@
 
 #include <stdbool.h>
 
+/**
+ * queue_full_policy determines what happens to a request that arrives while
+ * the work queue is full
+ */
+typedef enum {
+  // Wait for a worker to free up a slot in the queue
+  QUEUE_FULL_WAIT,
+  // Reject the request with a 503 Service Unavailable
+  QUEUE_FULL_REJECT
+} queue_full_policy;
+
 /**
  * server_config is a globally-used configurations object containing user server
  * settings
@@ -14,11 +25,101 @@ typedef struct {
    */
   short threads;
 
+  /**
+   * The number of requests that may be queued for the worker threads
+   */
+  int queue_size;
+
+  /**
+   * What to do with a request that arrives while the queue is full
+   */
+  queue_full_policy queue_full;
+
+  /**
+   * The number of threads in the work-stealing pool that runs the handlers of
+   * routes registered with YS_ROUTE_COMPUTE. COMPUTE_THREADS_AUTO runs one
+   * thread per online CPU
+   */
+  short compute_threads;
+
+  /**
+   * The number of shared-nothing reactors to run, each on its own thread with
+   * its own listening socket. A value of 0 disables this mode in favor of a
+   * single reactor in front of the thread pool. REACTORS_AUTO runs one reactor
+   * per online CPU
+   */
+  short reactors;
+
+  /**
+   * Whether each reactor thread should be pinned to its own CPU
+   */
+  bool cpu_affinity;
+
   /**
    * The port number on which the server will listen
    */
   int port;
 
+  /**
+   * The number of seconds an idle connection is held open while waiting for
+   * its next request. A value of 0 disables keep-alive entirely
+   */
+  int keep_alive_timeout;
+
+  /**
+   * The maximum number of requests served over a single connection before it
+   * is closed. A value of 0 means no limit
+   */
+  int keep_alive_max_requests;
+
+  /**
+   * The maximum number of TLS sessions held in the server-side session cache.
+   * A value of 0 disables the cache
+   */
+  int tls_session_cache_size;
+
+  /**
+   * The number of seconds a TLS session may be resumed for, whether from the
+   * cache or from a session ticket
+   */
+  int tls_session_timeout;
+
+  /**
+   * Whether to issue stateless TLS session tickets
+   */
+  bool tls_session_tickets;
+
+  /**
+   * The number of seconds after which the key used to encrypt new session
+   * tickets is replaced. Tickets encrypted with the previous key are still
+   * accepted (and renewed) for one more interval
+   */
+  int tls_ticket_key_rotation;
+
+  /**
+   * The number of seconds a client is given to complete the TLS handshake
+   * before its connection is closed
+   */
+  int tls_handshake_timeout;
+
+  /**
+   * Whether to hand TLS record encryption and decryption to the kernel (kTLS)
+   * once the handshake is complete, where the kernel and OpenSSL support it
+   */
+  bool tls_ktls;
+
+  /**
+   * The number of bytes of files that each directory served with
+   * ys_router_serve_dir may hold open in its cache. 0 disables the cache
+   */
+  long static_cache_size;
+
+  /**
+   * The largest request body, in bytes, accepted on routes that don't set a
+   * limit of their own. 0 lifts the limit
+   */
+  long max_body_size;
+
   /**
    * The logging level
    */
@@ -32,6 +133,13 @@ typedef struct {
 
 extern server_config server_conf;
 
+// Value of `server_config.reactors` that selects one reactor per online CPU
+#define REACTORS_AUTO -1
+
+// Value of `server_config.compute_threads` that selects one thread per online
+// CPU
+#define COMPUTE_THREADS_AUTO -1
+
 // Maximum number of queued connections allowed for server
 extern const short MAX_QUEUED_CONNECTIONS;
 
@@ -127,8 +127,7 @@ static bool are_headers_allowed(cors_config *c, array_t *headers) {
  * 3) Include an Access-Control-Request-Method header
  */
 static bool is_preflight_request(request_internal *req) {
-  bool is_options_req =
-      s_equals(req->method, ys_http_method_names[YS_METHOD_OPTIONS]);
+  bool is_options_req = req->method == YS_METHOD_OPTIONS;
   bool has_origin_header =
       !s_nullish(get_first_header(req->headers, ORIGIN_HEADER));
   bool has_request_method =
@@ -171,7 +170,7 @@ static void handle_request(request_internal *req, ys_response *res) {
   // include them - this is spec compliant
   if (has_elements(cors_conf->exposed_headers)) {
     ys_set_header(res, EXPOSE_HEADERS_HEADER,
-                  str_join(cors_conf->exposed_headers, ", "));
+                  cors_conf->exposed_headers_value);
   }
 
   // Allow the client to send credentials. If making an XHR request, the client
@@ -189,9 +188,7 @@ static void handle_preflight_request(request_internal *req, ys_response *res) {
 
   // Set the "vary" header to prevent proxy servers from sending cached
   // responses for one client to another
-  ys_set_header(res, VARY_HEADER,
-                fmt_str("%s, %s, %s", ORIGIN_HEADER, REQUEST_YS_METHOD_HEADER,
-                        REQUEST_HEADERS_HEADER));
+  ys_set_header(res, VARY_HEADER, cors_conf->preflight_vary);
 
   // If no origin was specified, this is not a valid CORS request
   if (s_nullish(origin)) {
@@ -217,7 +214,7 @@ static void handle_preflight_request(request_internal *req, ys_response *res) {
 
   array_t *reqd_headers = derive_headers(header_str);
   if (!are_headers_allowed(cors_conf, reqd_headers)) {
-    array_free(reqd_headers);
+    array_free_ptrs(reqd_headers);
     return;
   }
 
@@ -236,8 +233,7 @@ static void handle_preflight_request(request_internal *req, ys_response *res) {
   // Set the allowed headers, as a Preflight may have been sent if the client
   // included non-simple headers.
   if (has_elements(reqd_headers)) {
-    ys_set_header(res, ALLOW_HEADERS_HEADER,
-                  str_join(cors_conf->allowed_headers, ", "));
+    ys_set_header(res, ALLOW_HEADERS_HEADER, cors_conf->allowed_headers_value);
   }
 
   // Allow the client to send credentials. If making an XHR request, the client
@@ -250,10 +246,10 @@ static void handle_preflight_request(request_internal *req, ys_response *res) {
   // refers to server-suggested duration, in seconds, a response should stay in
   // the browser's cache before another Preflight is made
   if (cors_conf->max_age > 0) {
-    ys_set_header(res, MAX_AGE_HEADER, fmt_str("%d", cors_conf->max_age));
+    ys_set_header(res, MAX_AGE_HEADER, cors_conf->max_age_value);
   }
 
-  array_free(reqd_headers);
+  array_free_ptrs(reqd_headers);
 }
 
 ys_cors_opts *ys_cors_opts_init(void) {
@@ -264,6 +260,9 @@ ys_cors_opts *ys_cors_opts_init(void) {
   // TODO: why does this need to be pre-initialized but not other arrays (when
   // using allow_x macros)
   opts->allowed_methods = array_init();
+  opts->allowed_origins = NULL;
+  opts->allowed_headers = NULL;
+  opts->expose_headers = NULL;
 
   return (ys_cors_opts *)opts;
 }
@@ -274,6 +273,8 @@ cors_config *cors_init(cors_opts_internal *opts) {
   cors_conf->max_age = opts->max_age;
   cors_conf->exposed_headers = opts->expose_headers;
   cors_conf->use_options_passthrough = opts->use_options_passthrough;
+  cors_conf->allow_all_origins = false;
+  cors_conf->allow_all_headers = false;
   cors_conf->allowed_origins = array_init();
   cors_conf->allowed_methods = array_init();
 
@@ -334,6 +335,16 @@ cors_config *cors_init(cors_opts_internal *opts) {
     }
   }
 
+  cors_conf->preflight_vary =
+      fmt_str("%s, %s, %s", ORIGIN_HEADER, REQUEST_YS_METHOD_HEADER,
+              REQUEST_HEADERS_HEADER);
+  cors_conf->allowed_headers_value = str_join(cors_conf->allowed_headers, ", ");
+  cors_conf->exposed_headers_value =
+      has_elements(cors_conf->exposed_headers)
+          ? str_join(cors_conf->exposed_headers, ", ")
+          : NULL;
+  cors_conf->max_age_value = fmt_str("%d", cors_conf->max_age);
+
   return cors_conf;
 }
 
@@ -348,7 +359,10 @@ ys_cors_opts *ys_cors_allow_all(void) {
                     s_copy(ys_http_method_names[YS_METHOD_PUT]),
                     s_copy(ys_http_method_names[YS_METHOD_DELETE]));
   opts->allowed_headers = array_collect("*");
+  opts->expose_headers = NULL;
   opts->allow_credentials = false;
+  opts->max_age = 0;
+  opts->use_options_passthrough = false;
 
   return (ys_cors_opts *)opts;
 }
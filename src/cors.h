@@ -32,6 +32,12 @@ typedef struct {
   array_t *allowed_origins;
   array_t *allowed_headers;
   array_t *exposed_headers;
+  // The values of the response headers that are the same for every request,
+  // formatted once up front
+  char *preflight_vary;
+  char *allowed_headers_value;
+  char *exposed_headers_value;
+  char *max_age_value;
 } cors_config;
 
 /**
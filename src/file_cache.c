@@ -0,0 +1,886 @@
+#define _GNU_SOURCE  // for O_PATH
+
+#include "file_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/openat2.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#endif
+
+#include "lib.thread/libthread.h"
+#include "libutil/libutil.h"
+#include "libys.h"
+#include "logger.h"
+#include "xmalloc.h"
+
+// Initial number of hash buckets; doubled whenever the entries outnumber them
+#define FILE_CACHE_INITIAL_BUCKETS 64
+
+// Entries are charged in whole pages, so that a flood of tiny files can't hold
+// more open than the budget suggests
+#define FILE_CACHE_PAGE_SIZE 4096
+
+// The fewest files the cache may hold open, however low the fd limit
+#define FILE_CACHE_MIN_FILES 16
+
+// The most files the cache may hold open, however high the fd limit
+#define FILE_CACHE_MAX_FILES 65536
+
+static const char GZIP_SUFFIX[] = ".gz";
+
+static const char HTTP_DATE_FMT[] = "%a, %d %b %Y %H:%M:%S GMT";
+
+#ifdef __linux__
+// Every change to a watched directory that could make an entry stale
+static const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                   IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE |
+                                   IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+#endif
+
+/**
+ * A file extension and the MIME type it denotes
+ */
+typedef struct {
+  const char *ext;
+  const char **mime_type;
+} mime_type_mapping;
+
+static const mime_type_mapping mime_types[] = {
+    {"3gp", &YS_MIME_TYPE_3GP},
+    {"3gpp", &YS_MIME_TYPE_3GPP},
+    {"7z", &YS_MIME_TYPE_7Z},
+    {"ai", &YS_MIME_TYPE_AI},
+    {"apng", &YS_MIME_TYPE_APNG},
+    {"asf", &YS_MIME_TYPE_ASF},
+    {"asx", &YS_MIME_TYPE_ASX},
+    {"atom", &YS_MIME_TYPE_ATOM},
+    {"avi", &YS_MIME_TYPE_AVI},
+    {"avif", &YS_MIME_TYPE_AVIF},
+    {"bin", &YS_MIME_TYPE_BIN},
+    {"bmp", &YS_MIME_TYPE_BMP},
+    {"cco", &YS_MIME_TYPE_CCO},
+    {"crt", &YS_MIME_TYPE_CRT},
+    {"css", &YS_MIME_TYPE_CSS},
+    {"csv", &YS_MIME_TYPE_CSV},
+    {"cur", &YS_MIME_TYPE_CUR},
+    {"deb", &YS_MIME_TYPE_DEB},
+    {"der", &YS_MIME_TYPE_DER},
+    {"dll", &YS_MIME_TYPE_DLL},
+    {"dmg", &YS_MIME_TYPE_Dmg},
+    {"doc", &YS_MIME_TYPE_DOC},
+    {"docx", &YS_MIME_TYPE_DOCX},
+    {"ear", &YS_MIME_TYPE_EAR},
+    {"eot", &YS_MIME_TYPE_EOT},
+    {"eps", &YS_MIME_TYPE_EPS},
+    {"epub", &YS_MIME_TYPE_EPUB},
+    {"exe", &YS_MIME_TYPE_EXE},
+    {"flv", &YS_MIME_TYPE_FLV},
+    {"geojson", &YS_MIME_TYPE_GEOJSON},
+    {"gif", &YS_MIME_TYPE_GIF},
+    {"glb", &YS_MIME_TYPE_GLB},
+    {"gltf", &YS_MIME_TYPE_GLTF},
+    {"hqx", &YS_MIME_TYPE_HQX},
+    {"htc", &YS_MIME_TYPE_HTC},
+    {"htm", &YS_MIME_TYPE_HTM},
+    {"html", &YS_MIME_TYPE_HTML},
+    {"ico", &YS_MIME_TYPE_ICO},
+    {"img", &YS_MIME_TYPE_IMG},
+    {"iso", &YS_MIME_TYPE_ISO},
+    {"jad", &YS_MIME_TYPE_JAD},
+    {"jar", &YS_MIME_TYPE_JAR},
+    {"jardiff", &YS_MIME_TYPE_JARDIFF},
+    {"jng", &YS_MIME_TYPE_JNG},
+    {"jnlp", &YS_MIME_TYPE_JNLP},
+    {"jp2", &YS_MIME_TYPE_JP2},
+    {"jpeg", &YS_MIME_TYPE_JPEG},
+    {"jpg", &YS_MIME_TYPE_JPG},
+    {"js", &YS_MIME_TYPE_JS},
+    {"json", &YS_MIME_TYPE_JSON},
+    {"jsonld", &YS_MIME_TYPE_JSONLD},
+    {"jxl", &YS_MIME_TYPE_JXL},
+    {"jxr", &YS_MIME_TYPE_JXR},
+    {"kar", &YS_MIME_TYPE_KAR},
+    {"kml", &YS_MIME_TYPE_KML},
+    {"kmz", &YS_MIME_TYPE_KMZ},
+    {"m3u8", &YS_MIME_TYPE_M3U8},
+    {"m4a", &YS_MIME_TYPE_M4A},
+    {"m4v", &YS_MIME_TYPE_M4V},
+    {"md", &YS_MIME_TYPE_MD},
+    {"mid", &YS_MIME_TYPE_MID},
+    {"midi", &YS_MIME_TYPE_MIDI},
+    {"mjs", &YS_MIME_TYPE_MJS},
+    {"mml", &YS_MIME_TYPE_MML},
+    {"mng", &YS_MIME_TYPE_MNG},
+    {"mov", &YS_MIME_TYPE_MOV},
+    {"mp3", &YS_MIME_TYPE_MP3},
+    {"mp4", &YS_MIME_TYPE_MP4},
+    {"mpeg", &YS_MIME_TYPE_MPEG},
+    {"mpg", &YS_MIME_TYPE_MPG},
+    {"msi", &YS_MIME_TYPE_MSI},
+    {"msm", &YS_MIME_TYPE_MSM},
+    {"msp", &YS_MIME_TYPE_MSP},
+    {"oga", &YS_MIME_TYPE_OGA},
+    {"ogg", &YS_MIME_TYPE_OGG},
+    {"ogv", &YS_MIME_TYPE_OGV},
+    {"ogx", &YS_MIME_TYPE_OGX},
+    {"opus", &YS_MIME_TYPE_OPUS},
+    {"otc", &YS_MIME_TYPE_OTC},
+    {"otf", &YS_MIME_TYPE_OTF},
+    {"pdb", &YS_MIME_TYPE_PDB},
+    {"pdf", &YS_MIME_TYPE_PDF},
+    {"pem", &YS_MIME_TYPE_PEM},
+    {"pl", &YS_MIME_TYPE_PL},
+    {"pm", &YS_MIME_TYPE_PM},
+    {"png", &YS_MIME_TYPE_PNG},
+    {"ppt", &YS_MIME_TYPE_PPT},
+    {"pptx", &YS_MIME_TYPE_PPTX},
+    {"prc", &YS_MIME_TYPE_PRC},
+    {"ps", &YS_MIME_TYPE_PS},
+    {"ra", &YS_MIME_TYPE_RA},
+    {"rar", &YS_MIME_TYPE_RAR},
+    {"rdf", &YS_MIME_TYPE_RDF},
+    {"rpm", &YS_MIME_TYPE_RPM},
+    {"rss", &YS_MIME_TYPE_RSS},
+    {"rtf", &YS_MIME_TYPE_RTF},
+    {"run", &YS_MIME_TYPE_RUN},
+    {"sea", &YS_MIME_TYPE_SEA},
+    {"shtml", &YS_MIME_TYPE_SHTML},
+    {"sit", &YS_MIME_TYPE_SIT},
+    {"spx", &YS_MIME_TYPE_SPX},
+    {"svg", &YS_MIME_TYPE_SVG},
+    {"svgz", &YS_MIME_TYPE_SVGZ},
+    {"swf", &YS_MIME_TYPE_SWF},
+    {"tcl", &YS_MIME_TYPE_TCL},
+    {"tif", &YS_MIME_TYPE_TIF},
+    {"tiff", &YS_MIME_TYPE_TIFF},
+    {"tk", &YS_MIME_TYPE_TK},
+    {"ts", &YS_MIME_TYPE_TS},
+    {"ttc", &YS_MIME_TYPE_TTC},
+    {"ttf", &YS_MIME_TYPE_TTF},
+    {"ttl", &YS_MIME_TYPE_TTL},
+    {"txt", &YS_MIME_TYPE_TXT},
+    {"udeb", &YS_MIME_TYPE_UDEB},
+    {"usdz", &YS_MIME_TYPE_USDZ},
+    {"vtt", &YS_MIME_TYPE_VTT},
+    {"war", &YS_MIME_TYPE_WAR},
+    {"wasm", &YS_MIME_TYPE_WASM},
+    {"wbmp", &YS_MIME_TYPE_WBMP},
+    {"webm", &YS_MIME_TYPE_WEBM},
+    {"webp", &YS_MIME_TYPE_WEBP},
+    {"wml", &YS_MIME_TYPE_WML},
+    {"wmlc", &YS_MIME_TYPE_WMLC},
+    {"wmv", &YS_MIME_TYPE_WMV},
+    {"woff", &YS_MIME_TYPE_WOFF},
+    {"woff2", &YS_MIME_TYPE_WOFF2},
+    {"xht", &YS_MIME_TYPE_XHT},
+    {"xhtml", &YS_MIME_TYPE_XHTML},
+    {"xls", &YS_MIME_TYPE_XLS},
+    {"xlsx", &YS_MIME_TYPE_XLSX},
+    {"xml", &YS_MIME_TYPE_XML},
+    {"xpi", &YS_MIME_TYPE_XPI},
+    {"xspf", &YS_MIME_TYPE_XSPF},
+    {"zip", &YS_MIME_TYPE_ZIP},
+    {"zst", &YS_MIME_TYPE_ZST},
+};
+
+/**
+ * hash_path hashes a path with FNV-1a
+ */
+static unsigned int hash_path(const char *path) {
+  uint32_t hash = 2166136261u;
+
+  for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+    hash ^= *p;
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+/**
+ * identity_of extracts a file's identity from its stat(2)
+ */
+static file_identity identity_of(struct stat *st) {
+  file_identity id = {.exists = true,
+                      .dev = st->st_dev,
+                      .ino = st->st_ino,
+                      .size = st->st_size,
+                      .mtime = st->st_mtime};
+  return id;
+}
+
+static bool identity_equals(file_identity *a, file_identity *b) {
+  if (!a->exists || !b->exists) {
+    return a->exists == b->exists;
+  }
+
+  return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+         a->mtime == b->mtime;
+}
+
+/**
+ * format_etag derives a strong validator from a file's modification time and
+ * size
+ */
+static void format_etag(char *etag, file_identity *id) {
+  snprintf(etag, FILE_CACHE_ETAG_LEN, "\"%llx-%llx\"",
+           (unsigned long long)id->mtime, (unsigned long long)id->size);
+}
+
+/**
+ * walk_beneath opens `path` relative to `dir_fd` one component at a time,
+ * following no symlinks and refusing `..`, so that it can't leave `dir_fd`
+ */
+static int walk_beneath(int dir_fd, const char *path, int flags) {
+  int fd = dup(dir_fd);
+
+  while (fd != -1) {
+    size_t len = strcspn(path, "/");
+    if (len == 0) {
+      if (!*path) break;
+
+      path++;
+      continue;
+    }
+
+    if ((len == 1 && path[0] == '.') ||
+        (len == 2 && path[0] == '.' && path[1] == '.') || len > NAME_MAX) {
+      close(fd);
+      errno = EXDEV;
+      return -1;
+    }
+
+    char name[NAME_MAX + 1];
+    memcpy(name, path, len);
+    name[len] = '\0';
+    path += len;
+
+    bool last = path[strspn(path, "/")] == '\0';
+    int next = openat(fd, name,
+                      last ? flags | O_NOFOLLOW
+                           : O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    close(fd);
+    fd = next;
+
+    if (last) return fd;
+  }
+
+  if (fd != -1) {
+    close(fd);
+    errno = ENOENT;
+  }
+
+  return -1;
+}
+
+/**
+ * open_beneath opens `path` relative to `dir_fd`, refusing absolute paths and
+ * any `..` or symlink that would resolve outside of `dir_fd`
+ */
+static int open_beneath(int dir_fd, const char *path, int flags) {
+  if (*path == '/') {
+    errno = EXDEV;
+    return -1;
+  }
+
+#ifdef SYS_openat2
+  struct open_how how = {
+      .flags = (unsigned long long)flags,
+      .resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS,
+  };
+
+  int fd = syscall(SYS_openat2, dir_fd, path, &how, sizeof(how));
+  if (fd != -1 || errno != ENOSYS) {
+    return fd;
+  }
+#endif
+
+  // Kernels before 5.6 lack openat2, so resolve the path by hand
+  return walk_beneath(dir_fd, path, flags);
+}
+
+/**
+ * open_file opens the regular file at `path`, beneath the cache's root.
+ * Returns -1 if there is no such file
+ */
+static int open_file(file_cache *cache, const char *path, file_identity *id) {
+  int fd = open_beneath(cache->root_fd, path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return -1;
+  }
+
+  *id = identity_of(&st);
+  return fd;
+}
+
+/**
+ * stat_file fetches the identity of the file at `path`, beneath the cache's
+ * root
+ */
+static file_identity stat_file(file_cache *cache, const char *path) {
+  int fd = open_beneath(cache->root_fd, path, O_PATH | O_CLOEXEC);
+
+  struct stat st;
+  bool exists = fd != -1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+  if (fd != -1) {
+    close(fd);
+  }
+
+  if (!exists) {
+    file_identity missing = {.exists = false};
+    return missing;
+  }
+
+  return identity_of(&st);
+}
+
+static void entry_free(file_cache_entry *entry) {
+  close(entry->fd);
+  if (entry->gz_fd != -1) {
+    close(entry->gz_fd);
+  }
+
+  free(entry->path);
+  free(entry);
+}
+
+/**
+ * load_entry opens the file at `path` and its `.gz` sibling, and prepares the
+ * headers that describe them. Returns NULL if there is no such file
+ */
+static file_cache_entry *load_entry(file_cache *cache, const char *path) {
+  file_identity id;
+  int fd = open_file(cache, path, &id);
+  if (fd == -1) {
+    return NULL;
+  }
+
+  file_cache_entry *entry = xmalloc(sizeof(file_cache_entry));
+  entry->path = s_copy(path);
+  entry->fd = fd;
+  entry->id = id;
+  entry->content_type = file_cache_content_type(path);
+  format_etag(entry->etag, &id);
+
+  struct tm tm_utc;
+  gmtime_r(&id.mtime, &tm_utc);
+  strftime(entry->last_modified, FILE_CACHE_DATE_LEN, HTTP_DATE_FMT, &tm_utc);
+
+  char *gz_path = fmt_str("%s%s", path, GZIP_SUFFIX);
+  entry->gz_fd = open_file(cache, gz_path, &entry->gz_id);
+  free(gz_path);
+
+  if (entry->gz_fd == -1) {
+    entry->gz_id.exists = false;
+    entry->gz_etag[0] = '\0';
+  } else {
+    format_etag(entry->gz_etag, &entry->gz_id);
+    // Tell the two apart, lest a cache hand one to a client that asked for the
+    // other
+    size_t len = strlen(entry->gz_etag);
+    snprintf(entry->gz_etag + len - 1, FILE_CACHE_ETAG_LEN - len + 1,
+             "-gz\"");
+  }
+
+  size_t pages = (id.size + FILE_CACHE_PAGE_SIZE - 1) / FILE_CACHE_PAGE_SIZE;
+  entry->charge = (pages ? pages : 1) * FILE_CACHE_PAGE_SIZE +
+                  (entry->gz_fd != -1 ? entry->gz_id.size : 0);
+  entry->next = NULL;
+  entry->lru_prev = NULL;
+  entry->lru_next = NULL;
+
+  return entry;
+}
+
+/**
+ * snapshot hands the entry's file, or its `.gz` sibling, to a response.
+ * Returns false if the fd couldn't be duplicated
+ */
+static bool snapshot(file_cache_entry *entry, bool accept_gzip,
+                     cached_file *file) {
+  file->has_gzip = entry->gz_fd != -1;
+  file->gzip = accept_gzip && file->has_gzip;
+  file->content_type = entry->content_type;
+  file->mtime = entry->id.mtime;
+  file->size = file->gzip ? entry->gz_id.size : entry->id.size;
+  memcpy(file->etag, file->gzip ? entry->gz_etag : entry->etag,
+         FILE_CACHE_ETAG_LEN);
+  memcpy(file->last_modified, entry->last_modified, FILE_CACHE_DATE_LEN);
+
+  // A descriptor of its own lets the response outlive the entry's eviction
+  file->fd = fcntl(file->gzip ? entry->gz_fd : entry->fd, F_DUPFD_CLOEXEC, 0);
+
+  return file->fd != -1;
+}
+
+/* LRU list and hash table; the cache's lock must be held */
+
+static void lru_unlink(file_cache *cache, file_cache_entry *entry) {
+  if (entry->lru_prev) {
+    entry->lru_prev->lru_next = entry->lru_next;
+  } else {
+    cache->lru_head = entry->lru_next;
+  }
+
+  if (entry->lru_next) {
+    entry->lru_next->lru_prev = entry->lru_prev;
+  } else {
+    cache->lru_tail = entry->lru_prev;
+  }
+
+  entry->lru_prev = NULL;
+  entry->lru_next = NULL;
+}
+
+static void lru_push_front(file_cache *cache, file_cache_entry *entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = cache->lru_head;
+
+  if (cache->lru_head) {
+    cache->lru_head->lru_prev = entry;
+  } else {
+    cache->lru_tail = entry;
+  }
+
+  cache->lru_head = entry;
+}
+
+static file_cache_entry *find_entry(file_cache *cache, const char *path) {
+  file_cache_entry *entry =
+      cache->buckets[hash_path(path) & (cache->num_buckets - 1)];
+
+  while (entry && strcmp(entry->path, path) != 0) {
+    entry = entry->next;
+  }
+
+  return entry;
+}
+
+/**
+ * remove_entry unlinks the entry from the cache and closes it
+ */
+static void remove_entry(file_cache *cache, file_cache_entry *entry) {
+  file_cache_entry **link =
+      &cache->buckets[hash_path(entry->path) & (cache->num_buckets - 1)];
+
+  while (*link != entry) {
+    link = &(*link)->next;
+  }
+
+  *link = entry->next;
+  lru_unlink(cache, entry);
+
+  cache->bytes -= entry->charge;
+  cache->count--;
+
+  entry_free(entry);
+}
+
+/**
+ * grow_buckets doubles the number of hash buckets, rehashing every entry
+ */
+static void grow_buckets(file_cache *cache) {
+  unsigned int num_buckets = cache->num_buckets * 2;
+  file_cache_entry **buckets =
+      xmalloc(num_buckets * sizeof(file_cache_entry *));
+  memset(buckets, 0, num_buckets * sizeof(file_cache_entry *));
+
+  for (unsigned int i = 0; i < cache->num_buckets; i++) {
+    file_cache_entry *entry = cache->buckets[i];
+
+    while (entry) {
+      file_cache_entry *next = entry->next;
+      unsigned int index = hash_path(entry->path) & (num_buckets - 1);
+
+      entry->next = buckets[index];
+      buckets[index] = entry;
+      entry = next;
+    }
+  }
+
+  free(cache->buckets);
+  cache->buckets = buckets;
+  cache->num_buckets = num_buckets;
+}
+
+/**
+ * insert_entry adds the entry to the cache as its most recently used, then
+ * evicts the least recently used entries until the cache is within budget
+ */
+static void insert_entry(file_cache *cache, file_cache_entry *entry) {
+  if (cache->count >= cache->num_buckets) {
+    grow_buckets(cache);
+  }
+
+  unsigned int index = hash_path(entry->path) & (cache->num_buckets - 1);
+  entry->next = cache->buckets[index];
+  cache->buckets[index] = entry;
+  lru_push_front(cache, entry);
+
+  cache->bytes += entry->charge;
+  cache->count++;
+
+  while (cache->lru_tail != entry &&
+         (cache->bytes > cache->budget || cache->count > cache->max_files)) {
+    printlogf(YS_LOG_DEBUG, "[file_cache::%s] evicting %s\n", __func__,
+              cache->lru_tail->path);
+
+    remove_entry(cache, cache->lru_tail);
+    cache->evictions++;
+  }
+}
+
+/**
+ * is_fresh tests whether the entry's files are still the ones on disk
+ */
+static bool is_fresh(file_cache *cache, file_cache_entry *entry) {
+  file_identity id = stat_file(cache, entry->path);
+  if (!identity_equals(&id, &entry->id)) {
+    return false;
+  }
+
+  char *gz_path = fmt_str("%s%s", entry->path, GZIP_SUFFIX);
+  file_identity gz_id = stat_file(cache, gz_path);
+  free(gz_path);
+
+  return identity_equals(&gz_id, &entry->gz_id);
+}
+
+#ifdef __linux__
+/**
+ * watch_dir has inotify watch the directory holding `path` for changes, if it
+ * isn't watched already. The cache's lock must be held
+ */
+static void watch_dir(file_cache *cache, const char *path) {
+  const char *slash = strrchr(path, '/');
+  char *dir = slash ? fmt_str("%.*s", (int)(slash - path), path) : s_copy("");
+  char *full_path = fmt_str("%s/%s", cache->root, dir);
+
+  int wd = inotify_add_watch(cache->inotify_fd, full_path, WATCH_MASK);
+  free(full_path);
+
+  if (wd == -1 || (wd < cache->num_watches && cache->watches[wd])) {
+    free(dir);
+    return;
+  }
+
+  if (wd >= cache->num_watches) {
+    int num_watches = wd + 1;
+    char **watches = realloc(cache->watches, num_watches * sizeof(char *));
+    if (!watches) {
+      DIE("[file_cache::%s] failed to allocate watches\n", __func__);
+    }
+
+    cache->watches = watches;
+    for (int i = cache->num_watches; i < num_watches; i++) {
+      cache->watches[i] = NULL;
+    }
+
+    cache->num_watches = num_watches;
+  }
+
+  cache->watches[wd] = dir;
+}
+
+/**
+ * handle_event invalidates whatever entries a single inotify event may have
+ * made stale
+ */
+static void handle_event(file_cache *cache, struct inotify_event *event) {
+  bool flush =
+      event->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF |
+                     IN_MOVE_SELF);
+
+  // A subdirectory that moves or vanishes takes any entries under it along
+  if ((event->mask & IN_ISDIR) &&
+      (event->mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE))) {
+    flush = true;
+  }
+
+  if (flush) {
+    pthread_mutex_lock(&cache->lock);
+
+    if ((event->mask & IN_IGNORED) && event->wd < cache->num_watches) {
+      free(cache->watches[event->wd]);
+      cache->watches[event->wd] = NULL;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    file_cache_flush(cache);
+    return;
+  }
+
+  if (!event->len) {
+    return;
+  }
+
+  pthread_mutex_lock(&cache->lock);
+  char *path = NULL;
+  if (event->wd < cache->num_watches && cache->watches[event->wd]) {
+    const char *dir = cache->watches[event->wd];
+    path = *dir ? fmt_str("%s/%s", dir, event->name) : s_copy(event->name);
+  }
+  pthread_mutex_unlock(&cache->lock);
+
+  if (!path) {
+    return;
+  }
+
+  file_cache_invalidate(cache, path);
+
+  // A change to a `.gz` sibling leaves the entry it belongs to stale as well
+  size_t len = strlen(path);
+  size_t suffix_len = sizeof(GZIP_SUFFIX) - 1;
+  if (len > suffix_len && strcmp(path + len - suffix_len, GZIP_SUFFIX) == 0) {
+    path[len - suffix_len] = '\0';
+    file_cache_invalidate(cache, path);
+  }
+
+  free(path);
+}
+
+/**
+ * watch_loop is the routine of the thread that applies the inotify events of
+ * a cache's directories. Should the events stop coming, the cache falls back
+ * to revalidating each hit with stat(2)
+ */
+static void *watch_loop(void *arg) {
+  file_cache *cache = arg;
+
+  union {
+    struct inotify_event event;
+    char buf[4096];
+  } events;
+
+  while (1) {
+    ssize_t n = read(cache->inotify_fd, events.buf, sizeof(events.buf));
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      printlogf(YS_LOG_INFO,
+                "[file_cache::%s] lost inotify events for %s; revalidating "
+                "files on every request from here on\n",
+                __func__, cache->root);
+
+      pthread_mutex_lock(&cache->lock);
+      cache->inotify_fd = -1;
+      pthread_mutex_unlock(&cache->lock);
+
+      file_cache_flush(cache);
+      return NULL;
+    }
+
+    for (char *p = events.buf; p < events.buf + n;) {
+      struct inotify_event *event = (struct inotify_event *)p;
+      handle_event(cache, event);
+
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * start_watching sets up the inotify instance that invalidates the cache's
+ * entries, and the thread that reads its events. On failure, the cache falls
+ * back to revalidating each hit with stat(2)
+ */
+static void start_watching(file_cache *cache) {
+  cache->inotify_fd = inotify_init1(IN_CLOEXEC);
+  if (cache->inotify_fd == -1) {
+    printlogf(YS_LOG_INFO,
+              "[file_cache::%s] inotify unavailable for %s; revalidating "
+              "files on every request\n",
+              __func__, cache->root);
+    return;
+  }
+
+  thread_t *watcher = thread_init(0, "file cache watcher");
+  thread_set_attr(watcher, false);
+
+  if (!thread_run(watcher, watch_loop, cache)) {
+    close(cache->inotify_fd);
+    cache->inotify_fd = -1;
+  }
+}
+#endif
+
+file_cache *file_cache_init(const char *root, size_t budget) {
+  char *real_root = realpath(root, NULL);
+  if (!real_root) {
+    return NULL;
+  }
+
+  int root_fd = open(real_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (root_fd == -1) {
+    free(real_root);
+    return NULL;
+  }
+
+  file_cache *cache = xmalloc(sizeof(file_cache));
+  cache->root = real_root;
+  cache->root_fd = root_fd;
+  cache->budget = budget;
+
+  // Each entry holds up to two files open; leave most of the fds to the
+  // connections
+  struct rlimit limit;
+  rlim_t max_files = FILE_CACHE_MAX_FILES;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur / 8 < max_files) {
+    max_files = limit.rlim_cur / 8;
+  }
+  cache->max_files =
+      max_files < FILE_CACHE_MIN_FILES ? FILE_CACHE_MIN_FILES : max_files;
+
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->bytes = 0;
+  cache->count = 0;
+  cache->num_buckets = FILE_CACHE_INITIAL_BUCKETS;
+  cache->buckets = xmalloc(cache->num_buckets * sizeof(file_cache_entry *));
+  memset(cache->buckets, 0, cache->num_buckets * sizeof(file_cache_entry *));
+  cache->lru_head = NULL;
+  cache->lru_tail = NULL;
+  cache->generation = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->evictions = 0;
+  cache->inotify_fd = -1;
+  cache->watches = NULL;
+  cache->num_watches = 0;
+
+#ifdef __linux__
+  if (budget > 0) {
+    start_watching(cache);
+  }
+#endif
+
+  return cache;
+}
+
+bool file_cache_open(file_cache *cache, const char *path, bool accept_gzip,
+                     cached_file *file) {
+  pthread_mutex_lock(&cache->lock);
+
+  file_cache_entry *entry = find_entry(cache, path);
+  if (entry && cache->inotify_fd == -1 && !is_fresh(cache, entry)) {
+    remove_entry(cache, entry);
+    entry = NULL;
+  }
+
+  if (entry) {
+    lru_unlink(cache, entry);
+    lru_push_front(cache, entry);
+    cache->hits++;
+
+    bool ok = snapshot(entry, accept_gzip, file);
+    pthread_mutex_unlock(&cache->lock);
+
+    return ok;
+  }
+
+  cache->misses++;
+  unsigned long generation = cache->generation;
+
+#ifdef __linux__
+  // Watch before opening, so that no change made after we've read the file
+  // goes unnoticed
+  if (cache->inotify_fd != -1) {
+    watch_dir(cache, path);
+  }
+#endif
+
+  pthread_mutex_unlock(&cache->lock);
+
+  entry = load_entry(cache, path);
+  if (!entry) {
+    return false;
+  }
+
+  bool ok = snapshot(entry, accept_gzip, file);
+
+  pthread_mutex_lock(&cache->lock);
+
+  // The file may have changed while it was being loaded, or another thread
+  // may have loaded it first
+  bool cacheable = entry->charge <= cache->budget &&
+                   cache->generation == generation &&
+                   !find_entry(cache, path);
+  if (cacheable) {
+    insert_entry(cache, entry);
+  }
+
+  pthread_mutex_unlock(&cache->lock);
+
+  if (!cacheable) {
+    entry_free(entry);
+  }
+
+  return ok;
+}
+
+void file_cache_invalidate(file_cache *cache, const char *path) {
+  pthread_mutex_lock(&cache->lock);
+
+  cache->generation++;
+
+  file_cache_entry *entry = find_entry(cache, path);
+  if (entry) {
+    printlogf(YS_LOG_DEBUG, "[file_cache::%s] invalidating %s\n", __func__,
+              path);
+    remove_entry(cache, entry);
+  }
+
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void file_cache_flush(file_cache *cache) {
+  pthread_mutex_lock(&cache->lock);
+
+  cache->generation++;
+
+  while (cache->lru_head) {
+    remove_entry(cache, cache->lru_head);
+  }
+
+  pthread_mutex_unlock(&cache->lock);
+}
+
+const char *file_cache_content_type(const char *path) {
+  const char *base = strrchr(path, '/');
+  const char *ext = strrchr(base ? base : path, '.');
+
+  if (ext) {
+    ext++;
+
+    for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+      if (strcasecmp(mime_types[i].ext, ext) == 0) {
+        return *mime_types[i].mime_type;
+      }
+    }
+  }
+
+  return YS_MIME_TYPE_BIN;
+}
@@ -0,0 +1,153 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Large enough for an ETag of the form "<mtime>-<size>", both in hex
+#define FILE_CACHE_ETAG_LEN 40
+
+// Large enough for an HTTP date e.g. Sun, 06 Nov 1994 08:49:37 GMT
+#define FILE_CACHE_DATE_LEN 32
+
+/**
+ * file_identity is what a file's stat(2) says about it that changes whenever
+ * the file is replaced or modified. `exists` is false for a file that isn't
+ * there
+ */
+typedef struct {
+  bool exists;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+} file_identity;
+
+/**
+ * file_cache_entry is an open file of a cached directory, along with the
+ * response headers that describe it and its precompressed `.gz` sibling, if
+ * there is one
+ */
+typedef struct file_cache_entry {
+  // The file's path, relative to the cache's root
+  char *path;
+
+  int fd;
+  file_identity id;
+  const char *content_type;
+  char etag[FILE_CACHE_ETAG_LEN];
+  char last_modified[FILE_CACHE_DATE_LEN];
+
+  // The `.gz` sibling; gz_fd is -1 if there is none
+  int gz_fd;
+  file_identity gz_id;
+  char gz_etag[FILE_CACHE_ETAG_LEN];
+
+  // The number of bytes the entry counts against the cache's budget
+  size_t charge;
+
+  // The next entry in the entry's hash bucket
+  struct file_cache_entry *next;
+
+  // The entry's neighbours in the LRU list, which runs from the most to the
+  // least recently used entry
+  struct file_cache_entry *lru_prev;
+  struct file_cache_entry *lru_next;
+} file_cache_entry;
+
+/**
+ * file_cache holds the files of a directory open, up to a budget of bytes,
+ * evicting the least recently used once it is exceeded. On Linux, entries are
+ * invalidated by inotify as soon as their files change; elsewhere, or if
+ * inotify is unavailable, each hit is revalidated with a stat(2)
+ */
+typedef struct {
+  // The directory whose files are cached
+  char *root;
+  int root_fd;
+
+  // The most bytes and files the cache may hold open
+  size_t budget;
+  unsigned int max_files;
+
+  // Guards everything below
+  pthread_mutex_t lock;
+
+  size_t bytes;
+  unsigned int count;
+  file_cache_entry **buckets;
+  unsigned int num_buckets;
+  file_cache_entry *lru_head;
+  file_cache_entry *lru_tail;
+
+  // Bumped on every invalidation, so that a file loaded while one was under
+  // way isn't cached
+  unsigned long generation;
+
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+
+  // The inotify instance watching the root and every directory an entry has
+  // been loaded from, or -1 if entries are revalidated with stat(2)
+  int inotify_fd;
+
+  // The root-relative path of each watched directory, indexed by watch
+  // descriptor
+  char **watches;
+  int num_watches;
+} file_cache;
+
+/**
+ * cached_file is a snapshot of a cached file, as handed out to a single
+ * response. Its `fd` is the response's own; the caller must close it
+ */
+typedef struct {
+  int fd;
+  off_t size;
+  time_t mtime;
+  const char *content_type;
+  char etag[FILE_CACHE_ETAG_LEN];
+  char last_modified[FILE_CACHE_DATE_LEN];
+
+  // Whether `fd` is the `.gz` sibling, and whether the file has one at all
+  bool gzip;
+  bool has_gzip;
+} cached_file;
+
+/**
+ * file_cache_init initializes a cache of the files under the directory `root`
+ * that holds at most `budget` bytes open; if 0, files are opened afresh on
+ * every request. Returns NULL if `root` can't be opened
+ */
+file_cache *file_cache_init(const char *root, size_t budget);
+
+/**
+ * file_cache_open opens the regular file at `path`, relative to the cache's
+ * root, loading it into the cache if it isn't there yet. The `.gz` sibling is
+ * opened in its stead if it exists and `accept_gzip` is true. Returns false if
+ * there is no such file
+ */
+bool file_cache_open(file_cache *cache, const char *path, bool accept_gzip,
+                     cached_file *file);
+
+/**
+ * file_cache_invalidate evicts the entry for `path`, if any
+ */
+void file_cache_invalidate(file_cache *cache, const char *path);
+
+/**
+ * file_cache_flush evicts every entry
+ */
+void file_cache_flush(file_cache *cache);
+
+/**
+ * file_cache_content_type returns the MIME type of the file at `path`, judged
+ * by its extension, or application/octet-stream if it isn't a known one
+ */
+const char *file_cache_content_type(const char *path);
+
+#endif /* FILE_CACHE_H */
@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 
 #include "libutil/libutil.h"
 #include "libys.h"
@@ -22,6 +23,9 @@ const char PRAGMA[] = "Pragma";
 const char CONTENT_TYPE[] = "Content-Type";
 const char ACCEPT[] = "Accept";
 const char USER_AGENT[] = "User-Agent";
+const char CONNECTION[] = "Connection";
+const char CONTENT_LENGTH[] = "Content-Length";
+const char TRANSFER_ENCODING[] = "Transfer-Encoding";
 
 static pthread_once_t init_common_headers_once = PTHREAD_ONCE_INIT;
 static pthread_once_t init_singleton_headers_once = PTHREAD_ONCE_INIT;
@@ -224,7 +228,7 @@ char** req_header_values(hash_table* headers, const char* key) {
   }
 
   unsigned int sz = array_size(header->value);
-  char** headers_list = xmalloc(sz);
+  char** headers_list = xmalloc(sz * sizeof(char*));
 
   for (unsigned int i = 0; i < sz; i++) {
     headers_list[i] = (char*)array_get(header->value, i);
@@ -274,6 +278,44 @@ bool insert_header(hash_table* headers, const char* key, const char* value,
   return true;
 }
 
+void headers_free(hash_table* headers) {
+  for (int i = 0; i < headers->capacity; i++) {
+    ht_record* header = headers->records[i];
+
+    if (header && header->value) {
+      array_free(header->value);
+    }
+  }
+
+  ht_delete_table(headers);
+}
+
+bool header_has_token(hash_table* headers, const char* key, const char* token) {
+  size_t token_len = strlen(token);
+
+  for (int i = 0; i < headers->capacity; i++) {
+    ht_record* header = headers->records[i];
+    if (!header || !s_casecmp(header->key, key)) continue;
+
+    foreach ((array_t*)header->value, j) {
+      const char* v = array_get(header->value, j);
+
+      while (*v) {
+        while (*v == ' ' || *v == '\t' || *v == ',') v++;
+
+        size_t len = strcspn(v, ", \t");
+        if (len == token_len && strncasecmp(v, token, len) == 0) {
+          return true;
+        }
+
+        v += len;
+      }
+    }
+  }
+
+  return false;
+}
+
 array_t* derive_headers(const char* header_str) {
   array_t* headers = array_init();
 
@@ -305,7 +347,7 @@ array_t* derive_headers(const char* header_str) {
           v[i] = (char)((uintptr_t)array_get(tmp, i));
         }
 
-        v[i + 1] = NULL_TERMINATOR;
+        v[size] = NULL_TERMINATOR;
 
         array_push(headers, v);
 
@@ -10,6 +10,9 @@ extern const char PRAGMA[];
 extern const char CONTENT_TYPE[];
 extern const char ACCEPT[];
 extern const char USER_AGENT[];
+extern const char CONNECTION[];
+extern const char CONTENT_LENGTH[];
+extern const char TRANSFER_ENCODING[];
 
 /**
  * A 256 slot lookup table where each index corresponds to an ASCII character
@@ -79,6 +82,19 @@ char** req_header_values(hash_table* headers, const char* key);
 bool insert_header(hash_table* headers, const char* key, const char* value,
                    bool is_request);
 
+/**
+ * headers_free deallocates the header table `headers` and its lists of values,
+ * but not the keys and values inserted into it, which are the caller's
+ */
+void headers_free(hash_table* headers);
+
+/**
+ * header_has_token tests whether any value of the header `key` contains the
+ * comma-delimited token `token` e.g. `Connection: keep-alive, Upgrade`. Both
+ * the key and the token are compared case-insensitively
+ */
+bool header_has_token(hash_table* headers, const char* key, const char* token);
+
 /**
  * derive_headers extracts the comma-delimited headers in the value of the
  * given header
@@ -20,14 +20,15 @@ void __add_middleware_with_opts(ys_router_attr *attr, ys_route_handler *mw,
     va_start(args, ignore_path);
 
     while (ignore_path) {
-      pcre *re = regex_compile(ignore_path);
+      regex *re = regex_compile(ignore_path);
       if (!re) {
         printlogf(YS_LOG_INFO,
                   "failed to compile regex %s; this path will be omitted from "
                   "ignore paths\n",
                   ignore_path);
+      } else {
+        array_push(mh->ignore_paths, re);
       }
-      array_push(mh->ignore_paths, re);
       ignore_path = va_arg(args, char *);
     }
 
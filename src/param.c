@@ -0,0 +1,327 @@
+#include "param.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "libutil/libutil.h"
+#include "logger.h"
+#include "path.h"
+#include "xmalloc.h"
+
+// The bytes of the built-in class types, as ranges of pairs of bytes
+static const char DIGIT_RANGES[] = "09";
+static const char HEX_RANGES[] = "09afAF";
+static const char ALPHA_RANGES[] = "azAZ";
+static const char SLUG_RANGES[] = "az09--";
+static const char WORD_RANGES[] = "azAZ09__";
+
+/**
+ * param_type maps the name of a built-in type, or a pattern that matches
+ * exactly what it does, to how it's matched
+ */
+typedef struct {
+  const char *name;
+  param_kind kind;
+  // The byte ranges of a PARAM_CLASS type
+  const char *ranges;
+} param_type;
+
+static const param_type types[] = {{"int", PARAM_INT, NULL},
+                                   {"uint", PARAM_UINT, NULL},
+                                   {"uuid", PARAM_UUID, NULL},
+                                   {"hex", PARAM_CLASS, HEX_RANGES},
+                                   {"alpha", PARAM_CLASS, ALPHA_RANGES},
+                                   {"slug", PARAM_CLASS, SLUG_RANGES}};
+
+// Patterns commonly used for parameters, which are matched natively. Note that
+// a pattern such as ^\d+$ matches integers of any length, so it's matched as a
+// class of digits rather than as an integer
+static const param_type patterns[] = {
+    {"(.+)", PARAM_ANY, NULL},
+    {".+", PARAM_ANY, NULL},
+    {"^.+$", PARAM_ANY, NULL},
+    {"^\\d+$", PARAM_CLASS, DIGIT_RANGES},
+    {"^[0-9]+$", PARAM_CLASS, DIGIT_RANGES},
+    {"^[0-9a-fA-F]+$", PARAM_CLASS, HEX_RANGES},
+    {"^[a-fA-F0-9]+$", PARAM_CLASS, HEX_RANGES},
+    {"^[a-zA-Z]+$", PARAM_CLASS, ALPHA_RANGES},
+    {"^[A-Za-z]+$", PARAM_CLASS, ALPHA_RANGES},
+    {"^[a-z0-9-]+$", PARAM_CLASS, SLUG_RANGES},
+    {"^\\w+$", PARAM_CLASS, WORD_RANGES}};
+
+/**
+ * find_type returns the entry of `table` named `name`, or NULL if it has none
+ */
+static const param_type *find_type(const param_type *table, size_t len,
+                                   const char *name) {
+  for (size_t i = 0; i < len; i++) {
+    if (s_equals(table[i].name, name)) {
+      return &table[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * matcher_set sets up `m` to match as `type` does
+ */
+static void matcher_set(param_matcher *m, const param_type *type) {
+  m->kind = type->kind;
+
+  if (type->ranges) {
+    for (const char *r = type->ranges; *r; r += 2) {
+      for (unsigned int c = (unsigned char)r[0]; c <= (unsigned char)r[1];
+           c++) {
+        m->class.bits[c >> 6] |= (uint64_t)1 << (c & 63);
+      }
+    }
+  }
+}
+
+void param_matcher_init(param_matcher *m, const char *label,
+                        hash_table *regex_cache) {
+  *m = (param_matcher){.kind = PARAM_REGEX};
+
+  char *type_name = derive_parameter_type(label);
+  if (type_name) {
+    const param_type *type =
+        find_type(types, sizeof(types) / sizeof(param_type), type_name);
+    if (!type) {
+      DIE("[param::%s] unknown parameter type %s in %s\n", __func__,
+          type_name, label);
+    }
+
+    matcher_set(m, type);
+    free(type_name);
+
+    return;
+  }
+
+  char *pattern = derive_label_pattern(label);
+  if (!pattern) {
+    return;
+  }
+
+  const param_type *type =
+      find_type(patterns, sizeof(patterns) / sizeof(param_type), pattern);
+  if (type) {
+    matcher_set(m, type);
+  } else {
+    m->re = regex_cache_get(regex_cache, pattern);
+  }
+
+  free(pattern);
+}
+
+bool param_parse_int(str_view value, bool is_signed, long long *out) {
+  size_t i = 0;
+  bool negative = is_signed && value.len > 0 && value.ptr[0] == '-';
+  if (negative) {
+    i++;
+  }
+
+  if (i == value.len) {
+    return false;
+  }
+
+  unsigned long long limit =
+      negative ? (unsigned long long)LLONG_MAX + 1 : LLONG_MAX;
+  unsigned long long n = 0;
+
+  for (; i < value.len; i++) {
+    unsigned int digit = (unsigned char)value.ptr[i] - '0';
+    if (digit > 9 || n > (limit - digit) / 10) {
+      return false;
+    }
+
+    n = n * 10 + digit;
+  }
+
+  // Negated in two steps, as LLONG_MIN has no positive counterpart
+  *out = negative && n ? -(long long)(n - 1) - 1 : (long long)n;
+
+  return true;
+}
+
+/**
+ * match_class tests whether `value` is made only of the bytes of `class`
+ */
+static bool match_class(const byte_class *class, str_view value) {
+  for (size_t i = 0; i < value.len; i++) {
+    unsigned char c = value.ptr[i];
+    if (!(class->bits[c >> 6] & (uint64_t)1 << (c & 63))) {
+      return false;
+    }
+  }
+
+  return value.len > 0;
+}
+
+/**
+ * match_uuid tests whether `value` is a UUID in its canonical form
+ */
+static bool match_uuid(str_view value) {
+  if (value.len != 36) {
+    return false;
+  }
+
+  for (size_t i = 0; i < value.len; i++) {
+    char c = value.ptr[i];
+
+    if (i == 8 || i == 13 || i == 18 || i == 23) {
+      if (c != '-') {
+        return false;
+      }
+    } else if (!ishex(c)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool param_match(const param_matcher *m, str_view value, long long *int_value) {
+  switch (m->kind) {
+    case PARAM_ANY:
+      return value.len > 0;
+
+    case PARAM_CLASS:
+      return match_class(&m->class, value);
+
+    case PARAM_INT:
+      return param_parse_int(value, true, int_value);
+
+    case PARAM_UINT:
+      return param_parse_int(value, false, int_value);
+
+    case PARAM_UUID:
+      return match_uuid(value);
+
+    case PARAM_REGEX:
+      return m->re && regex_match(m->re, value.ptr, value.len);
+  }
+
+  return false;
+}
+
+/**
+ * is_combinable tests whether `pattern` matches the same in an alternation as
+ * on its own: it must be anchored at both ends, so the alternation can't pick
+ * another alternative matching earlier in the segment, and must not refer to
+ * groups by number, which the alternation shifts
+ */
+static bool is_combinable(const char *pattern) {
+  size_t len = strlen(pattern);
+  if (len < 2 || pattern[0] != '^' || pattern[len - 1] != '$') {
+    return false;
+  }
+
+  int depth = 0;
+  bool in_class = false;
+
+  for (size_t i = 0; i < len; i++) {
+    char c = pattern[i];
+    char next = pattern[i + 1];
+
+    if (c == '\\') {
+      // An escaped closing anchor is no anchor
+      if (i + 2 == len || (!in_class && ((next >= '1' && next <= '9') ||
+                                          next == 'g' || next == 'k'))) {
+        return false;
+      }
+
+      i++;
+    } else if (in_class) {
+      in_class = c != ']';
+    } else if (c == '[') {
+      in_class = true;
+      // A closing bracket first in a class stands for itself
+      if (next == '^') {
+        i++;
+      }
+      if (pattern[i + 1] == ']') {
+        i++;
+      }
+    } else if (c == '(') {
+      char c2 = next == '?' ? pattern[i + 2] : '\0';
+      if ((c2 >= '0' && c2 <= '9') || (c2 && strchr("R&P+-", c2))) {
+        return false;
+      }
+
+      depth++;
+    } else if (c == ')') {
+      depth--;
+    } else if (c == '|' && depth == 0) {
+      // Alternatives of its own needn't all be anchored
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool param_set_init(param_set *set, char **patterns, regex **compiled,
+                    unsigned int len) {
+  size_t size = 1;
+  for (unsigned int i = 0; i < len; i++) {
+    if (!is_combinable(patterns[i])) {
+      return false;
+    }
+
+    size += strlen(patterns[i]) + 3;
+  }
+
+  // Each pattern is wrapped in a group of its own, which follows the groups
+  // of those before it
+  char *alternation = xmalloc(size);
+  int *groups = xmalloc(len * sizeof(int));
+  char *end = alternation;
+  int num_groups = 0;
+
+  for (unsigned int i = 0; i < len; i++) {
+    int captures = 0;
+    pcre_fullinfo(compiled[i]->re, NULL, PCRE_INFO_CAPTURECOUNT, &captures);
+
+    groups[i] = ++num_groups;
+    num_groups += captures;
+
+    end += sprintf(end, "%s(%s)", i ? "|" : "", patterns[i]);
+  }
+
+  regex *re = regex_compile(alternation);
+  free(alternation);
+
+  if (!re) {
+    free(groups);
+    return false;
+  }
+
+  set->re = re;
+  set->len = len;
+  set->groups = groups;
+  set->ovecsize = (num_groups + 1) * 3;
+
+  return true;
+}
+
+int param_set_match(const param_set *set, str_view value) {
+  int ovector[set->ovecsize];
+
+  if (regex_exec(set->re, value.ptr, value.len, ovector, set->ovecsize) <= 0) {
+    return -1;
+  }
+
+  // PCRE tries the alternatives in order, so the one that matched is the first
+  // that could
+  for (unsigned int i = 0; i < set->len; i++) {
+    if (ovector[set->groups[i] * 2] != -1) {
+      return i;
+    }
+  }
+
+  return -1;
+}
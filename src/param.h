@@ -0,0 +1,94 @@
+#ifndef PARAM_H
+#define PARAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libhash/libhash.h"
+#include "regexpr.h"
+#include "util.h"
+
+/**
+ * param_kind is how a route parameter's value is matched: natively for its
+ * built-in types and the patterns equivalent to them, else with PCRE
+ */
+typedef enum {
+  // Any segment, as matched by the default pattern
+  PARAM_ANY,
+  // A segment made only of the bytes of a class
+  PARAM_CLASS,
+  // A signed or non-negative decimal integer that fits in a long long
+  PARAM_INT,
+  PARAM_UINT,
+  // A UUID in its canonical 8-4-4-4-12 form, in either case
+  PARAM_UUID,
+  PARAM_REGEX
+} param_kind;
+
+/**
+ * byte_class is a set of bytes, one bit per byte value
+ */
+typedef struct {
+  uint64_t bits[4];
+} byte_class;
+
+/**
+ * param_matcher matches the values of a route parameter
+ */
+typedef struct {
+  param_kind kind;
+  // The bytes a PARAM_CLASS value is made of
+  byte_class class;
+  // The expression a PARAM_REGEX value must match, or NULL if its pattern
+  // didn't compile
+  regex *re;
+} param_matcher;
+
+/**
+ * param_set matches a path segment against the patterns of several parameters
+ * at once, as one alternation of them, which PCRE tries in order
+ */
+typedef struct {
+  regex *re;
+  // The number of patterns, and the capture group each is wrapped in
+  unsigned int len;
+  int *groups;
+  // The size of the output vector a match needs
+  int ovecsize;
+} param_set;
+
+/**
+ * param_matcher_init sets up `m` for the parameter of the trie node labelled
+ * `label`, whose type or pattern is matched natively where it can be. Patterns
+ * that can't are compiled through `regex_cache`. DIEs on an unknown type
+ */
+void param_matcher_init(param_matcher *m, const char *label,
+                        hash_table *regex_cache);
+
+/**
+ * param_match tests whether the path segment `value` satisfies `m`. If `m`
+ * matches integers, `int_value` receives the value parsed
+ */
+bool param_match(const param_matcher *m, str_view value, long long *int_value);
+
+/**
+ * param_set_init combines the `len` `patterns`, compiled as `compiled`, into
+ * `set`. Only patterns anchored at both ends, without backreferences, can be
+ * combined. Returns false if any can't, leaving each to be matched on its own
+ */
+bool param_set_init(param_set *set, char **patterns, regex **compiled,
+                    unsigned int len);
+
+/**
+ * param_set_match returns the index of the first of the set's patterns that
+ * `value` matches, or -1 if it matches none
+ */
+int param_set_match(const param_set *set, str_view value);
+
+/**
+ * param_parse_int parses `value` as a decimal integer, with a leading '-' if
+ * `is_signed`. Returns false if it isn't one or doesn't fit in a long long
+ */
+bool param_parse_int(str_view value, bool is_signed, long long *out);
+
+#endif /* PARAM_H */
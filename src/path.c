@@ -12,62 +12,74 @@ const char PATH_DELIMITER[] = "/";
 const char PARAMETER_DELIMITER[] = ":";
 const char PARAMETER_DELIMITER_START[] = "[";
 const char PARAMETER_DELIMITER_END[] = "]";
+const char PARAMETER_TYPE_START[] = "<";
+const char PARAMETER_TYPE_END[] = ">";
 const char PATTERN_WILDCARD[] = "(.+)";
 
 array_t *expand_path(const char *path) { return split(path, PATH_DELIMITER); }
 
 char *derive_label_pattern(const char *label) {
   int start = s_indexof(label, PARAMETER_DELIMITER_START);
-  int end = s_indexof(label, PARAMETER_DELIMITER_END);
+  // The pattern runs to the last delimiter, as it may hold bracket expressions
+  // of its own
+  const char *end = strrchr(label, PARAMETER_DELIMITER_END[0]);
 
   // If the label doesn't contain a pattern, default to the wildcard pattern.
-  if (start == -1 || end == -1) {
+  if (start == -1 || !end || end - label < start) {
     return s_copy(PATTERN_WILDCARD);
   }
 
-  return s_substr(label, start + 1, end, false);
+  return s_substr(label, start + 1, end - label, false);
 }
 
-char *derive_parameter_key(const char *label) {
+char *derive_parameter_type(const char *label) {
   int start = s_indexof(label, PARAMETER_DELIMITER);
-  int end = s_indexof(label, PARAMETER_DELIMITER_START);
+  if (start == -1) {
+    return NULL;
+  }
+
+  // A type follows the key directly, where a pattern would otherwise begin
+  const char *type = label + start + 1;
+  type += strcspn(type, "[<");
+  if (*type != PARAMETER_TYPE_START[0]) {
+    return NULL;
+  }
 
-  if (end == -1) {
-    end = strlen(label);
+  const char *end = strchr(type, PARAMETER_TYPE_END[0]);
+  if (!end) {
+    return NULL;
   }
 
+  return s_substr(type, 1, end - type, false);
+}
+
+char *derive_parameter_key(const char *label) {
+  int start = s_indexof(label, PARAMETER_DELIMITER);
+  // The key ends where its pattern or type begins, if it has either
+  int end = start + 1 + strcspn(label + start + 1, "[<");
+
   return s_substr(label, start + 1, end, false);
 }
 
 array_t *path_split_first_delim(const char *p) {
-  char *cp = s_copy(p);
-
-  if (strlen(cp) <= 1) {
+  size_t len = strlen(p);
+  if (len <= 1) {
     return array_init();
   }
 
-  // no slash at all
-  char *a = strchr(cp, '/');
-  if (!a) {
-    return array_collect(fmt_str("/%s", cp), PATH_DELIMITER);
+  // no slash at all, or the slash is the last char
+  char *a = strchr(p, '/');
+  if (!a || a == p + len - 1) {
+    return array_collect(fmt_str("/%.*s", (int)(a ? len - 1 : len), p),
+                         s_copy(PATH_DELIMITER));
   }
 
-  // slash is last char
-  if (strlen(a) == 1) {
-    cp[strlen(cp) - 1] = '\0';
-    return array_collect(fmt_str("/%s", cp), PATH_DELIMITER);
-  }
-
-  char *s = strchr(cp + 1, '/');
+  char *s = strchr(p + 1, '/');
   if (!s) {
-    return array_collect(cp, PATH_DELIMITER);
+    return array_collect(s_copy(p), s_copy(PATH_DELIMITER));
   }
 
-  char *f = malloc(strlen(cp) - strlen(s));
-  strncpy(f, cp, (strlen(cp) - strlen(s)) + 1);
-  f[strlen(cp) - strlen(s)] = '\0';
-
-  return array_collect(f, s);
+  return array_collect(fmt_str("%.*s", (int)(s - p), p), s_copy(s));
 }
 
 array_t *path_split_dir(const char *p) {
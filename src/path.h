@@ -20,6 +20,12 @@ extern const char PARAMETER_DELIMITER_START[];
 // Default parameter end delimiter e.g. ]
 extern const char PARAMETER_DELIMITER_END[];
 
+// Parameter type start delimiter e.g. <
+extern const char PARAMETER_TYPE_START[];
+
+// Parameter type end delimiter e.g. >
+extern const char PARAMETER_TYPE_END[];
+
 // Default pattern wildcard e.g. (.+)
 extern const char PATTERN_WILDCARD[];
 
@@ -36,6 +42,12 @@ array_t *expand_path(const char *path);
  */
 char *derive_label_pattern(const char *label);
 
+/**
+ * Extracts from a label the name of the parameter's type e.g. int for :id<int>,
+ * or NULL if the label doesn't name one
+ */
+char *derive_parameter_type(const char *label);
+
 /**
  * Extracts from a label a parameter key. Sets errno if provided null or
  * otherwise invalid argument(s)
@@ -44,7 +56,7 @@ char *derive_parameter_key(const char *label);
 
 /**
  * path_split_first_delim splits the string p on the first PATH_DELIMITER
- * character and returns the resulting two strings
+ * character and returns the resulting two strings, which the array owns
  */
 array_t *path_split_first_delim(const char *p);
 
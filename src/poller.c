@@ -0,0 +1,134 @@
+#include "poller.h"
+
+#include <errno.h>
+#include <stddef.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+#include "logger.h"
+
+#ifdef __linux__
+
+int poller_init(void) { return epoll_create1(EPOLL_CLOEXEC); }
+
+static bool poller_ctl(int pfd, int op, int fd, unsigned int events,
+                       void *data) {
+  struct epoll_event ev = {.events = events, .data.ptr = data};
+
+  if (epoll_ctl(pfd, op, fd, &ev) == -1) {
+    printlogf(YS_LOG_DEBUG, "[poller::%s] epoll_ctl failed on fd %d (%d)\n",
+              __func__, fd, errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool poller_add(int pfd, int fd, void *data) {
+  return poller_ctl(pfd, EPOLL_CTL_ADD, fd, EPOLLIN, data);
+}
+
+bool poller_add_oneshot(int pfd, int fd, void *data) {
+  return poller_ctl(pfd, EPOLL_CTL_ADD, fd, EPOLLIN | EPOLLRDHUP | EPOLLONESHOT,
+                    data);
+}
+
+bool poller_rearm(int pfd, int fd, void *data) {
+  return poller_ctl(pfd, EPOLL_CTL_MOD, fd, EPOLLIN | EPOLLRDHUP | EPOLLONESHOT,
+                    data);
+}
+
+bool poller_rearm_writable(int pfd, int fd, void *data) {
+  return poller_ctl(pfd, EPOLL_CTL_MOD, fd,
+                    EPOLLOUT | EPOLLRDHUP | EPOLLONESHOT, data);
+}
+
+int poller_wait(int pfd, poller_event *events, int max_events,
+                int timeout_ms) {
+  struct epoll_event evs[POLLER_MAX_EVENTS];
+  if (max_events > POLLER_MAX_EVENTS) {
+    max_events = POLLER_MAX_EVENTS;
+  }
+
+  int n;
+  while ((n = epoll_wait(pfd, evs, max_events, timeout_ms)) == -1 &&
+         errno == EINTR)
+    ;
+
+  for (int i = 0; i < n; i++) {
+    events[i].data = evs[i].data.ptr;
+    // A peer may half-close after sending its request, so only treat the
+    // connection as gone once there's nothing left to read
+    events[i].hangup = (evs[i].events & (EPOLLERR | EPOLLHUP)) &&
+                       !(evs[i].events & EPOLLIN);
+  }
+
+  return n;
+}
+
+#else
+
+int poller_init(void) { return kqueue(); }
+
+static bool poller_ctl(int pfd, int fd, short filter, unsigned short flags,
+                       void *data) {
+  struct kevent ev;
+  EV_SET(&ev, fd, filter, flags, 0, 0, data);
+
+  if (kevent(pfd, &ev, 1, NULL, 0, NULL) == -1) {
+    printlogf(YS_LOG_DEBUG, "[poller::%s] kevent failed on fd %d (%d)\n",
+              __func__, fd, errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool poller_add(int pfd, int fd, void *data) {
+  return poller_ctl(pfd, fd, EVFILT_READ, EV_ADD, data);
+}
+
+bool poller_add_oneshot(int pfd, int fd, void *data) {
+  return poller_ctl(pfd, fd, EVFILT_READ, EV_ADD | EV_ONESHOT, data);
+}
+
+bool poller_rearm(int pfd, int fd, void *data) {
+  return poller_ctl(pfd, fd, EVFILT_READ, EV_ADD | EV_ONESHOT, data);
+}
+
+bool poller_rearm_writable(int pfd, int fd, void *data) {
+  // kqueue filters are independent, and the read filter has already fired
+  return poller_ctl(pfd, fd, EVFILT_WRITE, EV_ADD | EV_ONESHOT, data);
+}
+
+int poller_wait(int pfd, poller_event *events, int max_events,
+                int timeout_ms) {
+  struct kevent evs[POLLER_MAX_EVENTS];
+  if (max_events > POLLER_MAX_EVENTS) {
+    max_events = POLLER_MAX_EVENTS;
+  }
+
+  struct timespec ts = {.tv_sec = timeout_ms / 1000,
+                        .tv_nsec = (timeout_ms % 1000) * 1000000};
+
+  int n;
+  while ((n = kevent(pfd, NULL, 0, evs, max_events,
+                     timeout_ms < 0 ? NULL : &ts)) == -1 &&
+         errno == EINTR)
+    ;
+
+  for (int i = 0; i < n; i++) {
+    events[i].data = evs[i].udata;
+    events[i].hangup = (evs[i].flags & EV_ERROR) ||
+                       ((evs[i].flags & EV_EOF) && evs[i].data == 0);
+  }
+
+  return n;
+}
+
+#endif
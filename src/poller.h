@@ -0,0 +1,66 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <stdbool.h>
+
+// Maximum number of readiness events retrieved per poller_wait call
+#define POLLER_MAX_EVENTS 128
+
+/**
+ * poller_event is a readiness event retrieved from the poller
+ */
+typedef struct {
+  /**
+   * The user data associated with the file descriptor when it was registered
+   */
+  void *data;
+
+  /**
+   * Whether the peer hung up or the descriptor is in an error state
+   */
+  bool hangup;
+} poller_event;
+
+/**
+ * poller_init creates a new kernel event queue (epoll on Linux, kqueue on
+ * BSD-likes e.g. macos). Returns the queue's file descriptor, or -1 on failure
+ */
+int poller_init(void);
+
+/**
+ * poller_add registers `fd` with the poller `pfd` for level-triggered read
+ * readiness. Intended for listening sockets, which stay registered for the
+ * lifetime of the server.
+ */
+bool poller_add(int pfd, int fd, void *data);
+
+/**
+ * poller_add_oneshot registers `fd` with the poller `pfd` for read readiness.
+ * The registration is disabled as soon as an event fires and must be re-enabled
+ * via poller_rearm; this guarantees only one thread ever handles a given
+ * connection at a time.
+ */
+bool poller_add_oneshot(int pfd, int fd, void *data);
+
+/**
+ * poller_rearm re-enables a one-shot registration for `fd`. Safe to call from
+ * any thread.
+ */
+bool poller_rearm(int pfd, int fd, void *data);
+
+/**
+ * poller_rearm_writable re-enables a one-shot registration for `fd`, this time
+ * for write readiness. The next poller_rearm restores read readiness. Safe to
+ * call from any thread.
+ */
+bool poller_rearm_writable(int pfd, int fd, void *data);
+
+/**
+ * poller_wait waits up to `timeout_ms` (or indefinitely, if -1) for readiness
+ * events and writes up to `max_events` of them into `events`. Returns the
+ * number of events retrieved, or -1 on error
+ */
+int poller_wait(int pfd, poller_event *events, int max_events,
+                int timeout_ms);
+
+#endif /* POLLER_H */
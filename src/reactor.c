@@ -0,0 +1,1272 @@
+#include "reactor.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "config.h"
+#include "logger.h"
+#include "poller.h"
+#include "request.h"
+#include "response.h"
+#include "router.h"
+#include "tls.h"
+#include "util.h"
+#include "xmalloc.h"
+
+// How often (in ms) the reactor wakes to close idle keep-alive connections
+#define IDLE_SWEEP_INTERVAL_MS 1000
+
+// Number of submission queue entries in each reactor's io_uring
+#define URING_ENTRIES 256
+
+#ifdef HAVE_IO_URING
+/**
+ * uring_op identifies the operation a completion belongs to. It is stored in
+ * the low bits of the completion's user data, alongside the client context
+ */
+typedef enum {
+  URING_OP_ACCEPT = 1,
+  URING_OP_WAKE,
+  URING_OP_TIMEOUT,
+  URING_OP_RECV,
+  // A send with no operation linked after it
+  URING_OP_SEND,
+  // A send followed by a linked recv or close
+  URING_OP_SEND_LINKED,
+  URING_OP_CLOSE,
+  // A wait for the socket to drain while a file body is being sent
+  URING_OP_POLL_WRITABLE
+} uring_op;
+
+#define URING_OP_MASK 15
+
+// The op is packed into the low bits of each client context's address
+_Static_assert(_Alignof(max_align_t) > URING_OP_MASK,
+               "client contexts are not aligned enough to tag with a uring_op");
+
+static void finish_request_uring(reactor *r, client_context *ctx);
+static bool submit_recv(reactor *r, client_context *ctx);
+static void send_file_uring(reactor *r, client_context *ctx);
+#endif
+
+typedef struct {
+  reactor *reactor;
+  router_internal *r;
+  client_context *c;
+  request_internal *req;
+} thread_context;
+
+/**
+ * monotonic_now returns the current monotonic clock time in seconds
+ */
+static time_t monotonic_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+/**
+ * track_connection adds a connection to the reactor's list of open connections
+ */
+static void track_connection(reactor *r, client_context *ctx) {
+  ctx->reactor = r;
+  ctx->prev = NULL;
+  ctx->next = r->connections;
+  if (r->connections) {
+    r->connections->prev = ctx;
+  }
+  r->connections = ctx;
+}
+
+/**
+ * close_connection removes a connection from the reactor's list of open
+ * connections and closes it
+ */
+static void close_connection(reactor *r, client_context *ctx) {
+  // io_uring operations still in flight reference the context. Shutting down
+  // the socket makes them complete, and the last to do so closes the connection
+  if (ctx->inflight > 0) {
+    if (ctx->state != CONN_CLOSED && ctx->sockfd != -1) {
+      shutdown(ctx->sockfd, SHUT_RDWR);
+    }
+
+    ctx->state = CONN_CLOSED;
+    return;
+  }
+
+  if (ctx->prev) {
+    ctx->prev->next = ctx->next;
+  } else {
+    r->connections = ctx->next;
+  }
+
+  if (ctx->next) {
+    ctx->next->prev = ctx->prev;
+  }
+
+  client_close(ctx);
+}
+
+/**
+ * client_thread_handler executes the user-defined router against a request
+ * that the reactor has already read and parsed
+ */
+static void *client_thread_handler(void *arg) {
+  thread_context *ctx = arg;
+
+  printlogf(YS_LOG_INFO, "[reactor::%s] client request received: %s %.*s\n",
+            __func__, ctx->req->method_name, VIEW_ARGS(ctx->req->path));
+
+  // A request handed off to the compute pool is released once it's done there
+  if (router_run(ctx->r, ctx->c, ctx->req)) {
+    reactor_release(ctx->reactor, ctx->c);
+  }
+
+  free(ctx);
+  return NULL;
+}
+
+/**
+ * send_thread_handler sends a response that was prepared on the compute pool
+ */
+static void *send_thread_handler(void *arg) {
+  thread_context *ctx = arg;
+
+  serialized_response *out = ctx->c->out;
+  ctx->c->out = NULL;
+
+  response_send(ctx->c, out);
+  reactor_release(ctx->reactor, ctx->c);
+
+  free(ctx);
+  return NULL;
+}
+
+static void handle_readable(reactor *r, client_context *ctx);
+static void handle_buffered(reactor *r, client_context *ctx);
+static void await_request(reactor *r, client_context *ctx);
+
+/**
+ * handshake_step advances a connection's TLS handshake as far as the bytes the
+ * client has sent so far allow, and records the outcome in
+ * `ctx->handshake_status`
+ */
+static void handshake_step(client_context *ctx) {
+  ERR_clear_error();
+
+  int ret = SSL_do_handshake(ctx->ssl);
+  ctx->handshake_status =
+      ret == 1 ? SSL_ERROR_NONE : SSL_get_error(ctx->ssl, ret);
+
+  if (ctx->handshake_status != SSL_ERROR_NONE &&
+      ctx->handshake_status != SSL_ERROR_WANT_READ &&
+      ctx->handshake_status != SSL_ERROR_WANT_WRITE) {
+    // OpenSSL's error queue is per-thread, so report it where the step ran
+    ERR_print_errors_fp(stderr);
+  }
+}
+
+/**
+ * handshake_thread_handler runs a step of a TLS handshake on a worker thread,
+ * keeping the expensive key exchange off the reactor
+ */
+static void *handshake_thread_handler(void *arg) {
+  thread_context *ctx = arg;
+
+  handshake_step(ctx->c);
+  reactor_release(ctx->reactor, ctx->c);
+
+  free(ctx);
+  return NULL;
+}
+
+/**
+ * finish_handshake_step acts on the outcome of the latest step of a
+ * connection's TLS handshake: it waits for the client to send or receive more
+ * of the handshake, waits for the first request once the handshake is
+ * complete, or closes the connection if the handshake failed
+ */
+static void finish_handshake_step(reactor *r, client_context *ctx) {
+  switch (ctx->handshake_status) {
+    case SSL_ERROR_NONE:
+      ctx->handshaking = false;
+      ctx->state = CONN_READING;
+      ctx->last_active = monotonic_now();
+      tls_record_handshake(r->server->tls, ctx->ssl);
+      tls_detect_ktls(r->server->tls, ctx->ssl, &ctx->ktls_send,
+                      &ctx->ktls_recv);
+
+      // OpenSSL may already hold decrypted bytes, which the poller can't see
+      if (SSL_pending(ctx->ssl) > 0) {
+        handle_readable(r, ctx);
+      } else {
+        await_request(r, ctx);
+      }
+      return;
+
+    case SSL_ERROR_WANT_READ:
+      ctx->state = CONN_HANDSHAKING;
+      if (!poller_rearm(r->pollfd, ctx->sockfd, ctx)) {
+        close_connection(r, ctx);
+      }
+      return;
+
+    case SSL_ERROR_WANT_WRITE:
+      ctx->state = CONN_HANDSHAKING;
+      if (!poller_rearm_writable(r->pollfd, ctx->sockfd, ctx)) {
+        close_connection(r, ctx);
+      }
+      return;
+
+    default:
+      printlogf(YS_LOG_INFO,
+                "[reactor::%s] failed to accept SSL connection on sockfd %d\n",
+                __func__, ctx->sockfd);
+
+      // Most likely a plaintext request to the HTTPs port
+      if (ctx->handshake_status == SSL_ERROR_SSL) {
+        response_send_protocol_error(ctx->sockfd);
+        ctx->sockfd = -1;
+      }
+
+      close_connection(r, ctx);
+  }
+}
+
+/**
+ * advance_handshake continues a connection's TLS handshake now that its socket
+ * is ready. The step runs on a worker thread if the reactor has any, so that
+ * handshakes scale with the number of workers rather than being serialized on
+ * the reactor
+ */
+static void advance_handshake(reactor *r, client_context *ctx) {
+  if (r->queue) {
+    thread_context *tc = xmalloc(sizeof(thread_context));
+    tc->reactor = r;
+    tc->c = ctx;
+    tc->r = r->server->router;
+    tc->req = NULL;
+
+    ctx->state = CONN_DISPATCHED;
+    if (work_queue_try_push(r->queue, handshake_thread_handler, tc)) {
+      return;
+    }
+
+    // Rather than block the reactor on a full queue, take the step here
+    free(tc);
+  }
+
+  handshake_step(ctx);
+  finish_handshake_step(r, ctx);
+}
+
+/**
+ * accept_connections accepts every pending connection on the listening socket
+ * and registers each with the poller. TLS connections start out handshaking;
+ * the handshake is driven by readiness events like any other I/O, so a slow
+ * client never holds up the accept loop
+ */
+static void accept_connections(reactor *r) {
+  while (true) {
+    struct sockaddr_in address;
+    socklen_t addr_len = sizeof(address);
+
+    int client_sockfd =
+        accept(r->listen_fd, (struct sockaddr *)&address, &addr_len);
+
+    if (client_sockfd == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        perror("accept");
+        printlogf(YS_LOG_INFO,
+                  "[reactor::%s] failed to accept client socket on port %d\n",
+                  __func__, r->server->port);
+      }
+
+      return;
+    }
+
+    if (!set_nonblocking(client_sockfd, true)) {
+      printlogf(YS_LOG_INFO,
+                "[reactor::%s] failed to make client socket non-blocking\n",
+                __func__);
+
+      close(client_sockfd);
+      continue;
+    }
+
+    SSL *ssl = NULL;
+    if (r->server->sslctx) {
+      if (!(ssl = SSL_new(r->server->sslctx))) {
+        ERR_print_errors_fp(stderr);
+        close(client_sockfd);
+        continue;
+      }
+
+      SSL_set_fd(ssl, client_sockfd);
+      SSL_set_accept_state(ssl);
+    }
+
+    printlogf(YS_LOG_DEBUG,
+              "[reactor::%s] accepted connection from new client on sockfd "
+              "%d\n",
+              __func__, client_sockfd);
+
+    client_context *ctx = client_init(client_sockfd, ssl);
+    ctx->last_active = monotonic_now();
+
+    // A reactor that runs the router itself mustn't block on a slow client's
+    // socket, so it sends the responses itself as the socket drains
+    ctx->defer_send = !r->queue;
+    track_connection(r, ctx);
+
+    if (ssl) {
+      ctx->handshaking = true;
+      ctx->state = CONN_HANDSHAKING;
+    }
+
+    if (!poller_add_oneshot(r->pollfd, client_sockfd, ctx)) {
+      close_connection(r, ctx);
+    }
+  }
+}
+
+static void finish_request(reactor *r, client_context *ctx);
+
+/**
+ * dispatch hands a fully parsed request off to the worker threads' queue. If
+ * the queue is full, the reactor either waits for a slot or rejects the request
+ * with a 503, per `server_conf.queue_full`. A reactor without a queue runs the
+ * router itself, on its own thread.
+ */
+static void dispatch(reactor *r, client_context *ctx, request_internal *req) {
+  ctx->state = CONN_DISPATCHED;
+  ctx->num_requests++;
+
+  // Decide up front whether the connection outlives this request, so that the
+  // router can advertise it in the response
+  ctx->keep_alive = req->keep_alive && server_conf.keep_alive_timeout > 0 &&
+                    (server_conf.keep_alive_max_requests == 0 ||
+                     ctx->num_requests <
+                         (unsigned int)server_conf.keep_alive_max_requests);
+
+  if (!r->queue) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] client request received: %s %.*s\n", __func__,
+              req->method_name, VIEW_ARGS(req->path));
+
+    if (router_run(r->server->router, ctx, req)) {
+      finish_request(r, ctx);
+    }
+    return;
+  }
+
+  thread_context *tc = xmalloc(sizeof(thread_context));
+  tc->reactor = r;
+  tc->c = ctx;
+  tc->r = r->server->router;
+  tc->req = req;
+
+  if (server_conf.queue_full == QUEUE_FULL_WAIT) {
+    work_queue_push(r->queue, client_thread_handler, tc);
+    return;
+  }
+
+  if (!work_queue_try_push(r->queue, client_thread_handler, tc)) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] work queue is full; rejecting request %s %.*s\n",
+              __func__, req->method_name, VIEW_ARGS(req->path));
+
+    free(tc);
+    request_free(req);
+
+    response_send_status(ctx, YS_STATUS_SERVICE_UNAVAILABLE);
+    finish_request(r, ctx);
+  }
+}
+
+/**
+ * await_body decides what becomes of a request whose body is too large for the
+ * connection's read buffer, or whose chunked body has yet to arrive in full,
+ * per the route it's bound for: a body over the route's limit is refused, and
+ * one bound for a YS_ROUTE_STREAM_BODY route is left for the handler to read.
+ * Any other body is read in full before the request is dispatched. Returns true
+ * if the request should be dispatched right away, as are requests that match
+ * no route, with their bodies unread
+ */
+static bool await_body(reactor *r, client_context *ctx, request_internal *req) {
+  route_action *action = router_find_action(r->server->router, req);
+
+  // A request that matches no route is answered without its body
+  if (!action) {
+    return true;
+  }
+
+  size_t max_body_size = router_body_limit(action);
+
+  if (max_body_size > 0 && req->content_len > max_body_size) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] request body of %zu bytes exceeds the limit of "
+              "%zu for %s %.*s\n",
+              __func__, req->content_len, max_body_size, req->method_name,
+              VIEW_ARGS(req->path));
+
+    request_free(req);
+
+    response_send_error(ctx, REQ_TOO_LONG);
+    finish_request(r, ctx);
+    return false;
+  }
+
+  // A chunked body's length is only known once it has all been read, so the
+  // limit is enforced as it's read
+  req->max_body_size = max_body_size;
+
+  if (req->expects_continue && req->body_len == 0) {
+    ctx->continued = true;
+    response_send_continue(ctx);
+  }
+
+  if (action->flags & YS_ROUTE_STREAM_BODY) {
+    return true;
+  }
+
+  req_await_body(ctx, req);
+  ctx->last_active = monotonic_now();
+
+  handle_buffered(r, ctx);
+  return false;
+}
+
+/**
+ * handle_buffered parses the bytes buffered on the connection and, if they hold
+ * a full request, dispatches it. Otherwise, waits for the client to send more
+ */
+static void handle_buffered(reactor *r, client_context *ctx) {
+  maybe_request maybe_req = req_parse(ctx);
+
+  if (maybe_req.err.code == REQ_EXPECT_CONTINUE) {
+    ctx->continued = true;
+    response_send_continue(ctx);
+  }
+
+  if (maybe_req.err.code == REQ_INCOMPLETE ||
+      maybe_req.err.code == REQ_EXPECT_CONTINUE) {
+    // A body being read counts as activity, however long it takes to arrive
+    if (ctx->pending) {
+      ctx->last_active = monotonic_now();
+    }
+
+    // OpenSSL may already hold decrypted bytes, which the poller can't see
+    if (ctx->ssl && SSL_pending(ctx->ssl) > 0) {
+      handle_readable(r, ctx);
+      return;
+    }
+
+    await_request(r, ctx);
+    return;
+  }
+
+  // TODO: test + fix
+  if (maybe_req.err.code == IO_ERR || maybe_req.err.code == PARSE_ERR ||
+      maybe_req.err.code == REQ_TOO_LONG || maybe_req.err.code == DUP_HDR ||
+      maybe_req.err.code == BAD_CHUNK || maybe_req.err.code == BAD_LENGTH ||
+      maybe_req.err.code == BAD_ENCODING) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] error parsing client request with error code %d. "
+              "Pre-empting response with internal error handler\n",
+              __func__, maybe_req.err.code);
+
+    // The error response always closes the connection once it has been sent
+    response_send_error(ctx, maybe_req.err.code);
+    finish_request(r, ctx);
+    return;
+  }
+
+  request_internal *req = maybe_req.req;
+  if (req->body_remaining > 0 && !await_body(r, ctx, req)) {
+    return;
+  }
+
+  dispatch(r, ctx, req);
+}
+
+/**
+ * handle_readable reads whatever the client has sent so far and, once a full
+ * request has been buffered, dispatches it
+ */
+static void handle_readable(reactor *r, client_context *ctx) {
+  if (req_read(ctx) == -1) {
+    printlogf(YS_LOG_DEBUG, "[reactor::%s] client on sockfd %d hung up\n",
+              __func__, ctx->sockfd);
+
+    close_connection(r, ctx);
+    return;
+  }
+
+  handle_buffered(r, ctx);
+}
+
+/**
+ * await_request waits for the client to send (more of) its next request
+ */
+static void await_request(reactor *r, client_context *ctx) {
+#ifdef HAVE_IO_URING
+  if (r->ring) {
+    if (!submit_recv(r, ctx)) {
+      close_connection(r, ctx);
+    }
+    return;
+  }
+#endif
+
+  if (!poller_rearm(r->pollfd, ctx->sockfd, ctx)) {
+    close_connection(r, ctx);
+  }
+}
+
+/**
+ * finish_request sends whatever of the response the connection has left for
+ * the reactor, then either closes the connection or, if it is being kept alive,
+ * readies it for the next request. If the socket fills up first, the rest is
+ * sent once the poller finds it writable again. A request the client pipelined
+ * behind the one just served is parsed straight from the buffer; since only one
+ * request per connection is ever dispatched at a time, responses are written in
+ * the order the requests arrived
+ */
+static void finish_request(reactor *r, client_context *ctx) {
+#ifdef HAVE_IO_URING
+  if (r->ring) {
+    finish_request_uring(r, ctx);
+    return;
+  }
+#endif
+
+  // A reactor without workers sends responses itself, as far as the socket
+  // takes them; the rest is sent once the socket has drained
+  if (ctx->out || ctx->out_fd != -1) {
+    flush_status status = response_flush(ctx);
+
+    if (status == FLUSH_BLOCKED) {
+      ctx->state = CONN_FLUSHING;
+      ctx->last_active = monotonic_now();
+
+      if (!poller_rearm_writable(r->pollfd, ctx->sockfd, ctx)) {
+        close_connection(r, ctx);
+      }
+      return;
+    }
+
+    if (status == FLUSH_ERR) {
+      printlogf(YS_LOG_INFO,
+                "[reactor::%s] failed to send response on sockfd %d\n",
+                __func__, ctx->sockfd);
+      ctx->keep_alive = false;
+    }
+  }
+
+  if (!ctx->keep_alive || ctx->state == CONN_CLOSED) {
+    close_connection(r, ctx);
+    return;
+  }
+
+  client_reset(ctx);
+  ctx->last_active = monotonic_now();
+
+  // A handler that streamed the body may have left the start of the next
+  // request with OpenSSL
+  if (ctx->buflen > 0 || (ctx->ssl && SSL_pending(ctx->ssl) > 0)) {
+    handle_buffered(r, ctx);
+    return;
+  }
+
+  await_request(r, ctx);
+}
+
+/**
+ * take_returned takes ownership of every connection workers have handed back
+ * since the last wakeup
+ */
+static void take_returned(reactor *r) {
+  pthread_mutex_lock(&r->lock);
+  client_context *ctx = r->returned;
+  r->returned = NULL;
+  pthread_mutex_unlock(&r->lock);
+
+  while (ctx) {
+    client_context *next = ctx->next_returned;
+    ctx->next_returned = NULL;
+
+    if (ctx->handshaking) {
+      finish_handshake_step(r, ctx);
+    } else {
+      finish_request(r, ctx);
+    }
+    ctx = next;
+  }
+}
+
+/**
+ * drain_returned empties the wake pipe and takes ownership of the connections
+ * workers have handed back
+ */
+static void drain_returned(reactor *r) {
+  char scratch[64];
+  while (read(r->wake_fds[0], scratch, sizeof(scratch)) > 0)
+    ;
+
+  take_returned(r);
+}
+
+/**
+ * sweep_idle closes every connection that has been waiting on a request for
+ * longer than the keep-alive timeout, or on the TLS handshake for longer than
+ * the handshake timeout
+ */
+static void sweep_idle(reactor *r) {
+  time_t now = monotonic_now();
+  if (now == r->last_sweep) {
+    return;
+  }
+  r->last_sweep = now;
+
+  client_context *ctx = r->connections;
+  while (ctx) {
+    client_context *next = ctx->next;
+
+    // Connections owned by a worker are never in the reading, handshaking or
+    // flushing states, so these are the only cases in which the reactor may
+    // close one
+    if (ctx->state == CONN_HANDSHAKING &&
+        now - ctx->last_active >= server_conf.tls_handshake_timeout) {
+      printlogf(YS_LOG_INFO,
+                "[reactor::%s] TLS handshake timed out on sockfd %d\n",
+                __func__, ctx->sockfd);
+
+      close_connection(r, ctx);
+    } else if (ctx->state == CONN_FLUSHING &&
+               (now - ctx->last_active) * 1000 >= SEND_TIMEOUT_MS) {
+      printlogf(YS_LOG_INFO, "[reactor::%s] send timed out on sockfd %d\n",
+                __func__, ctx->sockfd);
+
+      close_connection(r, ctx);
+    } else if (ctx->state == CONN_READING &&
+               server_conf.keep_alive_timeout > 0 &&
+               now - ctx->last_active >= server_conf.keep_alive_timeout) {
+      printlogf(YS_LOG_DEBUG,
+                "[reactor::%s] closing idle connection on sockfd %d\n",
+                __func__, ctx->sockfd);
+
+      close_connection(r, ctx);
+    }
+
+    ctx = next;
+  }
+}
+
+#ifdef HAVE_IO_URING
+/**
+ * prep_sqe fills in a submission queue entry for an operation on `fd`
+ */
+static void prep_sqe(struct io_uring_sqe *sqe, int opcode, int fd, void *addr,
+                     unsigned len, client_context *ctx, uring_op op) {
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t)addr;
+  sqe->len = len;
+  sqe->user_data = (uintptr_t)ctx | op;
+}
+
+static bool submit_accept(reactor *r) {
+  struct io_uring_sqe *sqe = uring_get_sqe(r->ring);
+  if (!sqe) {
+    return false;
+  }
+
+  prep_sqe(sqe, IORING_OP_ACCEPT, r->listen_fd, NULL, 0, NULL,
+           URING_OP_ACCEPT);
+
+#ifdef IORING_ACCEPT_MULTISHOT
+  if (r->multishot_accept) {
+    sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+  }
+#endif
+
+  return true;
+}
+
+static bool submit_wake_read(reactor *r) {
+  struct io_uring_sqe *sqe = uring_get_sqe(r->ring);
+  if (!sqe) {
+    return false;
+  }
+
+  prep_sqe(sqe, IORING_OP_READ, r->wake_fds[0], r->wake_buf,
+           sizeof(r->wake_buf), NULL, URING_OP_WAKE);
+  return true;
+}
+
+static bool submit_timeout(reactor *r) {
+  struct io_uring_sqe *sqe = uring_get_sqe(r->ring);
+  if (!sqe) {
+    return false;
+  }
+
+  prep_sqe(sqe, IORING_OP_TIMEOUT, -1, &r->sweep_interval, 1, NULL,
+           URING_OP_TIMEOUT);
+  return true;
+}
+
+/**
+ * prep_recv fills in a recv into the free space of the connection's buffer, or
+ * of its body buffer while a request body is being read
+ */
+static void prep_recv(struct io_uring_sqe *sqe, client_context *ctx) {
+  size_t capacity;
+  char *dst = req_recv_buffer(ctx, &capacity);
+
+  prep_sqe(sqe, IORING_OP_RECV, ctx->sockfd, dst, capacity, ctx,
+           URING_OP_RECV);
+  ctx->inflight++;
+}
+
+static bool submit_recv(reactor *r, client_context *ctx) {
+  struct io_uring_sqe *sqe = uring_get_sqe(r->ring);
+  if (!sqe) {
+    return false;
+  }
+
+  prep_recv(sqe, ctx);
+  return true;
+}
+
+/**
+ * submit_poll_writable waits for the connection's socket to drain enough to
+ * take more of its file body
+ */
+static bool submit_poll_writable(reactor *r, client_context *ctx) {
+  struct io_uring_sqe *sqe = uring_get_sqe(r->ring);
+  if (!sqe) {
+    return false;
+  }
+
+  prep_sqe(sqe, IORING_OP_POLL_ADD, ctx->sockfd, NULL, 0, ctx,
+           URING_OP_POLL_WRITABLE);
+  sqe->poll_events = POLLOUT;
+  ctx->inflight++;
+  return true;
+}
+
+/**
+ * submit_send sends the remainder of the connection's pending response. If the
+ * connection is closing, a close is linked after the send. If it is being kept
+ * alive and nothing was pipelined behind the request, a recv for the next
+ * request is linked instead, saving a trip through the reactor
+ */
+static bool submit_send(reactor *r, client_context *ctx) {
+  if (!uring_reserve(r->ring, 2)) {
+    return false;
+  }
+
+  // A file body is sent once the headers are out, so nothing may be linked
+  // after them
+  bool has_file = ctx->out_fd != -1;
+  bool link_close = !ctx->keep_alive && !has_file;
+  bool link_recv = ctx->keep_alive && ctx->buflen == 0 && !has_file;
+
+  // The response's pieces are gathered into a single send. The headers are held
+  // back until the file body after them, if any, fills out the packet
+  struct io_uring_sqe *sqe = uring_get_sqe(r->ring);
+  prep_sqe(sqe, IORING_OP_SENDMSG, ctx->sockfd, &ctx->out->msg, 1, ctx,
+           link_close || link_recv ? URING_OP_SEND_LINKED : URING_OP_SEND);
+  sqe->msg_flags = MSG_NOSIGNAL | (has_file ? MSG_MORE : 0);
+  ctx->inflight++;
+
+  if (link_close || link_recv) {
+    sqe->flags |= IOSQE_IO_LINK;
+    sqe = uring_get_sqe(r->ring);
+  }
+
+  if (link_close) {
+    prep_sqe(sqe, IORING_OP_CLOSE, ctx->sockfd, NULL, 0, ctx, URING_OP_CLOSE);
+    ctx->inflight++;
+  } else if (link_recv) {
+    prep_recv(sqe, ctx);
+  }
+
+  return true;
+}
+
+/**
+ * finish_request_uring sends the response a worker (or the reactor) left on
+ * the connection. Unlike the poller, the connection is closed or readied for
+ * the next request via operations linked after the send
+ */
+static void finish_request_uring(reactor *r, client_context *ctx) {
+  if (!ctx->out) {
+    close_connection(r, ctx);
+    return;
+  }
+
+  if (ctx->keep_alive) {
+    // The next request may be read while the response is still being sent
+    client_reset(ctx);
+    ctx->state = CONN_WRITING;
+  }
+
+  if (!submit_send(r, ctx)) {
+    close_connection(r, ctx);
+  }
+}
+
+static void handle_accept_completion(reactor *r, int res, unsigned flags) {
+  if (res >= 0) {
+    printlogf(YS_LOG_DEBUG,
+              "[reactor::%s] accepted connection from new client on sockfd "
+              "%d\n",
+              __func__, res);
+
+    client_context *ctx = client_init(res, NULL);
+    ctx->defer_send = true;
+    ctx->last_active = monotonic_now();
+    track_connection(r, ctx);
+
+    if (!submit_recv(r, ctx)) {
+      close_connection(r, ctx);
+    }
+  } else if (res == -EINVAL && r->multishot_accept) {
+    printlogf(YS_LOG_DEBUG,
+              "[reactor::%s] multishot accept unsupported; falling back to "
+              "single accepts\n",
+              __func__);
+    r->multishot_accept = false;
+  } else if (res != -EAGAIN && res != -EINTR && res != -ECONNABORTED) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] failed to accept client socket on port %d (%d)\n",
+              __func__, r->server->port, -res);
+  }
+
+  bool more = false;
+#ifdef IORING_CQE_F_MORE
+  more = r->multishot_accept && (flags & IORING_CQE_F_MORE);
+#else
+  (void)flags;
+#endif
+
+  if (!more && !submit_accept(r)) {
+    DIE("[reactor::%s] failed to submit accept\n", __func__);
+  }
+}
+
+static void handle_recv_completion(reactor *r, client_context *ctx, int res) {
+  // A recv linked after a short send is cancelled; the send is retried along
+  // with a fresh recv
+  if (res == -ECANCELED && ctx->state != CONN_CLOSED) {
+    return;
+  }
+
+  if (res == -EAGAIN || res == -EINTR) {
+    await_request(r, ctx);
+    return;
+  }
+
+  if (res <= 0 || ctx->state == CONN_CLOSED) {
+    printlogf(YS_LOG_DEBUG, "[reactor::%s] client on sockfd %d hung up\n",
+              __func__, ctx->sockfd);
+
+    close_connection(r, ctx);
+    return;
+  }
+
+  req_recv_commit(ctx, res);
+
+  handle_buffered(r, ctx);
+}
+
+static void handle_send_completion(reactor *r, client_context *ctx, int res,
+                                   bool linked) {
+  if (res < 0 || ctx->state == CONN_CLOSED) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] failed to send response on sockfd %d\n", __func__,
+              ctx->sockfd);
+
+    close_connection(r, ctx);
+    return;
+  }
+
+  serialized_response_advance(ctx->out, res);
+
+  // A short send cancels whatever was linked after it, so resubmit both
+  if (serialized_response_remaining(ctx->out) > 0) {
+    if (!submit_send(r, ctx)) {
+      close_connection(r, ctx);
+    }
+    return;
+  }
+
+  serialized_response_free(ctx->out);
+  ctx->out = NULL;
+
+  if (ctx->out_fd != -1) {
+    send_file_uring(r, ctx);
+    return;
+  }
+
+  if (!ctx->keep_alive) {
+    // The linked close completes the connection
+    return;
+  }
+
+  ctx->state = CONN_READING;
+  ctx->last_active = monotonic_now();
+
+  // Without a linked recv, the buffer holds a pipelined request
+  if (!linked) {
+    handle_buffered(r, ctx);
+  }
+}
+
+/**
+ * send_file_uring sends a connection's file body once its headers are out.
+ * io_uring has no sendfile op, so the reactor calls sendfile(2) itself with the
+ * socket briefly made non-blocking, and polls for the socket to drain whenever
+ * it fills up. The kernel still copies the file straight to the socket
+ */
+static void send_file_uring(reactor *r, client_context *ctx) {
+  if (!set_nonblocking(ctx->sockfd, true)) {
+    close_connection(r, ctx);
+    return;
+  }
+
+  while (ctx->out_fd_remaining > 0) {
+    if (response_sendfile(ctx) != -1 || errno == EINTR) {
+      continue;
+    }
+
+    bool blocked = errno == EAGAIN || errno == EWOULDBLOCK;
+
+    // io_uring ops on a non-blocking socket fail with EAGAIN instead of waiting
+    set_nonblocking(ctx->sockfd, false);
+
+    if (!blocked || !submit_poll_writable(r, ctx)) {
+      printlogf(YS_LOG_INFO,
+                "[reactor::%s] failed to send file body on sockfd %d\n",
+                __func__, ctx->sockfd);
+      close_connection(r, ctx);
+    }
+    return;
+  }
+
+  set_nonblocking(ctx->sockfd, false);
+  response_close_file(ctx);
+
+  if (!ctx->keep_alive) {
+    close_connection(r, ctx);
+    return;
+  }
+
+  ctx->state = CONN_READING;
+  ctx->last_active = monotonic_now();
+  handle_buffered(r, ctx);
+}
+
+static void handle_poll_writable_completion(reactor *r, client_context *ctx,
+                                            int res) {
+  if (res < 0 || ctx->state == CONN_CLOSED) {
+    close_connection(r, ctx);
+    return;
+  }
+
+  send_file_uring(r, ctx);
+}
+
+static void handle_close_completion(reactor *r, client_context *ctx, int res) {
+  // A close linked after a short send is cancelled; the send is retried along
+  // with a fresh close
+  if (res == -ECANCELED && ctx->state != CONN_CLOSED) {
+    return;
+  }
+
+  if (res == 0) {
+    ctx->sockfd = -1;
+  }
+
+  close_connection(r, ctx);
+}
+
+static void handle_completion(reactor *r, struct io_uring_cqe *cqe) {
+  uring_op op = cqe->user_data & URING_OP_MASK;
+  client_context *ctx =
+      (client_context *)(uintptr_t)(cqe->user_data & ~(__u64)URING_OP_MASK);
+
+  switch (op) {
+    case URING_OP_ACCEPT:
+      handle_accept_completion(r, cqe->res, cqe->flags);
+      return;
+
+    case URING_OP_WAKE:
+      take_returned(r);
+
+      if (!submit_wake_read(r)) {
+        DIE("[reactor::%s] failed to submit wake pipe read\n", __func__);
+      }
+      return;
+
+    case URING_OP_TIMEOUT:
+      sweep_idle(r);
+
+      if (!submit_timeout(r)) {
+        DIE("[reactor::%s] failed to submit sweep timeout\n", __func__);
+      }
+      return;
+
+    default:
+      break;
+  }
+
+  // Everything else is an operation on a client connection
+  ctx->inflight--;
+
+  switch (op) {
+    case URING_OP_RECV:
+      handle_recv_completion(r, ctx, cqe->res);
+      break;
+
+    case URING_OP_SEND:
+    case URING_OP_SEND_LINKED:
+      handle_send_completion(r, ctx, cqe->res, op == URING_OP_SEND_LINKED);
+      break;
+
+    case URING_OP_CLOSE:
+      handle_close_completion(r, ctx, cqe->res);
+      break;
+
+    case URING_OP_POLL_WRITABLE:
+      handle_poll_writable_completion(r, ctx, cqe->res);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * run_uring runs the reactor's event loop on io_uring. Instead of waiting for
+ * readiness and then making syscalls, the reactor submits the accepts, reads
+ * and writes themselves and handles their completions
+ */
+static void run_uring(reactor *r) {
+  if (!submit_accept(r) || !submit_wake_read(r) ||
+      (server_conf.keep_alive_timeout > 0 && !submit_timeout(r))) {
+    DIE("[reactor::%s] failed to submit initial operations\n", __func__);
+  }
+
+  while (true) {
+    if (uring_submit_and_wait(r->ring, 1) == -1) {
+      perror("io_uring_enter");
+      printlogf(YS_LOG_DEBUG,
+                "[reactor::%s] io_uring_enter failed; retrying...\n",
+                __func__);
+      continue;
+    }
+
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek_cqe(r->ring))) {
+      struct io_uring_cqe completion = *cqe;
+      uring_cqe_seen(r->ring);
+
+      handle_completion(r, &completion);
+    }
+  }
+}
+#endif
+
+/**
+ * setup_uring switches the reactor to io_uring if the server asked for it and
+ * it's available. Returns false if the reactor should use the poller instead
+ */
+static bool setup_uring(reactor *r) {
+  r->ring = NULL;
+
+  if (r->server->io_engine != YS_IO_ENGINE_URING) {
+    return false;
+  }
+
+#ifdef HAVE_IO_URING
+  if (r->server->sslctx) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] io_uring does not support TLS; falling back to "
+              "the poller\n",
+              __func__);
+    return false;
+  }
+
+  if (!(r->ring = uring_init(URING_ENTRIES))) {
+    printlogf(YS_LOG_INFO,
+              "[reactor::%s] io_uring is unavailable; falling back to the "
+              "poller\n",
+              __func__);
+    return false;
+  }
+
+#ifdef IORING_ACCEPT_MULTISHOT
+  r->multishot_accept = true;
+#else
+  r->multishot_accept = false;
+#endif
+
+  r->sweep_interval.tv_sec = IDLE_SWEEP_INTERVAL_MS / 1000;
+  r->sweep_interval.tv_nsec = (IDLE_SWEEP_INTERVAL_MS % 1000) * 1000000;
+
+  // io_uring waits on the listener and wake pipe itself; a non-blocking fd
+  // would surface EAGAIN instead
+  set_nonblocking(r->listen_fd, false);
+  set_nonblocking(r->wake_fds[0], false);
+
+  return true;
+#else
+  printlogf(YS_LOG_INFO,
+            "[reactor::%s] io_uring is not supported on this platform; "
+            "falling back to the poller\n",
+            __func__);
+  return false;
+#endif
+}
+
+reactor *reactor_init(server_internal *server, int listen_fd,
+                      work_queue_t *queue) {
+  reactor *r = xmalloc(sizeof(reactor));
+  r->server = server;
+  r->listen_fd = listen_fd;
+  r->queue = queue;
+  r->returned = NULL;
+  r->connections = NULL;
+  r->last_sweep = 0;
+  pthread_mutex_init(&r->lock, NULL);
+
+  if (pipe(r->wake_fds) == -1 || !set_nonblocking(r->wake_fds[0], true) ||
+      !set_nonblocking(r->wake_fds[1], true)) {
+    perror("pipe");
+    DIE("[reactor::%s] failed to initialize wake pipe\n", __func__);
+  }
+
+  if (setup_uring(r)) {
+    r->pollfd = -1;
+    return r;
+  }
+
+  if ((r->pollfd = poller_init()) == -1) {
+    perror("poller_init");
+    DIE("[reactor::%s] failed to initialize poller\n", __func__);
+  }
+
+  if (!poller_add(r->pollfd, listen_fd, &r->listen_fd)) {
+    DIE("[reactor::%s] failed to register listening socket with poller\n",
+        __func__);
+  }
+
+  if (!poller_add(r->pollfd, r->wake_fds[0], r->wake_fds)) {
+    DIE("[reactor::%s] failed to register wake pipe with poller\n", __func__);
+  }
+
+  return r;
+}
+
+void reactor_release(reactor *r, client_context *ctx) {
+  pthread_mutex_lock(&r->lock);
+  ctx->next_returned = r->returned;
+  r->returned = ctx;
+  pthread_mutex_unlock(&r->lock);
+
+  // A full pipe means the reactor already has a wakeup pending
+  if (write(r->wake_fds[1], "", 1) == -1 && errno != EAGAIN) {
+    perror("write");
+  }
+}
+
+void reactor_complete(reactor *r, client_context *ctx) {
+  // The io_uring engine sends the response itself, as does a reactor without
+  // workers, once the connection is released
+  if (r->ring || !r->queue) {
+    reactor_release(r, ctx);
+    return;
+  }
+
+  thread_context *tc = xmalloc(sizeof(thread_context));
+  tc->reactor = r;
+  tc->c = ctx;
+  tc->r = r->server->router;
+  tc->req = NULL;
+
+  // The request has already been served, so it may not be rejected now
+  work_queue_push(r->queue, send_thread_handler, tc);
+}
+
+void reactor_run(reactor *r) {
+#ifdef HAVE_IO_URING
+  if (r->ring) {
+    run_uring(r);
+    return;
+  }
+#endif
+
+  poller_event events[POLLER_MAX_EVENTS];
+
+  // Sweep for idle connections, stalled TLS handshakes and stalled sends, if
+  // any can occur
+  bool sweep =
+      server_conf.keep_alive_timeout > 0 || r->server->sslctx || !r->queue;
+  int timeout_ms = sweep ? IDLE_SWEEP_INTERVAL_MS : -1;
+
+  while (true) {
+    int n = poller_wait(r->pollfd, events, POLLER_MAX_EVENTS, timeout_ms);
+
+    if (n == -1) {
+      perror("poller_wait");
+      printlogf(YS_LOG_DEBUG, "[reactor::%s] poller_wait failed; retrying...\n",
+                __func__);
+      continue;
+    }
+
+    for (int i = 0; i < n; i++) {
+      if (events[i].data == &r->listen_fd) {
+        accept_connections(r);
+        continue;
+      }
+
+      if (events[i].data == r->wake_fds) {
+        drain_returned(r);
+        continue;
+      }
+
+      client_context *ctx = events[i].data;
+
+      if (events[i].hangup) {
+        close_connection(r, ctx);
+        continue;
+      }
+
+      if (ctx->handshaking) {
+        advance_handshake(r, ctx);
+      } else if (ctx->state == CONN_FLUSHING) {
+        finish_request(r, ctx);
+      } else {
+        handle_readable(r, ctx);
+      }
+    }
+
+    if (sweep) {
+      sweep_idle(r);
+    }
+  }
+}
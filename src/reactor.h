@@ -0,0 +1,100 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <pthread.h>
+#include <time.h>
+
+#include "client.h"
+#include "lib.thread/libthread.h"
+#include "server.h"
+#include "uring.h"
+
+/**
+ * A reactor is an event loop that multiplexes the listening socket and every
+ * open client connection over a single poller. It accepts connections, reads
+ * and parses requests without blocking, and hands only complete requests off
+ * to the worker threads via a lock-free queue. Once a worker has sent its
+ * response, the connection is handed back to the reactor, which either closes
+ * it or waits for the next request on it.
+ */
+typedef struct reactor {
+  /**
+   * The poller (epoll / kqueue) file descriptor
+   */
+  int pollfd;
+
+  /**
+   * The non-blocking listening socket
+   */
+  int listen_fd;
+
+  /**
+   * A pipe used by workers to wake the reactor when they return a connection
+   */
+  int wake_fds[2];
+
+  server_internal *server;
+
+  /**
+   * The worker threads' task queue. If NULL, requests are handled on the
+   * reactor's own thread and never cross to another
+   */
+  work_queue_t *queue;
+
+  // Guards `returned`
+  pthread_mutex_t lock;
+
+  // Connections handed back by workers once their response has been sent
+  client_context *returned;
+
+  // Every open connection; used to enforce the keep-alive idle timeout
+  client_context *connections;
+
+  // Monotonic time (in seconds) of the last idle connection sweep
+  time_t last_sweep;
+
+  /**
+   * The io_uring instance driving the reactor, or NULL if it is driven by the
+   * poller
+   */
+  struct uring *ring;
+
+#ifdef HAVE_IO_URING
+  // Whether the kernel supports a single accept that keeps yielding connections
+  bool multishot_accept;
+
+  // Scratch space for draining the wake pipe
+  char wake_buf[64];
+
+  // The interval at which idle connections are swept
+  struct __kernel_timespec sweep_interval;
+#endif
+} reactor;
+
+/**
+ * reactor_init allocates a new reactor for the given server and registers the
+ * non-blocking listening socket `listen_fd` with it. `queue` may be NULL, in
+ * which case the reactor handles every request itself
+ */
+reactor *reactor_init(server_internal *server, int listen_fd,
+                      work_queue_t *queue);
+
+/**
+ * reactor_release hands a connection back to the reactor once its response has
+ * been sent. Safe to call from any thread.
+ */
+void reactor_release(reactor *r, client_context *ctx);
+
+/**
+ * reactor_complete hands a connection whose response was prepared away from the
+ * I/O threads, and left in `ctx->out`, back to the I/O path to be sent. Safe to
+ * call from any thread.
+ */
+void reactor_complete(reactor *r, client_context *ctx);
+
+/**
+ * reactor_run runs the reactor's event loop. This function does not return.
+ */
+void reactor_run(reactor *r);
+
+#endif /* REACTOR_H */
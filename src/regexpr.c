@@ -1,11 +1,22 @@
 #include "regexpr.h"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "logger.h"
+#include "xmalloc.h"
 
-pcre *regex_compile(const char *pattern) {
+// The initial and largest sizes of a thread's JIT stack. PCRE's default stack
+// of 32K, which is on the machine stack, is too small for some expressions
+#define JIT_STACK_START (32 * 1024)
+#define JIT_STACK_MAX (512 * 1024)
+
+// The JIT stack the calling thread matches on, allocated by its first match.
+// Threads live as long as the server, and their stacks with them
+static _Thread_local pcre_jit_stack *jit_stack = NULL;
+
+regex *regex_compile(const char *pattern) {
   const char *error;
   int erroffset;
 
@@ -18,12 +29,55 @@ pcre *regex_compile(const char *pattern) {
     return NULL;
   }
 
-  return re;
+  // A failed study leaves the expression to the interpreter
+  pcre_extra *extra = pcre_study(re, PCRE_STUDY_JIT_COMPILE, &error);
+  if (error) {
+    printlogf(LOG_INFO, "[regexpr::%s] PCRE study of %s failed: %s\n",
+              __func__, pattern, error);
+  }
+
+  int jit = 0;
+  if (extra) {
+    pcre_fullinfo(re, extra, PCRE_INFO_JIT, &jit);
+  }
+
+  regex *compiled = xmalloc(sizeof(regex));
+  compiled->re = re;
+  compiled->extra = extra;
+  compiled->jit = jit == 1;
+
+  return compiled;
 }
 
-bool regex_match(pcre *re, char *cmp) {
+int regex_exec(const regex *re, const char *cmp, size_t len, int *ovector,
+               int ovecsize) {
+  if (!re->jit) {
+    return pcre_exec(re->re, re->extra, cmp, len, 0, 0, ovector, ovecsize);
+  }
+
+  if (!jit_stack) {
+    jit_stack = pcre_jit_stack_alloc(JIT_STACK_START, JIT_STACK_MAX);
+    if (!jit_stack) {
+      DIE("[regexpr::%s] failed to allocate a JIT stack\n", __func__);
+    }
+  }
+
+  return pcre_jit_exec(re->re, re->extra, cmp, len, 0, 0, ovector, ovecsize,
+                       jit_stack);
+}
+
+bool regex_match(const regex *re, const char *cmp, size_t len) {
   int ovecsize = 30;  // TODO: size
   int ovector[ovecsize];
 
-  return pcre_exec(re, NULL, cmp, strlen(cmp), 0, 0, ovector, ovecsize) > 0;
+  return regex_exec(re, cmp, len, ovector, ovecsize) > 0;
+}
+
+void regex_free(regex *re) {
+  if (re->extra) {
+    pcre_free_study(re->extra);
+  }
+
+  pcre_free(re->re);
+  free(re);
 }
@@ -3,9 +3,42 @@
 
 #include <pcre.h>
 #include <stdbool.h>
+#include <stddef.h>
 
-pcre *regex_compile(const char *pattern);
+/**
+ * regex is a compiled expression along with what pcre_study learned of it,
+ * including its JIT-compiled code where PCRE supports JIT compilation
+ */
+typedef struct {
+  pcre *re;
+  pcre_extra *extra;
+  // Whether `extra` holds JIT-compiled code for the expression
+  bool jit;
+} regex;
 
-bool regex_match(pcre *re, char *cmp);
+/**
+ * regex_compile compiles and studies `pattern`, JIT-compiling it where
+ * possible. Returns NULL if the pattern is invalid
+ */
+regex *regex_compile(const char *pattern);
+
+/**
+ * regex_exec matches the `len` bytes at `cmp` against the expression `re`,
+ * storing the offsets of the match and its captures in `ovector` as pcre_exec
+ * does. Returns pcre_exec's result. It may be called from any thread; each
+ * matches on a JIT stack of its own
+ */
+int regex_exec(const regex *re, const char *cmp, size_t len, int *ovector,
+               int ovecsize);
+
+/**
+ * regex_match tests whether the `len` bytes at `cmp` match the expression `re`
+ */
+bool regex_match(const regex *re, const char *cmp, size_t len);
+
+/**
+ * regex_free deallocates a compiled expression
+ */
+void regex_free(regex *re);
 
 #endif /* REGEXPR_H */
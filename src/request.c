@@ -4,21 +4,33 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <openssl/ssl.h>
+#include <poll.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
+#include "arena.h"
 #include "client.h"
 #include "header.h"
 #include "libhash/libhash.h"
 #include "libutil/libutil.h"
 #include "libys.h"
+#include "logger.h"
+#include "param.h"
 #include "path.h"
 #include "picohttpparser/picohttpparser.h"
-#include "request.h"
+#include "url.h"
+#include "util.h"
 #include "xmalloc.h"
 
-#define REQ_BUFFER_SIZE 4096
+// How long ys_req_read_body waits for the client to send more of the body
+static const int BODY_READ_TIMEOUT_MS = 30000;
+
+// The initial size of a connection's body buffer, which grows from there as
+// the body arrives
+#define BODY_BUFFER_INITIAL (16 * 1024)
 
 /**
  * fix_pragma_cache_control implements RFC 7234, section 5.4:
@@ -32,89 +44,559 @@ static void fix_pragma_cache_control(hash_table* headers) {
   }
 }
 
-// TODO: break up into two functions
-maybe_request req_read_and_parse(client_context* ctx) {
-  char* method = NULL;
-  char* path = NULL;
+/**
+ * wants_keep_alive determines whether the client expects the connection to be
+ * held open after the response. HTTP/1.1 connections persist unless the client
+ * sends `Connection: close`, whereas HTTP/1.0 clients must opt in with
+ * `Connection: keep-alive`
+ */
+static bool wants_keep_alive(hash_table* headers, int minor_version) {
+  if (minor_version >= 1) {
+    return !header_has_token(headers, CONNECTION, "close");
+  }
+
+  return header_has_token(headers, CONNECTION, "keep-alive");
+}
 
-  char buf[REQ_BUFFER_SIZE];
-  memset(buf, 0, REQ_BUFFER_SIZE);
+/**
+ * is_chunked tests whether the final transfer coding in the Transfer-Encoding
+ * value of `len` bytes at `value` is chunked
+ */
+static bool is_chunked(const char* value, size_t len) {
+  static const char CHUNKED[] = "chunked";
 
-  int pret, minor_version;
-  struct phr_header headers[100];  // TODO: configure max headers
-  size_t buflen = 0, prev_buflen = 0, method_len, path_len, num_headers;
+  while (len > 0 && (value[len - 1] == ' ' || value[len - 1] == '\t')) {
+    len--;
+  }
+
+  size_t start = len;
+  while (start > 0 && value[start - 1] != ',' && value[start - 1] != ' ' &&
+         value[start - 1] != '\t') {
+    start--;
+  }
+
+  return len - start == strlen(CHUNKED) &&
+         strncasecmp(value + start, CHUNKED, len - start) == 0;
+}
+
+/**
+ * parse_content_length parses the Content-Length value of `len` bytes at
+ * `value`, which may be a list of the same length repeated. Returns false
+ * unless every element is a decimal number that fits a size_t, and all agree
+ */
+static bool parse_content_length(const char* value, size_t len,
+                                 size_t* body_len, bool* seen) {
+  size_t i = 0;
+
+  while (i < len) {
+    while (i < len && (value[i] == ' ' || value[i] == '\t')) i++;
+
+    size_t n = 0;
+    size_t digits = 0;
+    for (; i < len && value[i] >= '0' && value[i] <= '9'; i++, digits++) {
+      size_t digit = value[i] - '0';
+      if (n > (SIZE_MAX - digit) / 10) {
+        return false;
+      }
+
+      n = n * 10 + digit;
+    }
+
+    while (i < len && (value[i] == ' ' || value[i] == '\t')) i++;
+
+    if (digits == 0 || (i < len && value[i++] != ',') ||
+        (*seen && n != *body_len)) {
+      return false;
+    }
+
+    *body_len = n;
+    *seen = true;
+  }
+
+  return *seen;
+}
+
+/**
+ * get_body_len determines how many of the bytes following the request head
+ * belong to the request body. Sets `chunked` if the body is chunked, in which
+ * case its length is unknown until its last chunk has been read. Sets
+ * `delimited` to false if the body is framed by both chunking and a
+ * Content-Length, which a proxy in front of us may have taken for the body's
+ * length instead; the request is answered, but the connection can't be trusted
+ * with another. Returns BAD_LENGTH if a Content-Length is malformed or
+ * contradicts another, BAD_ENCODING if the final transfer coding isn't chunked,
+ * in which case the body's end can't be known, or 0
+ */
+static parse_error get_body_len(struct phr_header* headers, size_t num_headers,
+                                size_t* body_len, bool* delimited,
+                                bool* chunked) {
+  bool has_encoding = false;
+  bool has_length = false;
+  *body_len = 0;
+  *delimited = true;
+  *chunked = false;
+
+  for (size_t i = 0; i < num_headers; i++) {
+    if (headers[i].name_len == strlen(TRANSFER_ENCODING) &&
+        strncasecmp(headers[i].name, TRANSFER_ENCODING,
+                    headers[i].name_len) == 0) {
+      has_encoding = true;
+      *chunked = is_chunked(headers[i].value, headers[i].value_len);
+      continue;
+    }
+
+    if (headers[i].name_len == strlen(CONTENT_LENGTH) &&
+        strncasecmp(headers[i].name, CONTENT_LENGTH, headers[i].name_len) ==
+            0 &&
+        !parse_content_length(headers[i].value, headers[i].value_len,
+                              body_len, &has_length)) {
+      return BAD_LENGTH;
+    }
+  }
+
+  if (!has_encoding) {
+    return 0;
+  }
+
+  // Per RFC 9112, a request's body must end with its last chunk
+  if (!*chunked) {
+    return BAD_ENCODING;
+  }
+
+  // A Transfer-Encoding overrides any Content-Length
+  *body_len = 0;
+  *delimited = !has_length;
+
+  return 0;
+}
+
+/**
+ * expects_continue tests whether the client sent `Expect: 100-continue`, in
+ * which case it may hold off on sending the body until told to go ahead
+ */
+static bool expects_continue(struct phr_header* headers, size_t num_headers,
+                             int minor_version) {
+  static const char EXPECT[] = "Expect";
+  static const char CONTINUE[] = "100-continue";
+
+  if (minor_version < 1) {
+    return false;
+  }
+
+  for (size_t i = 0; i < num_headers; i++) {
+    if (headers[i].name_len == strlen(EXPECT) &&
+        strncasecmp(headers[i].name, EXPECT, headers[i].name_len) == 0 &&
+        headers[i].value_len == strlen(CONTINUE) &&
+        strncasecmp(headers[i].value, CONTINUE, headers[i].value_len) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * parse_method returns the ys_http_method named by the `len` bytes at `method`,
+ * or 0 if it names none of them
+ */
+static ys_http_method parse_method(const char* method, size_t len) {
+  str_view name = {method, len};
+
+  for (int m = YS_METHOD_GET; m <= YS_METHOD_TRACE; m++) {
+    if (view_equals(name, ys_http_method_names[m])) {
+      return m;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * tls_read reads up to `capacity` decrypted bytes into `dst` via OpenSSL.
+ * Returns the number of bytes read, or -1 with errno set to EAGAIN if the read
+ * would block, or to EPIPE if the connection failed or was closed
+ */
+static ssize_t tls_read(client_context* ctx, char* dst, size_t capacity) {
+  ssize_t bytes_read = SSL_read(ctx->ssl, dst, capacity);
+
+  if (bytes_read <= 0) {
+    int err = SSL_get_error(ctx->ssl, bytes_read);
+    errno = err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? EAGAIN
+                                                                      : EPIPE;
+    return -1;
+  }
+
+  return bytes_read;
+}
+
+/**
+ * read_some reads up to `capacity` bytes from the client into `dst`. Returns
+ * the number of bytes read, 0 if the peer closed the connection, or -1 with
+ * errno set
+ */
+static ssize_t read_some(client_context* ctx, char* dst, size_t capacity) {
   ssize_t bytes_read;
 
+  // Once the kernel decrypts the connection's records, read the plaintext
+  // straight from the socket, unless OpenSSL still holds some of its own
+  if (ctx->ssl && (!ctx->ktls_recv || SSL_pending(ctx->ssl) > 0)) {
+    return tls_read(ctx, dst, capacity);
+  }
+
+  while ((bytes_read = read(ctx->sockfd, dst, capacity)) == -1 &&
+         errno == EINTR)
+    ;
+
+  // The kernel won't hand a control record (an alert or a TLS 1.3 KeyUpdate)
+  // to read(2); OpenSSL receives and processes those itself
+  if (bytes_read == -1 && errno == EIO && ctx->ktls_recv) {
+    bytes_read = tls_read(ctx, dst, capacity);
+  }
+
+  return bytes_read;
+}
+
+/**
+ * reserve_body grows the connection's body buffer to hold at least `capacity`
+ * bytes, plus a NUL terminator
+ */
+static void reserve_body(client_context* ctx, size_t capacity) {
+  if (ctx->body_cap >= capacity) {
+    return;
+  }
+
+  char* body = realloc(ctx->body, capacity + 1);
+  if (!body) {
+    DIE("[request::%s] failed to grow body buffer to %zu bytes\n", __func__,
+        capacity);
+  }
+
+  ctx->body = body;
+  ctx->body_cap = capacity;
+}
+
+char* req_recv_buffer(client_context* ctx, size_t* capacity) {
+  if (!ctx->pending) {
+    *capacity = REQ_BUFFER_SIZE - ctx->buflen;
+    return ctx->buf + ctx->buflen;
+  }
+
+  // A chunked body of unknown length is read in after what has been decoded
+  // so far. There's always room for another read buffer's worth, but never for
+  // much more than the request's limit
+  if (ctx->pending->chunked) {
+    size_t used = ctx->body_len + ctx->body_undecoded;
+    size_t max_body_size = ctx->pending->max_body_size;
+
+    if (ctx->body_cap - used < REQ_BUFFER_SIZE) {
+      size_t grown = ctx->body_cap * 2;
+      if (max_body_size > 0 && grown > max_body_size + REQ_BUFFER_SIZE) {
+        grown = max_body_size + REQ_BUFFER_SIZE;
+      }
+
+      reserve_body(ctx, grown > used ? grown : used);
+    }
+
+    *capacity = ctx->body_cap - used;
+    return ctx->body + used;
+  }
+
+  // Grow the buffer geometrically, but never past the end of the body
+  if (ctx->body_len == ctx->body_cap) {
+    size_t grown = ctx->body_cap * 2;
+    reserve_body(ctx, grown < ctx->body_expected ? grown : ctx->body_expected);
+  }
+
+  size_t remaining = ctx->body_expected - ctx->body_len;
+  size_t space = ctx->body_cap - ctx->body_len;
+
+  *capacity = remaining < space ? remaining : space;
+  return ctx->body + ctx->body_len;
+}
+
+void req_recv_commit(client_context* ctx, size_t len) {
+  // A chunked body is decoded by req_parse
+  if (ctx->pending && ctx->pending->chunked) {
+    ctx->body_undecoded += len;
+    return;
+  }
+
+  if (ctx->pending) {
+    ctx->body_len += len;
+    ctx->body[ctx->body_len] = NULL_TERMINATOR;
+    return;
+  }
+
+  ctx->buflen += len;
+  ctx->buf[ctx->buflen] = NULL_TERMINATOR;
+}
+
+ssize_t req_read(client_context* ctx) {
+  ssize_t total = 0;
+
   while (true) {
-    if (ctx->ssl) {
-      while ((bytes_read = SSL_read(ctx->ssl, buf + buflen,
-                                    sizeof(buf) - buflen)) == -1 &&
-             errno == EINTR)
-        ;
-    } else {
-      while ((bytes_read = read(ctx->sockfd, buf + buflen,
-                                sizeof(buf) - buflen)) == -1 &&
-             errno == EINTR)
-        ;
+    size_t capacity;
+    char* dst = req_recv_buffer(ctx, &capacity);
+    if (capacity == 0) {
+      break;
+    }
+
+    ssize_t bytes_read = read_some(ctx, dst, capacity);
+
+    if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
     }
 
     if (bytes_read <= 0) {
-      maybe_request meta = {.err = IO_ERR};
-      return meta;
+      return total > 0 ? total : -1;
     }
 
-    prev_buflen = buflen;
-    buflen += bytes_read;
+    req_recv_commit(ctx, bytes_read);
+    total += bytes_read;
+  }
+
+  return total;
+}
+
+void req_await_body(client_context* ctx, request_internal* req) {
+  size_t initial = req->content_len < BODY_BUFFER_INITIAL && !req->chunked
+                       ? req->content_len
+                       : BODY_BUFFER_INITIAL;
+  reserve_body(ctx, initial > req->body_len ? initial : req->body_len);
+
+  // Start the body off with whatever of it arrived along with the head
+  memcpy(ctx->body, req->body, req->body_len);
+  ctx->body_len = req->body_len;
+  ctx->body_expected = req->content_len;
+  ctx->body[ctx->body_len] = NULL_TERMINATOR;
+  ctx->pending = req;
+
+  req->body = NULL;
+  req->body_len = 0;
+  req->body_remaining = 0;
+}
 
-    num_headers = sizeof(headers) / sizeof(headers[0]);
-    pret =
-        phr_parse_request(buf, buflen, &method, &method_len, &path, &path_len,
-                          &minor_version, headers, &num_headers, prev_buflen);
+/**
+ * return_leftover hands bytes read past the end of a chunked body, which belong
+ * to the next request, back to the connection's read buffer. Returns false if
+ * they don't fit, in which case they're dropped and the connection can't be
+ * kept alive
+ */
+static bool return_leftover(client_context* ctx, const char* data,
+                            size_t len) {
+  if (len > REQ_BUFFER_SIZE - ctx->buflen) {
+    return false;
+  }
+
+  memmove(ctx->buf + ctx->buflen, data, len);
+  ctx->buflen += len;
+  ctx->buf[ctx->buflen] = NULL_TERMINATOR;
+
+  return true;
+}
+
+/**
+ * decode_pending decodes the chunks read into the connection's body buffer
+ * since the last call. Returns 0 once the last chunk has been decoded,
+ * REQ_INCOMPLETE if more chunks are to come, or the error the request should
+ * be refused with
+ */
+static parse_error decode_pending(client_context* ctx, request_internal* req) {
+  size_t decoded = ctx->body_undecoded;
+  ssize_t leftover =
+      phr_decode_chunked(&req->decoder, ctx->body + ctx->body_len, &decoded);
 
-    if (pret > 0) {
-      break;  // Successfully parsed the request
+  ctx->body_undecoded = 0;
+  ctx->body_len += decoded;
+
+  if (leftover == -1) {
+    return BAD_CHUNK;
+  }
+
+  // A chunk that would take the body over the limit is refused as soon as its
+  // size is known
+  size_t max_body_size = req->max_body_size;
+  if (max_body_size > 0 &&
+      (ctx->body_len > max_body_size ||
+       req->decoder.bytes_left_in_chunk > max_body_size - ctx->body_len)) {
+    return REQ_TOO_LONG;
+  }
+
+  if (leftover == -2) {
+    return REQ_INCOMPLETE;
+  }
+
+  if (!return_leftover(ctx, ctx->body + ctx->body_len, leftover)) {
+    req->keep_alive = false;
+  }
+
+  ctx->body[ctx->body_len] = NULL_TERMINATOR;
+  return 0;
+}
+
+/**
+ * take_pending returns the request whose body was being read into the
+ * connection's body buffer, now that all of it has arrived
+ */
+static maybe_request take_pending(client_context* ctx) {
+  request_internal* req = ctx->pending;
+
+  parse_error err = 0;
+  if (req->chunked) {
+    err = decode_pending(ctx, req);
+  } else if (ctx->body_len < ctx->body_expected) {
+    err = REQ_INCOMPLETE;
+  }
+
+  if (err) {
+    if (err != REQ_INCOMPLETE) {
+      ctx->pending = NULL;
+      request_free(req);
     }
 
-    if (pret == -1) {
-      maybe_request meta = {.err = PARSE_ERR};
+    maybe_request meta = {.err = err};
+    return meta;
+  }
+
+  ctx->pending = NULL;
+
+  // The buffer remains the connection's, and is reused for its next request
+  req->body = ctx->body;
+  req->body_len = ctx->body_len;
+  req->content_len = ctx->body_len;
+
+  maybe_request meta = {.req = req};
+  return meta;
+}
+
+maybe_request req_parse(client_context* ctx) {
+  char* method = NULL;
+  char* path = NULL;
+
+  int pret, minor_version;
+  struct phr_header headers[100];  // TODO: configure max headers
+  size_t method_len, path_len, num_headers;
+
+  if (ctx->pending) {
+    return take_pending(ctx);
+  }
+
+  num_headers = sizeof(headers) / sizeof(headers[0]);
+  pret = phr_parse_request(ctx->buf, ctx->buflen, &method, &method_len, &path,
+                           &path_len, &minor_version, headers, &num_headers,
+                           ctx->prev_buflen);
+
+  ctx->prev_buflen = ctx->buflen;
+
+  if (pret == -1) {
+    maybe_request meta = {.err = PARSE_ERR};
+    return meta;
+  }
+
+  // Request is incomplete
+  if (pret == -2) {
+    maybe_request meta = {.err = ctx->buflen == REQ_BUFFER_SIZE
+                                     ? REQ_TOO_LONG
+                                     : REQ_INCOMPLETE};
+    return meta;
+  }
+
+  bool delimited, chunked;
+  size_t available = ctx->buflen - pret;
+  size_t content_len;
+  parse_error err =
+      get_body_len(headers, num_headers, &content_len, &delimited, &chunked);
+  if (err) {
+    maybe_request meta = {.err = err};
+    return meta;
+  }
+
+  size_t body_len = content_len;
+  size_t body_remaining = 0;
+  struct phr_chunked_decoder decoder = {.consume_trailer = 1};
+  char* body;
+
+  if (chunked) {
+    // Decode what there is of the body so far, in place; the rest is decoded
+    // as it's read
+    body = ctx->buf + pret;
+    body_len = available;
+    ssize_t leftover = phr_decode_chunked(&decoder, body, &body_len);
+
+    if (leftover == -1) {
+      maybe_request meta = {.err = BAD_CHUNK};
       return meta;
     }
 
-    // Request is incomplete
-    if (pret == -2) {
-      continue;
+    // The decoder moves whatever follows the last chunk, which belongs to the
+    // next request, up against the decoded body
+    ctx->req_len = pret + body_len;
+    ctx->buflen = ctx->req_len + (leftover > 0 ? (size_t)leftover : 0);
+    ctx->buf[ctx->buflen] = NULL_TERMINATOR;
+    content_len = body_len;
+    if (leftover == -2) {
+      body_remaining = BODY_REMAINING_UNKNOWN;
     }
-
-    if (buflen == sizeof(buf)) {
-      maybe_request meta = {.err = REQ_TOO_LONG};
+  } else if (body_len > available) {
+    // Wait for the rest of the body if it will fit in the buffer
+    if (body_len <= REQ_BUFFER_SIZE - (size_t)pret) {
+      // The head is already complete, so the parser must not skip over it
+      ctx->prev_buflen = 0;
+
+      maybe_request meta = {.err = REQ_INCOMPLETE};
+      if (available == 0 && !ctx->continued &&
+          expects_continue(headers, num_headers, minor_version)) {
+        meta.err.code = REQ_EXPECT_CONTINUE;
+      }
       return meta;
     }
+
+    // Otherwise, the rest of the body is left on the connection
+    body_len = available;
+    body_remaining = content_len - available;
+  }
+
+  if (!chunked) {
+    ctx->req_len = pret + body_len;
+    body = ctx->buf + pret;
   }
 
-  request_internal* req = xmalloc(sizeof(request_internal));
-  req->raw = s_copy(buf);
-  req->body = s_copy(buf + pret);
-  req->method = fmt_str("%.*s", (int)method_len, method);
-  req->path = fmt_str("%.*s", (int)path_len, path);
-  req->route_path = s_copy(req->path);
-  req->pure_path = path_get_pure(req->path);
-  req->version = fmt_str("1.%d\n", minor_version);
+  // The request lasts until its response has been sent, when the connection's
+  // arena is reset and its read buffer reused
+  arena* a = ctx->arena;
+  request_internal* req = arena_alloc(a, sizeof(request_internal));
+  req->raw = (str_view){ctx->buf, ctx->req_len};
+  req->body = body;
+  req->body_len = body_len;
+  req->content_len = content_len;
+  req->body_offset = 0;
+  req->body_remaining = body_remaining;
+  req->max_body_size = 0;
+  req->chunked = chunked;
+  req->decoder = decoder;
+  req->conn = ctx;
+  req->method = parse_method(method, method_len);
+  req->method_name = req->method ? ys_http_method_names[req->method]
+                                 : arena_strndup(a, method, method_len);
+  req->path = (str_view){path, path_len};
+  req->route_path = req->path;
+  const char* query = memchr(path, '?', path_len);
+  req->pure_path = (str_view){path, query ? (size_t)(query - path) : path_len};
+  req->minor_version = minor_version;
+  req->route = NULL;
+  req->num_params = 0;
+  req->queries = NULL;
 
   // This is where we deal with the really quite complicated mess of HTTP
   // headers
   req->headers = ht_init(0);
   for (unsigned int i = 0; i != num_headers; ++i) {
-    char* header_key =
-        fmt_str("%.*s", (int)headers[i].name_len, headers[i].name);
-    char* header_val =
-        fmt_str("%.*s", (int)headers[i].value_len, headers[i].value);
+    char* header_key = arena_strndup(a, headers[i].name, headers[i].name_len);
+    char* header_val = arena_strndup(a, headers[i].value, headers[i].value_len);
 
     if (!insert_header(req->headers, header_key, header_val, true)) {
       // TODO: t
-      free((void*)req->body);
-      free((void*)req->raw);
-      free(req->route_path);
-      free(req);
+      request_free(req);
       maybe_request meta = {.err = DUP_HDR};
       return meta;
     }
@@ -122,34 +604,78 @@ maybe_request req_read_and_parse(client_context* ctx) {
 
   fix_pragma_cache_control(req->headers);
 
+  req->keep_alive = wants_keep_alive(req->headers, minor_version) && delimited;
+  req->expects_continue =
+      expects_continue(headers, num_headers, minor_version);
+
   maybe_request meta = {.req = req};
   return meta;
 }
 
+void request_free(request_internal* req) {
+  headers_free(req->headers);
+
+  if (req->queries) {
+    query_free(req->queries);
+  }
+}
+
+void* ys_req_alloc(ys_request* req, size_t size) {
+  return arena_alloc(((request_internal*)req)->conn->arena, size);
+}
+
 char* ys_req_get_parameter(ys_request* req, const char* key) {
   request_internal* ri = (request_internal*)req;
 
-  if (!ri->parameters) return NULL;
-  return ht_get(ri->parameters, key);
+  for (unsigned int i = 0; i < ri->num_params; i++) {
+    if (s_equals(ri->params[i].key, key)) {
+      // Parameters are views of the path, copied out only when asked for
+      str_view value = ri->params[i].value;
+      return arena_strndup(ri->conn->arena, value.ptr, value.len);
+    }
+  }
+
+  return NULL;
 }
 
-unsigned int ys_req_num_parameters(ys_request* req) {
+bool ys_req_get_parameter_int(ys_request* req, const char* key,
+                              long long* value) {
   request_internal* ri = (request_internal*)req;
 
-  if (!ri->parameters) return 0;
-  return ri->parameters->count;
+  for (unsigned int i = 0; i < ri->num_params; i++) {
+    route_param* param = &ri->params[i];
+    if (!s_equals(param->key, key)) {
+      continue;
+    }
+
+    if (param->is_int) {
+      *value = param->int_value;
+      return true;
+    }
+
+    return param_parse_int(param->value, true, value);
+  }
+
+  return false;
 }
 
-bool ys_req_has_parameters(ys_request* req) {
-  request_internal* ri = (request_internal*)req;
+unsigned int ys_req_num_parameters(ys_request* req) {
+  return ((request_internal*)req)->num_params;
+}
 
-  return req && ri->parameters && ri->parameters->count > 0;
+bool ys_req_has_parameters(ys_request* req) {
+  return req && ((request_internal*)req)->num_params > 0;
 }
 
 char** ys_req_get_query(ys_request* req, const char* key) {
-  array_t* arr = (array_t*)ht_get(((request_internal*)req)->queries, key);
+  request_internal* ri = (request_internal*)req;
+  if (!ri->queries) {
+    return NULL;
+  }
+
+  array_t* arr = (array_t*)ht_get(ri->queries, key);
   if (arr) {
-    char** values = xmalloc(array_size(arr));
+    char** values = xmalloc(array_size(arr) * sizeof(char*));
     foreach (arr, i) {
       values[i] = array_get(arr, i);
     }
@@ -173,27 +699,150 @@ unsigned int ys_req_num_queries(ys_request* req, const char* key) {
 }
 
 char* ys_req_get_path(ys_request* req) {
-  return s_copy(((request_internal*)req)->path);
+  return view_copy(((request_internal*)req)->path);
 }
 
 char* ys_req_get_route_path(ys_request* req) {
-  return s_copy(((request_internal*)req)->route_path);
+  return view_copy(((request_internal*)req)->route_path);
 }
 
 char* ys_req_get_method(ys_request* req) {
-  return s_copy(((request_internal*)req)->method);
+  return s_copy(((request_internal*)req)->method_name);
 }
 
 char* ys_req_get_body(ys_request* req) {
-  return s_copy(((request_internal*)req)->body);
+  request_internal* ri = (request_internal*)req;
+
+  char* body = xmalloc(ri->body_len + 1);
+  memcpy(body, ri->body, ri->body_len);
+  body[ri->body_len] = NULL_TERMINATOR;
+
+  return body;
+}
+
+size_t ys_req_get_body_len(ys_request* req) {
+  return ((request_internal*)req)->content_len;
+}
+
+/**
+ * await_readable waits for the client to send more bytes. Returns false if it
+ * sent none in time
+ */
+static bool await_readable(int sockfd) {
+  struct pollfd pfd = {.fd = sockfd, .events = POLLIN};
+
+  int n;
+  while ((n = poll(&pfd, 1, BODY_READ_TIMEOUT_MS)) == -1 && errno == EINTR)
+    ;
+
+  return n > 0;
+}
+
+/**
+ * read_body_bytes reads up to `len` bytes of a body left on the connection
+ * into `buf`, waiting for them to arrive. Returns -1 if the client hangs up or
+ * takes too long
+ */
+static ssize_t read_body_bytes(client_context* ctx, void* buf, size_t len) {
+  while (true) {
+    // OpenSSL may already hold decrypted bytes, which poll(2) can't see
+    if (!(ctx->ssl && SSL_pending(ctx->ssl) > 0) &&
+        !await_readable(ctx->sockfd)) {
+      printlogf(YS_LOG_INFO,
+                "[request::%s] timed out reading request body on sockfd %d\n",
+                __func__, ctx->sockfd);
+      return -1;
+    }
+
+    ssize_t bytes_read = read_some(ctx, buf, len);
+    if (bytes_read > 0) {
+      return bytes_read;
+    }
+
+    if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      continue;
+    }
+
+    // The client hung up or the read failed partway through the body
+    return -1;
+  }
+}
+
+ssize_t ys_req_read_body(ys_request* req, void* buf, size_t len) {
+  request_internal* ri = (request_internal*)req;
+
+  // The part of the body that was read along with the head comes first
+  if (ri->body_offset < ri->body_len) {
+    size_t n = ri->body_len - ri->body_offset;
+    if (n > len) {
+      n = len;
+    }
+
+    memcpy(buf, ri->body + ri->body_offset, n);
+    ri->body_offset += n;
+
+    return n;
+  }
+
+  if (ri->body_remaining == 0 || len == 0) {
+    return 0;
+  }
+
+  // Never read past the body, into whatever the client pipelined after it
+  if (len > ri->body_remaining) {
+    len = ri->body_remaining;
+  }
+
+  while (true) {
+    ssize_t bytes_read = read_body_bytes(ri->conn, buf, len);
+    if (bytes_read == -1) {
+      return -1;
+    }
+
+    if (!ri->chunked) {
+      ri->body_remaining -= bytes_read;
+      return bytes_read;
+    }
+
+    // Chunks are decoded in place, in the handler's buffer
+    size_t decoded = bytes_read;
+    ssize_t leftover = phr_decode_chunked(&ri->decoder, buf, &decoded);
+    if (leftover == -1) {
+      printlogf(YS_LOG_INFO, "[request::%s] malformed chunk on sockfd %d\n",
+                __func__, ri->conn->sockfd);
+      return -1;
+    }
+
+    ri->content_len += decoded;
+    if (ri->max_body_size > 0 && ri->content_len > ri->max_body_size) {
+      printlogf(YS_LOG_INFO,
+                "[request::%s] chunked body exceeds %zu bytes on sockfd %d\n",
+                __func__, ri->max_body_size, ri->conn->sockfd);
+      return -1;
+    }
+
+    if (leftover >= 0) {
+      ri->body_remaining = 0;
+
+      if (!return_leftover(ri->conn, (char*)buf + decoded, leftover)) {
+        ri->conn->keep_alive = false;
+      }
+    }
+
+    // A read of nothing but chunk framing yields no body bytes, but it isn't
+    // the end of the body either
+    if (decoded > 0 || leftover >= 0) {
+      return decoded;
+    }
+  }
 }
 
 char* ys_req_get_raw(ys_request* req) {
-  return s_copy(((request_internal*)req)->raw);
+  return view_copy(((request_internal*)req)->raw);
 }
 
 char* ys_req_get_version(ys_request* req) {
-  return s_copy(((request_internal*)req)->version);
+  return fmt_str("1.%d\n", ((request_internal*)req)->minor_version);
 }
 
 char* ys_req_get_header(ys_request* req, const char* key) {
@@ -1,23 +1,88 @@
 #ifndef REQUEST_H
 #define REQUEST_H
 
+#include <stdint.h>
+#include <sys/types.h>
+
 #include "client.h"
 #include "libys.h"
+#include "picohttpparser/picohttpparser.h"
+#include "trie.h"
+#include "util.h"
 
-typedef enum { IO_ERR = 1, PARSE_ERR, REQ_TOO_LONG, DUP_HDR } parse_error;
+// `body_remaining` of a chunked body whose last chunk has yet to arrive
+#define BODY_REMAINING_UNKNOWN SIZE_MAX
 
-typedef struct {
-  char *pure_path;
-  char *route_path;
-  const char *path;
-  const char *method;
+typedef enum {
+  IO_ERR = 1,
+  PARSE_ERR,
+  REQ_TOO_LONG,
+  DUP_HDR,
+  REQ_INCOMPLETE,
+  // As REQ_INCOMPLETE, but the client awaits a 100 Continue before it sends
+  // the body
+  REQ_EXPECT_CONTINUE,
+  // The chunked body is malformed
+  BAD_CHUNK,
+  // The Content-Length is malformed, or contradicts another
+  BAD_LENGTH,
+  // The final transfer coding isn't chunked, so the body's end is unknown
+  BAD_ENCODING
+} parse_error;
+
+/**
+ * request_internal is a parsed request. Its request line and body are views
+ * into the connection's read buffer, which holds them until the response has
+ * been sent
+ */
+typedef struct request_internal {
+  // The path as requested, less its query string, and the part of it that's
+  // left to route once sub-routers have consumed their prefixes
+  str_view pure_path;
+  str_view route_path;
+  str_view path;
+  // The request's method, or 0 if it's none the server knows, and its name:
+  // an entry of ys_http_method_names or else a copy of the method as sent
+  ys_http_method method;
+  const char *method_name;
   const char *body;
-  const char *raw;
-  const char *protocol;
-  const char *version;
-  hash_table *parameters;
+  // The length of `body`, which may hold any bytes, NULs included
+  size_t body_len;
+  // The length of the whole body, per the Content-Length or, for a chunked
+  // body, as much of it as has been decoded so far
+  size_t content_len;
+  /**
+   * How much of `body` has been consumed by ys_req_read_body, and how many
+   * bytes of the body have yet to be read from the connection. The latter is
+   * only non-zero for requests whose body outgrew the connection's read buffer
+   * and is streamed to the handler, and is BODY_REMAINING_UNKNOWN for a
+   * chunked body until its last chunk has been read
+   */
+  size_t body_offset;
+  size_t body_remaining;
+  // The largest body the request's route accepts, or 0 for no limit
+  size_t max_body_size;
+  // Whether the body is chunked, and the decoder's progress through it
+  bool chunked;
+  struct phr_chunked_decoder decoder;
+  // The connection the request arrived on, from which the body is streamed
+  client_context *conn;
+  // The head and body of the request, the latter decoded if chunked
+  str_view raw;
+  // The minor version of the request's HTTP/1.x protocol
+  int minor_version;
+  // The route the request matches, if it was looked up before the request was
+  // dispatched, as it is for a body that has to be awaited; NULL otherwise
+  route_result *route;
+  // The parameters captured from the path by the request's route
+  route_param params[MAX_ROUTE_PARAMS];
+  unsigned int num_params;
   hash_table *queries;
   hash_table *headers;
+  // Whether the client expects the connection to persist after the response
+  bool keep_alive;
+  // Whether the client awaits a 100 Continue before it sends the body
+  bool expects_continue;
 } request_internal;
 
 typedef struct {
@@ -29,6 +94,50 @@ typedef union {
   request_internal *req;
 } maybe_request;
 
-maybe_request req_read_and_parse(client_context *ctx);
+/**
+ * req_read drains the client socket into the connection's read buffer without
+ * blocking. Returns the number of bytes read (0 if the socket had nothing for
+ * us yet), or -1 if the peer closed the connection or the read failed
+ */
+ssize_t req_read(client_context *ctx);
+
+/**
+ * req_recv_buffer returns where the next bytes read from the client belong:
+ * the free space of the connection's read buffer or, while a request's body is
+ * being read, of its body buffer, which grows as needed. `capacity` receives
+ * how many bytes may be read there
+ */
+char *req_recv_buffer(client_context *ctx, size_t *capacity);
+
+/**
+ * req_recv_commit accounts for `len` bytes read into the space returned by
+ * req_recv_buffer
+ */
+void req_recv_commit(client_context *ctx, size_t len);
+
+/**
+ * req_await_body has the rest of the body of `req`, a request returned by
+ * req_parse with `body_remaining` bytes still to be read, read into the
+ * connection's body buffer. req_parse returns the request once the whole body
+ * has arrived, or an error if a chunked body is malformed or grows past the
+ * request's `max_body_size`
+ */
+void req_await_body(client_context *ctx, request_internal *req);
+
+/**
+ * req_parse attempts to parse a request from the bytes buffered on the
+ * connection. If the buffered bytes do not yet contain a full request, the
+ * REQ_INCOMPLETE error is returned and the caller should wait for more input.
+ * A body too large for the read buffer is left on the connection: the request
+ * is returned with `body_remaining` set, for the caller to either stream or
+ * await with req_await_body
+ */
+maybe_request req_parse(client_context *ctx);
+
+/**
+ * request_free releases what the request holds beyond the connection's arena,
+ * from which the request itself is allocated
+ */
+void request_free(request_internal *req);
 
 #endif /* REQUEST_H */
@@ -1,26 +1,81 @@
 #include "response.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <openssl/ssl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#elif defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#endif
+
 #include "header.h"
 #include "libutil/libutil.h"
 #include "logger.h"
 #include "util.h"
 #include "xmalloc.h"
 
-#define REQ_BUFFER_SIZE 4096
-
 static const char *CRLF = "\r\n";
 
+// The most a single sendfile(2) call is asked to send, so that one large file
+// can't monopolize the thread sending it
+#define SENDFILE_CHUNK_SIZE (1 << 20)
+
+// How much of a file body is read at a time when OpenSSL has to encrypt it;
+// the largest plaintext a single TLS record carries
+#define TLS_FILE_CHUNK_SIZE 16384
+
+// How many bytes of a streamed body are gathered before they're sent as a
+// chunk; larger writes are sent as chunks of their own, without being copied
+#define STREAM_BUFFER_SIZE 16384
+
+// Room before a streamed chunk for the CRLF that ends the chunk before it, the
+// chunk's size in hex and the CRLF after it
+#define STREAM_FRAMING_SIZE (2 + 16 + 2)
+
+// Has the kernel hold back a partial packet for the bytes sent after it, where
+// supported
+#ifdef MSG_MORE
+#define SEND_MORE MSG_MORE
+#else
+#define SEND_MORE 0
+#endif
+
+// The chunk that ends a chunked body, which has no trailers
+static const char LAST_CHUNK[] = "0\r\n\r\n";
+
+// Room after a streamed chunk for the CRLF that ends it and the last chunk
+#define STREAM_TRAILER_SIZE (2 + sizeof(LAST_CHUNK) - 1)
+
+/**
+ * await_writable waits for the non-blocking socket to drain enough for further
+ * writes. Returns false if the socket did not become writable in time
+ */
+static bool await_writable(int sockfd) {
+  struct pollfd pfd = {.fd = sockfd, .events = POLLOUT};
+
+  int n;
+  while ((n = poll(&pfd, 1, SEND_TIMEOUT_MS)) == -1 && errno == EINTR)
+    ;
+
+  return n > 0 && !(pfd.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
+
 static bool is_2xx_connect(request_internal *req, response_internal *res) {
   return (res->status >= 200 && res->status < 300) &&
-         s_equals(req->method, ys_http_method_names[YS_METHOD_CONNECT]);
+         req->method == YS_METHOD_CONNECT;
 }
 
 static bool is_informational(response_internal *res) {
@@ -31,143 +86,711 @@ static bool is_nocontent(response_internal *res) {
   return res->status == YS_STATUS_NO_CONTENT;
 }
 
+static bool is_not_modified(response_internal *res) {
+  return res->status == YS_STATUS_NOT_MODIFIED;
+}
+
 static bool should_set_content_len(request_internal *req,
                                    response_internal *res) {
   return !is_nocontent(res) && !is_informational(res) &&
+         !is_not_modified(res) &&
          (req ? !is_2xx_connect(req, res) : true);
 }
 
+// The status lines of the known statuses, built once
+static char *status_lines[YS_STATUS_NETWORK_AUTHENTICATION_REQUIRED + 1];
+static pthread_once_t status_lines_once = PTHREAD_ONCE_INIT;
+
+static void status_lines_init(void) {
+  for (int status = 0; status <= YS_STATUS_NETWORK_AUTHENTICATION_REQUIRED;
+       status++) {
+    if (ys_http_status_names[status]) {
+      status_lines[status] = fmt_str("HTTP/1.1 %d %s%s", status,
+                                     ys_http_status_names[status], CRLF);
+    }
+  }
+}
+
 /**
- * response_serialize converts a user-defined response object into a buffer that
- * can be sent over the wire
+ * status_line returns the status line of a response with the given status,
+ * formatting it into `buf` if the status isn't a known one
  */
-buffer_t *response_serialize(request_internal *req, response_internal *res) {
-  buffer_t *buf = buffer_init(NULL);
-  if (!buf) {
-    DIE("[response::%s] could not allocate memory for buffer_t\n", __func__);
+static const char *status_line(int status, char *buf, size_t len) {
+  pthread_once(&status_lines_once, status_lines_init);
+
+  if (status >= 0 && status <= YS_STATUS_NETWORK_AUTHENTICATION_REQUIRED &&
+      status_lines[status]) {
+    return status_lines[status];
   }
 
+  snprintf(buf, len, "HTTP/1.1 %d %s", status, CRLF);
+  return buf;
+}
+
+/**
+ * header_line is a header the serializer adds to those set on the response
+ */
+typedef struct {
+  const char *key;
+  const char *value;
+} header_line;
+
+// The most headers the serializer adds: a Content-Type and the body's framing
+#define EXTRA_HEADERS_MAX 2
+
+// Room for the digits of any 64-bit integer
+#define UINT_DIGITS_MAX 20
+
+/**
+ * format_uint writes the decimal digits of `n` to `dst`, NUL-terminated, and
+ * returns how many there are
+ */
+static size_t format_uint(char *dst, unsigned long long n) {
+  char digits[UINT_DIGITS_MAX];
+  char *p = digits + sizeof(digits);
+
+  do {
+    *--p = (char)('0' + n % 10);
+    n /= 10;
+  } while (n > 0);
+
+  size_t len = digits + sizeof(digits) - p;
+  memcpy(dst, p, len);
+  dst[len] = '\0';
+
+  return len;
+}
+
+/**
+ * has_header tests whether the response has a header `key`, matched
+ * case-insensitively
+ */
+static bool has_header(response_internal *res, const char *key) {
   hash_table *headers = res->headers;
-  const int status = res->status;
-  const char *body = res->body;
 
-  buffer_append(
-      buf, fmt_str("HTTP/1.1 %d %s", status, ys_http_status_names[status]));
-  buffer_append(buf, CRLF);
+  for (int i = 0; i < headers->capacity; i++) {
+    if (headers->records[i] && s_casecmp(key, headers->records[i]->key)) {
+      return true;
+    }
+  }
+
+  return false;
+}
 
-  bool has_content_type = false;
-  for (unsigned int i = 0; i < (unsigned int)headers->capacity; i++) {
+/**
+ * put copies the `len` bytes at `src` to `dst` and returns the end of the copy
+ */
+static char *put(char *dst, const char *src, size_t len) {
+  memcpy(dst, src, len);
+  return dst + len;
+}
+
+/**
+ * serialize_head writes the response's headers, then the `num_extra` headers
+ * in `extra`, then the blank line that ends them, into a serialized response
+ * of exactly the size they take. Multiple values of a header are joined with
+ * commas
+ */
+static serialized_response *serialize_head(response_internal *res,
+                                           header_line *extra,
+                                           int num_extra) {
+  hash_table *headers = res->headers;
+
+  // First, size the head so that it's written in one go
+  size_t size = 2;
+  for (int i = 0; i < headers->capacity; i++) {
     ht_record *header = headers->records[i];
     if (!header) continue;
 
-    if (!has_content_type && s_casecmp(CONTENT_TYPE, header->key)) {
-      has_content_type = true;
+    array_t *values = header->value;
+    size += strlen(header->key) + 4;
+
+    foreach (values, j) {
+      size += strlen(array_get(values, j)) + (j > 0 ? 2 : 0);
     }
+  }
+
+  for (int i = 0; i < num_extra; i++) {
+    size += strlen(extra[i].key) + strlen(extra[i].value) + 4;
+  }
+
+  serialized_response *out = serialized_response_init(size);
+  char *p = out->head;
+
+  for (int i = 0; i < headers->capacity; i++) {
+    ht_record *header = headers->records[i];
+    if (!header) continue;
+
+    array_t *values = header->value;
+    p = put(p, header->key, strlen(header->key));
+    p = put(p, ": ", 2);
+
+    foreach (values, j) {
+      if (j > 0) {
+        p = put(p, ", ", 2);
+      }
+
+      const char *value = array_get(values, j);
+      p = put(p, value, strlen(value));
+    }
+
+    p = put(p, CRLF, 2);
+  }
+
+  for (int i = 0; i < num_extra; i++) {
+    p = put(p, extra[i].key, strlen(extra[i].key));
+    p = put(p, ": ", 2);
+    p = put(p, extra[i].value, strlen(extra[i].value));
+    p = put(p, CRLF, 2);
+  }
 
-    buffer_append(buf, fmt_str("%s: %s", header->key,
-                               str_join((array_t *)header->value, ", ")));
-    buffer_append(buf, CRLF);
+  p = put(p, CRLF, 2);
+  *p = '\0';
+
+  out->head_len = size;
+  return out;
+}
+
+serialized_response *serialized_response_init(size_t head_size) {
+  serialized_response *out =
+      xmalloc(sizeof(serialized_response) + head_size + 1);
+
+  out->body = NULL;
+  out->head_len = 0;
+  out->head[0] = '\0';
+
+  memset(&out->msg, 0, sizeof(out->msg));
+  out->msg.msg_iov = out->iov;
+  out->msg.msg_iovlen = 0;
+
+  return out;
+}
+
+void serialized_response_free(serialized_response *out) {
+  free(out->body);
+  free(out);
+}
+
+/**
+ * push_iov appends `len` bytes at `data` to what's left to send of `out`
+ */
+static void push_iov(serialized_response *out, const char *data, size_t len) {
+  if (len == 0) {
+    return;
   }
 
+  out->iov[out->msg.msg_iovlen].iov_base = (void *)data;
+  out->iov[out->msg.msg_iovlen].iov_len = len;
+  out->msg.msg_iovlen++;
+}
+
+/**
+ * advance_msg drops the first `len` bytes from what's left to send of `msg`
+ */
+static void advance_msg(struct msghdr *msg, size_t len) {
+  while (msg->msg_iovlen > 0 && len >= msg->msg_iov->iov_len) {
+    len -= msg->msg_iov->iov_len;
+    msg->msg_iov++;
+    msg->msg_iovlen--;
+  }
+
+  if (len > 0) {
+    msg->msg_iov->iov_base = (char *)msg->msg_iov->iov_base + len;
+    msg->msg_iov->iov_len -= len;
+  }
+}
+
+void serialized_response_advance(serialized_response *out, size_t len) {
+  advance_msg(&out->msg, len);
+}
+
+size_t serialized_response_remaining(serialized_response *out) {
+  size_t len = 0;
+  for (size_t i = 0; i < (size_t)out->msg.msg_iovlen; i++) {
+    len += out->msg.msg_iov[i].iov_len;
+  }
+
+  return len;
+}
+
+serialized_response *response_serialize(request_internal *req,
+                                        response_internal *res) {
+  const char *body = res->body;
+  size_t body_len = body ? strlen(body) : 0;
+
+  header_line extra[EXTRA_HEADERS_MAX];
+  int num_extra = 0;
+  char length[UINT_DIGITS_MAX + 1];
+
   // A server MUST NOT send a Content-Length header field in any response
-  // with a status code of 1xx (Informational) or 204 (No Content).
+  // with a status code of 1xx (Informational) or 204 (No Content). A 304 (Not
+  // Modified) never has a body, so we leave its Content-Length out too, lest it
+  // be taken for the length of the body it stands in for.
   // A server MUST NOT send a Content-Length header field in any 2xx
   // (Successful) response to a METHOD_CONNECT request (Section 4.3.6 of
   // RFC7231).
-  if (should_set_content_len(req, res)) {
-    // Default to text/plain if we've a body and Content-Type not set by user
-    if (body && !has_content_type) {
-      buffer_append(buf, fmt_str("%s: %s", CONTENT_TYPE, YS_MIME_TYPE_TXT));
-      buffer_append(buf, CRLF);
+  bool has_length = should_set_content_len(req, res);
+  if (has_length) {
+    // Default to text/plain if we've a body and Content-Type not set by user.
+    // A file's contents may be anything, so don't presume they're text
+    if ((body || res->body_fd != -1) && !has_header(res, CONTENT_TYPE)) {
+      extra[num_extra++] = (header_line){
+          CONTENT_TYPE,
+          res->body_fd != -1 ? YS_MIME_TYPE_BIN : YS_MIME_TYPE_TXT};
     }
 
-    buffer_append(buf, fmt_str("Content-Length: %d", body ? strlen(body) : 0));
-    buffer_append(buf, CRLF);
+    format_uint(length, res->body_fd != -1 ? (unsigned long long)res->body_len
+                                           : body_len);
+    extra[num_extra++] = (header_line){CONTENT_LENGTH, length};
+  }
 
-    buffer_append(buf, CRLF);
+  // A response to HEAD carries the headers of the response to GET, the
+  // Content-Length included, but never its body
+  if (!has_length || (req && req->method == YS_METHOD_HEAD)) {
+    body_len = 0;
 
-    if (body) {
-      buffer_append(buf, body);
+    // Nor may such a response carry the file body it was given
+    if (res->body_fd != -1) {
+      close(res->body_fd);
+      res->body_fd = -1;
+      res->body_len = 0;
     }
-  } else {
-    buffer_append(buf, CRLF);
   }
 
-  return buf;
+  serialized_response *out = serialize_head(res, extra, num_extra);
+
+  // The body is sent from where it lies rather than copied in after the
+  // headers
+  const char *line =
+      status_line(res->status, out->status_line, sizeof(out->status_line));
+  push_iov(out, line, strlen(line));
+  push_iov(out, out->head, out->head_len);
+  push_iov(out, body, body_len);
+
+  return out;
 }
 
-void response_send(client_context *ctx, buffer_t *buf) {
-  ssize_t total_sent = 0;
+/**
+ * write_all writes `len` bytes of `data` to the connection, waiting for the
+ * socket to drain as needed. Returns false on error
+ */
+static bool write_all(client_context *ctx, const char *data, size_t len) {
+  size_t total_sent = 0;
 
-  while (total_sent < buffer_size(buf)) {
+  while (total_sent < len) {
     ssize_t sent;
 
-    if (ctx->ssl) {
-      sent = SSL_write(ctx->ssl, buffer_state(buf) + total_sent,
-                       buffer_size(buf) - total_sent);
+    // Once the kernel encrypts the connection's records, write the plaintext
+    // to the socket and bypass OpenSSL's record layer altogether
+    if (ctx->ssl && !ctx->ktls_send) {
+      sent = SSL_write(ctx->ssl, data + total_sent, len - total_sent);
+
+      if (sent <= 0) {
+        int err = SSL_get_error(ctx->ssl, sent);
+        if ((err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) &&
+            await_writable(ctx->sockfd)) {
+          continue;
+        }
+
+        sent = -1;
+        errno = EPIPE;
+      }
     } else {
-      sent = write(ctx->sockfd, buffer_state(buf) + total_sent,
-                   buffer_size(buf) - total_sent);
+      sent = write(ctx->sockfd, data + total_sent, len - total_sent);
     }
 
     if (sent == -1) {
-      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
-        // Try again later
+      if (errno == EINTR) {
         continue;
       }
 
-      printlogf(YS_LOG_INFO,
-                "[response::%s] failed to send response on sockfd %d", __func__,
-                ctx->sockfd);
-      printlogf(YS_LOG_DEBUG, "[response::%s] full response body: %s\n",
-                __func__, buffer_state(buf));
-      goto done;
+      if ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+          await_writable(ctx->sockfd)) {
+        // Try again now that the socket has drained
+        continue;
+      }
 
-    } else {
-      total_sent += sent;
+      return false;
     }
+
+    total_sent += sent;
   }
 
-  goto done;
+  return true;
+}
+
+/**
+ * send_msg_all writes what's left to send of `msg` to the connection with as
+ * few calls as it takes, advancing `msg` past what was written. OpenSSL can't
+ * gather writes, so small messages are coalesced into a single TLS record
+ * instead. Returns false on error
+ */
+static bool send_msg_all(client_context *ctx, struct msghdr *msg, int flags) {
+  if (ctx->ssl && !ctx->ktls_send) {
+    char record[TLS_FILE_CHUNK_SIZE];
+    size_t len = 0;
+
+    for (size_t i = 0; i < (size_t)msg->msg_iovlen; i++) {
+      struct iovec *iov = &msg->msg_iov[i];
+
+      if (iov->iov_len <= sizeof(record) - len) {
+        memcpy(record + len, iov->iov_base, iov->iov_len);
+        len += iov->iov_len;
+        continue;
+      }
 
-done:
-  buffer_free(buf);
+      if (!write_all(ctx, record, len) ||
+          !write_all(ctx, iov->iov_base, iov->iov_len)) {
+        return false;
+      }
+      len = 0;
+    }
 
-  if (ctx->ssl) {
-    SSL_shutdown(ctx->ssl);
-    SSL_free(ctx->ssl);
+    msg->msg_iovlen = 0;
+    return write_all(ctx, record, len);
   }
 
-  close(ctx->sockfd);
+  while (msg->msg_iovlen > 0) {
+    ssize_t sent = sendmsg(ctx->sockfd, msg, flags);
 
-  return;
+    if (sent == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+          await_writable(ctx->sockfd)) {
+        continue;
+      }
+
+      return false;
+    }
+
+    advance_msg(msg, sent);
+  }
+
+  return true;
 }
 
-void response_send_error(client_context *ctx, parse_error err) {
-  response_internal *res = response_init();
+/**
+ * send_file_body writes the connection's pending file body. The kernel copies
+ * the file to the socket itself unless OpenSSL has to encrypt it, in which
+ * case it is read and written a TLS record's worth at a time. Returns false on
+ * error
+ */
+static bool send_file_body(client_context *ctx) {
+  if (ctx->ssl && !ctx->ktls_send) {
+    char chunk[TLS_FILE_CHUNK_SIZE];
 
-  switch (err) {
-    case IO_ERR:
-    case PARSE_ERR:
-      res->status = YS_STATUS_INTERNAL_SERVER_ERROR;
-      break;
+    while (ctx->out_fd_remaining > 0) {
+      size_t len = ctx->out_fd_remaining < (off_t)sizeof(chunk)
+                       ? (size_t)ctx->out_fd_remaining
+                       : sizeof(chunk);
+
+      ssize_t n = pread(ctx->out_fd, chunk, len, ctx->out_fd_offset);
+      if (n == -1 && errno == EINTR) {
+        continue;
+      }
+
+      // The file was truncated after the response headers were sent
+      if (n <= 0) {
+        return false;
+      }
+
+      ctx->out_fd_offset += n;
+      ctx->out_fd_remaining -= n;
+
+      if (!write_all(ctx, chunk, n)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  while (ctx->out_fd_remaining > 0) {
+    if (response_sendfile(ctx) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+          await_writable(ctx->sockfd)) {
+        continue;
+      }
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+ssize_t response_sendfile(client_context *ctx) {
+  size_t count = ctx->out_fd_remaining < SENDFILE_CHUNK_SIZE
+                     ? (size_t)ctx->out_fd_remaining
+                     : SENDFILE_CHUNK_SIZE;
+
+#if defined(__linux__)
+  ssize_t sent = sendfile(ctx->sockfd, ctx->out_fd, &ctx->out_fd_offset, count);
+  if (sent > 0) {
+    ctx->out_fd_remaining -= sent;
+  }
+#elif defined(__APPLE__)
+  off_t len = count;
+  // A partial send may fail with EAGAIN yet still report the bytes it sent
+  ssize_t sent =
+      sendfile(ctx->out_fd, ctx->sockfd, ctx->out_fd_offset, &len, NULL, 0);
+  if (len > 0) {
+    ctx->out_fd_offset += len;
+    ctx->out_fd_remaining -= len;
+    sent = len;
+  }
+#else
+  char chunk[TLS_FILE_CHUNK_SIZE];
+  ssize_t sent = pread(ctx->out_fd, chunk,
+                       count < sizeof(chunk) ? count : sizeof(chunk),
+                       ctx->out_fd_offset);
+  if (sent > 0 && (sent = write(ctx->sockfd, chunk, sent)) > 0) {
+    ctx->out_fd_offset += sent;
+    ctx->out_fd_remaining -= sent;
+  }
+#endif
+
+  if (sent == 0) {
+    // The file was truncated after the response headers were sent
+    errno = EIO;
+    return -1;
+  }
+
+  return sent;
+}
+
+void response_close_file(client_context *ctx) {
+  if (ctx->out_fd != -1) {
+    close(ctx->out_fd);
+    ctx->out_fd = -1;
+    ctx->out_fd_remaining = 0;
+  }
+}
+
+void response_set_connection(client_context *ctx, request_internal *req,
+                             response_internal *res) {
+  // Whatever of a streamed body the handler left unread is still on the wire,
+  // where it can't be told apart from the next request
+  if (req->body_remaining > 0) {
+    ctx->keep_alive = false;
+  }
+
+  // Handlers may explicitly ask for the connection to be closed
+  if (header_has_token(res->headers, CONNECTION, "close")) {
+    ctx->keep_alive = false;
+  } else if (!ctx->keep_alive) {
+    insert_header(res->headers, CONNECTION, "close", false);
+  } else if (header_has_token(req->headers, CONNECTION, "keep-alive")) {
+    // HTTP/1.0 clients need to be told the connection will persist
+    insert_header(res->headers, CONNECTION, "keep-alive", false);
+  }
+}
+
+void response_send(client_context *ctx, serialized_response *out) {
+  ctx->state = CONN_WRITING;
+
+  if (ctx->defer_send) {
+    // The reactor sends the response itself once the connection is returned
+    ctx->out = out;
+    return;
+  }
+
+  // The headers are held back until the file body after them, if any, fills
+  // out the packet
+  int flags = ctx->out_fd != -1 ? SEND_MORE : 0;
+
+  if (!send_msg_all(ctx, &out->msg, flags) ||
+      (ctx->out_fd != -1 && !send_file_body(ctx))) {
+    printlogf(YS_LOG_INFO,
+              "[response::%s] failed to send response on sockfd %d\n",
+              __func__, ctx->sockfd);
+    ctx->keep_alive = false;
+    printlogf(YS_LOG_DEBUG, "[response::%s] full response headers: %s\n",
+              __func__, out->head);
+  }
+
+  serialized_response_free(out);
+  response_close_file(ctx);
+
+  if (!ctx->keep_alive) {
+    ctx->state = CONN_CLOSED;
+  }
+}
+
+/**
+ * tls_write_some writes up to `len` bytes of `data` with OpenSSL, without
+ * waiting for the socket to drain. Returns the number of bytes written, or -1
+ * with errno set to EAGAIN if the same bytes must be written again once the
+ * socket is ready
+ */
+static ssize_t tls_write_some(client_context *ctx, const void *data,
+                              size_t len) {
+  int sent = SSL_write(ctx->ssl, data, len < INT_MAX ? (int)len : INT_MAX);
+  if (sent > 0) {
+    return sent;
+  }
+
+  int err = SSL_get_error(ctx->ssl, sent);
+  errno = err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ ? EAGAIN
+                                                                     : EPIPE;
+  return -1;
+}
+
+/**
+ * send_msg_some writes as much of `msg` as the socket takes without blocking.
+ * Where OpenSSL has to encrypt them, small iovecs are coalesced into a single
+ * TLS record, which is rebuilt byte for byte should the write be retried.
+ * Returns the number of bytes written, or -1 with errno set
+ */
+static ssize_t send_msg_some(client_context *ctx, struct msghdr *msg,
+                             int flags) {
+  if (!ctx->ssl || ctx->ktls_send) {
+    return sendmsg(ctx->sockfd, msg, flags);
+  }
+
+  if (msg->msg_iov->iov_len >= TLS_FILE_CHUNK_SIZE) {
+    return tls_write_some(ctx, msg->msg_iov->iov_base, msg->msg_iov->iov_len);
+  }
+
+  char record[TLS_FILE_CHUNK_SIZE];
+  size_t len = 0;
+
+  for (size_t i = 0; i < (size_t)msg->msg_iovlen && len < sizeof(record);
+       i++) {
+    struct iovec *iov = &msg->msg_iov[i];
+    size_t n = iov->iov_len < sizeof(record) - len ? iov->iov_len
+                                                   : sizeof(record) - len;
+
+    memcpy(record + len, iov->iov_base, n);
+    len += n;
+  }
+
+  return tls_write_some(ctx, record, len);
+}
+
+/**
+ * send_file_some writes the next piece of the connection's file body without
+ * blocking. A piece OpenSSL has to encrypt is read afresh from the same offset
+ * should the write be retried. Returns the number of bytes written, or -1 with
+ * errno set
+ */
+static ssize_t send_file_some(client_context *ctx) {
+  if (!ctx->ssl || ctx->ktls_send) {
+    return response_sendfile(ctx);
+  }
+
+  char chunk[TLS_FILE_CHUNK_SIZE];
+  size_t len = ctx->out_fd_remaining < (off_t)sizeof(chunk)
+                   ? (size_t)ctx->out_fd_remaining
+                   : sizeof(chunk);
+
+  ssize_t n = pread(ctx->out_fd, chunk, len, ctx->out_fd_offset);
+  if (n <= 0) {
+    // The file was truncated after the response headers were sent
+    if (n == 0) {
+      errno = EIO;
+    }
+    return -1;
+  }
+
+  ssize_t sent = tls_write_some(ctx, chunk, n);
+  if (sent > 0) {
+    ctx->out_fd_offset += sent;
+    ctx->out_fd_remaining -= sent;
+  }
+
+  return sent;
+}
+
+flush_status response_flush(client_context *ctx) {
+  serialized_response *out = ctx->out;
+
+  while (out && out->msg.msg_iovlen > 0) {
+    // The headers are held back until the file body after them, if any, fills
+    // out the packet
+    ssize_t sent =
+        send_msg_some(ctx, &out->msg, ctx->out_fd != -1 ? SEND_MORE : 0);
+
+    if (sent == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return errno == EAGAIN || errno == EWOULDBLOCK ? FLUSH_BLOCKED
+                                                     : FLUSH_ERR;
+    }
 
+    advance_msg(&out->msg, sent);
+  }
+
+  if (out) {
+    serialized_response_free(out);
+    ctx->out = NULL;
+  }
+
+  while (ctx->out_fd_remaining > 0) {
+    if (send_file_some(ctx) != -1 || errno == EINTR) {
+      continue;
+    }
+
+    return errno == EAGAIN || errno == EWOULDBLOCK ? FLUSH_BLOCKED : FLUSH_ERR;
+  }
+
+  response_close_file(ctx);
+  return FLUSH_DONE;
+}
+
+void response_send_continue(client_context *ctx) {
+  static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+
+  // Nothing else is being sent at this point, so this may be written directly
+  // even on connections that defer their sends
+  if (!write_all(ctx, CONTINUE, sizeof(CONTINUE) - 1)) {
+    printlogf(YS_LOG_INFO,
+              "[response::%s] failed to send 100 Continue on sockfd %d\n",
+              __func__, ctx->sockfd);
+  }
+}
+
+void response_send_error(client_context *ctx, parse_error err) {
+  switch (err) {
     case DUP_HDR:
-      res->status = YS_STATUS_BAD_REQUEST;
+    case BAD_CHUNK:
+    case BAD_LENGTH:
+    case BAD_ENCODING:
+      response_send_status(ctx, YS_STATUS_BAD_REQUEST);
       break;
 
     case REQ_TOO_LONG:
-      res->status = YS_STATUS_REQUEST_ENTITY_TOO_LARGE;
+      response_send_status(ctx, YS_STATUS_REQUEST_ENTITY_TOO_LARGE);
       break;
 
+    case IO_ERR:
+    case PARSE_ERR:
     default:
-      res->status = YS_STATUS_INTERNAL_SERVER_ERROR;
+      response_send_status(ctx, YS_STATUS_INTERNAL_SERVER_ERROR);
   }
+}
+
+void response_send_status(client_context *ctx, ys_http_status status) {
+  response_internal *res = response_init();
+  res->status = status;
+
+  // We can't know where the erroneous request ends, so we can't reuse the
+  // connection
+  ctx->keep_alive = false;
+  insert_header(res->headers, CONNECTION, "close", false);
 
   response_send(ctx, response_serialize(NULL, res));
 
-  free(ctx);
-  free(res);
+  response_free(res);
 }
 
 void response_send_protocol_error(int sockfd) {
@@ -176,13 +799,13 @@ void response_send_protocol_error(int sockfd) {
   res->status = YS_STATUS_INTERNAL_SERVER_ERROR;
   res->body = "invalid protocol";
 
-  buffer_t *resbuf = response_serialize(NULL, res);
+  serialized_response *out = response_serialize(NULL, res);
 
-  write(sockfd, buffer_state(resbuf), buffer_size(resbuf));
+  writev(sockfd, out->msg.msg_iov, out->msg.msg_iovlen);
   close(sockfd);
 
-  free(res);
-  free(resbuf);
+  response_free(res);
+  serialized_response_free(out);
 }
 
 response_internal *response_init(void) {
@@ -190,6 +813,10 @@ response_internal *response_init(void) {
 
   res->headers = ht_init(0);
   res->body = NULL;
+  res->body_fd = -1;
+  res->body_len = 0;
+  res->req = NULL;
+  res->stream = NULL;
   res->status = YS_STATUS_OK;  // Default
   res->done = false;
 
@@ -198,6 +825,11 @@ response_internal *response_init(void) {
   return res;
 }
 
+void response_free(response_internal *res) {
+  headers_free(res->headers);
+  free(res);
+}
+
 void ys_set_body(ys_response *res, const char *fmt, ...) {
   if (!fmt) {
     return;
@@ -216,7 +848,323 @@ void ys_set_body(ys_response *res, const char *fmt, ...) {
   va_end(args);
   va_end(args_cp);
 
-  ((response_internal *)res)->body = buf;
+  response_internal *res_internal = (response_internal *)res;
+  response_clear_body(res_internal);
+  res_internal->body = buf;
+}
+
+bool ys_set_body_file(ys_response *res, const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    printlogf(YS_LOG_INFO, "[response::%s] unable to open file %s\n",
+              __func__, path);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    printlogf(YS_LOG_INFO, "[response::%s] %s is not a regular file\n",
+              __func__, path);
+    close(fd);
+    return false;
+  }
+
+  response_internal *res_internal = (response_internal *)res;
+  response_clear_body(res_internal);
+  res_internal->body_fd = fd;
+  res_internal->body_len = st.st_size;
+
+  return true;
+}
+
+void response_clear_body(response_internal *res) {
+  free(res->body);
+  res->body = NULL;
+
+  if (res->body_fd != -1) {
+    close(res->body_fd);
+    res->body_fd = -1;
+    res->body_len = 0;
+  }
+}
+
+/**
+ * accepts_chunked tests whether the client understands chunked bodies, which
+ * HTTP/1.0 clients don't
+ */
+static bool accepts_chunked(request_internal *req) {
+  return req->minor_version != 0;
+}
+
+/**
+ * stream_send_msg writes `msg` to the streamed response's connection. Once a
+ * write has failed, the connection is no longer kept alive and every later
+ * write fails too
+ */
+static bool stream_send_msg(response_internal *res, struct msghdr *msg) {
+  if (res->stream->failed) {
+    return false;
+  }
+
+  client_context *ctx = res->req->conn;
+  if (!send_msg_all(ctx, msg, 0)) {
+    printlogf(YS_LOG_INFO,
+              "[response::%s] failed to send streamed response on sockfd %d\n",
+              __func__, ctx->sockfd);
+
+    res->stream->failed = true;
+    ctx->keep_alive = false;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * stream_write writes `len` bytes of `data` to the streamed response's
+ * connection
+ */
+static bool stream_write(response_internal *res, const char *data,
+                         size_t len) {
+  struct iovec iov = {.iov_base = (void *)data, .iov_len = len};
+  struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+
+  return stream_send_msg(res, &msg);
+}
+
+/**
+ * chunk_head writes the framing that precedes a chunk of `len` bytes, along
+ * with the CRLF owed to the chunk before it, into the STREAM_FRAMING_SIZE bytes
+ * before `data`. Returns where the framing starts
+ */
+static char *chunk_head(response_stream *stream, char *data, size_t len) {
+  char framing[STREAM_FRAMING_SIZE + 1];
+  int n = snprintf(framing, sizeof(framing), "%s%zx%s",
+                   stream->crlf_owed ? CRLF : "", len, CRLF);
+
+  // The chunk's own CRLF goes out with whatever is sent next, so that it never
+  // needs a write of its own
+  stream->crlf_owed = true;
+
+  memcpy(data - n, framing, n);
+  return data - n;
+}
+
+/**
+ * stream_send sends the bytes gathered on the streamed response, as a chunk if
+ * the body is chunked, followed by the last chunk if `last` is set
+ */
+static bool stream_send(response_internal *res, bool last) {
+  response_stream *stream = res->stream;
+  char *data = stream->buf + STREAM_FRAMING_SIZE;
+  char *start = data;
+  size_t len = stream->len;
+
+  stream->len = 0;
+
+  if (stream->chunked) {
+    // An empty chunk would end the body
+    if (len > 0) {
+      start = chunk_head(stream, data, len);
+    }
+
+    if (last) {
+      if (stream->crlf_owed) {
+        memcpy(data + len, CRLF, 2);
+        len += 2;
+      }
+
+      memcpy(data + len, LAST_CHUNK, sizeof(LAST_CHUNK) - 1);
+      len += sizeof(LAST_CHUNK) - 1;
+      stream->crlf_owed = false;
+    }
+
+    len += data - start;
+  }
+
+  return len == 0 || stream_write(res, start, len);
+}
+
+bool ys_response_begin(ys_response *res, ssize_t len) {
+  response_internal *ri = (response_internal *)res;
+  if (ri->stream) {
+    return !ri->stream->failed;
+  }
+
+  request_internal *req = ri->req;
+  client_context *ctx = req->conn;
+
+  response_stream *stream = xmalloc(sizeof(response_stream));
+  stream->buf =
+      xmalloc(STREAM_FRAMING_SIZE + STREAM_BUFFER_SIZE + STREAM_TRAILER_SIZE);
+  stream->len = 0;
+  stream->chunked = false;
+  stream->crlf_owed = false;
+  stream->remaining = len;
+  stream->ended = false;
+  stream->failed = false;
+  stream->discard = false;
+  ri->stream = stream;
+
+  // The streamed body takes the place of any other
+  response_clear_body(ri);
+
+  bool has_body = should_set_content_len(req, ri);
+  if (!has_body) {
+    stream->remaining = 0;
+  } else if (req->method == YS_METHOD_HEAD) {
+    // A response to HEAD carries the headers of the response to GET, but never
+    // its body, lest the client take it for the start of the next response
+    stream->remaining = 0;
+    stream->discard = true;
+  } else if (len < 0 && accepts_chunked(req)) {
+    stream->chunked = true;
+  } else if (len < 0) {
+    // Without chunking, the body can only end with the connection
+    ctx->keep_alive = false;
+  }
+
+  response_set_connection(ctx, req, ri);
+
+  header_line extra[EXTRA_HEADERS_MAX];
+  int num_extra = 0;
+  char length[UINT_DIGITS_MAX + 1];
+
+  if (has_body) {
+    if (!has_header(ri, CONTENT_TYPE)) {
+      extra[num_extra++] = (header_line){CONTENT_TYPE, YS_MIME_TYPE_TXT};
+    }
+
+    if (stream->chunked) {
+      extra[num_extra++] = (header_line){TRANSFER_ENCODING, "chunked"};
+    } else if (len >= 0) {
+      format_uint(length, len);
+      extra[num_extra++] = (header_line){CONTENT_LENGTH, length};
+    }
+  }
+
+  serialized_response *out = serialize_head(ri, extra, num_extra);
+  const char *line =
+      status_line(ri->status, out->status_line, sizeof(out->status_line));
+  push_iov(out, line, strlen(line));
+  push_iov(out, out->head, out->head_len);
+
+  bool sent = stream_send_msg(ri, &out->msg);
+  serialized_response_free(out);
+
+  return sent;
+}
+
+bool ys_response_write(ys_response *res, const void *data, size_t len) {
+  if (!ys_response_begin(res, -1)) {
+    return false;
+  }
+
+  response_internal *ri = (response_internal *)res;
+  response_stream *stream = ri->stream;
+
+  if (stream->ended) {
+    printlogf(YS_LOG_INFO, "[response::%s] write after the body ended\n",
+              __func__);
+    return false;
+  }
+
+  if (stream->discard) {
+    return true;
+  }
+
+  if (stream->remaining >= 0) {
+    if ((off_t)len > stream->remaining) {
+      printlogf(YS_LOG_INFO,
+                "[response::%s] write of %zu bytes exceeds the body's "
+                "length\n",
+                __func__, len);
+      return false;
+    }
+
+    stream->remaining -= len;
+  }
+
+  // Small writes are gathered into chunks of a worthwhile size
+  if (len <= STREAM_BUFFER_SIZE - stream->len) {
+    memcpy(stream->buf + STREAM_FRAMING_SIZE + stream->len, data, len);
+    stream->len += len;
+    return true;
+  }
+
+  if (!stream_send(ri, false)) {
+    return false;
+  }
+
+  if (len < STREAM_BUFFER_SIZE) {
+    memcpy(stream->buf + STREAM_FRAMING_SIZE, data, len);
+    stream->len = len;
+    return true;
+  }
+
+  // Larger ones are sent as they are, along with their framing
+  char framing[STREAM_FRAMING_SIZE];
+  char *end = framing + sizeof(framing);
+  char *start = stream->chunked ? chunk_head(stream, end, len) : end;
+
+  struct iovec iov[2] = {{.iov_base = start, .iov_len = end - start},
+                         {.iov_base = (void *)data, .iov_len = len}};
+  struct msghdr msg = {.msg_iov = iov, .msg_iovlen = 2};
+  if (start == end) {
+    msg.msg_iov++;
+    msg.msg_iovlen--;
+  }
+
+  return stream_send_msg(ri, &msg);
+}
+
+bool ys_response_flush(ys_response *res) {
+  if (!ys_response_begin(res, -1)) {
+    return false;
+  }
+
+  response_internal *ri = (response_internal *)res;
+  return !ri->stream->ended && stream_send(ri, false);
+}
+
+bool ys_response_end(ys_response *res) {
+  if (!ys_response_begin(res, -1)) {
+    return false;
+  }
+
+  response_internal *ri = (response_internal *)res;
+  response_stream *stream = ri->stream;
+
+  if (stream->ended) {
+    return !stream->failed;
+  }
+
+  stream->ended = true;
+  bool sent = stream_send(ri, true);
+
+  // The client would wait forever on the rest of a body cut short of its
+  // Content-Length, so closing the connection is all that's left
+  if (stream->remaining > 0) {
+    printlogf(YS_LOG_INFO,
+              "[response::%s] body ended %lld bytes short of its length\n",
+              __func__, (long long)stream->remaining);
+    ri->req->conn->keep_alive = false;
+    return false;
+  }
+
+  return sent;
+}
+
+void response_stream_finish(response_internal *res) {
+  if (!res->stream) {
+    return;
+  }
+
+  ys_response_end((ys_response *)res);
+
+  free(res->stream->buf);
+  free(res->stream);
+  res->stream = NULL;
 }
 
 void ys_set_status(ys_response *res, ys_http_status status) {
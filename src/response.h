@@ -1,11 +1,61 @@
 #ifndef RESPONSE_H
 #define RESPONSE_H
 
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
 #include "libutil/libutil.h"
 #include "libys.h"
 #include "request.h"
 
+// How long to wait for a slow client's socket to become writable again
+#define SEND_TIMEOUT_MS 10000
+
+/**
+ * flush_status is the outcome of response_flush
+ */
+typedef enum {
+  // The response has been sent in full
+  FLUSH_DONE,
+  // The socket filled up before all of the response could be sent
+  FLUSH_BLOCKED,
+  // The response could not be sent
+  FLUSH_ERR
+} flush_status;
+
+/**
+ * The state of a response whose body the handler streams with
+ * ys_response_write, once its head has been sent
+ */
 typedef struct {
+  /**
+   * The bytes written by the handler but not yet sent, after room for the
+   * framing of the chunk they'll be sent as
+   */
+  char *buf;
+  size_t len;
+
+  // Whether the body is sent with Transfer-Encoding: chunked
+  bool chunked;
+
+  // Whether the CRLF that ends the last chunk sent is owed to the next send
+  bool crlf_owed;
+
+  // The bytes of the body yet to be sent per the Content-Length, or -1 if the
+  // body's length isn't known up front
+  off_t remaining;
+
+  // Whether the body has been ended, and whether sending any of it failed
+  bool ended;
+  bool failed;
+
+  // Whether what the handler writes is dropped rather than sent, as it is in
+  // response to HEAD
+  bool discard;
+} response_stream;
+
+typedef struct response_internal {
   /**
    * A flag used by middleware - setting this to true will stop the middleware
    * chain and prevent subsequent middlewares from being run
@@ -26,28 +76,158 @@ typedef struct {
    * response body - optional; Content-length header will be set for you
    */
   char *body;
+
+  /**
+   * A file whose contents make up the response body in place of `body`, and
+   * its length; -1 if the body isn't a file
+   */
+  int body_fd;
+  off_t body_len;
+
+  /**
+   * The request the response answers, whose connection a streamed body is
+   * written to, and the streamed body's state; NULL until ys_response_begin
+   */
+  request_internal *req;
+  response_stream *stream;
 } response_internal;
 
+// The pieces a serialized response is sent in: its status line, its headers
+// and its body
+#define RESPONSE_IOV_MAX 3
+
+/**
+ * serialized_response is a response ready to be sent, as the pieces that are
+ * gathered into a single writev(2): the status line, from a table built once;
+ * the headers; and the body, which is sent from where the handler left it
+ * rather than copied in after the headers. `msg` holds whatever has yet to be
+ * sent
+ */
+typedef struct serialized_response {
+  struct iovec iov[RESPONSE_IOV_MAX];
+  struct msghdr msg;
+
+  // The body, if the serialized response owns it
+  char *body;
+
+  // The status line of a status without one of its own in the table
+  char status_line[32];
+
+  // The headers, written in one go into exactly the room they take,
+  // NUL-terminated
+  size_t head_len;
+  char head[];
+} serialized_response;
+
 /**
  * response_init initializes a new response object
  */
 response_internal *response_init(void);
 
 /**
- * response_serialize converts a user-defined response object into a buffer that
- * can be sent over the wire
+ * response_free deallocates the response and its header table. The body, and
+ * the keys and values of the headers, are left to whoever set them
+ */
+void response_free(response_internal *res);
+
+/**
+ * response_serialize converts a user-defined response object into the pieces
+ * that are sent over the wire. The body is referenced rather than copied, and
+ * must outlive the serialized response unless ownership of it is handed over
+ * via `body`
+ */
+serialized_response *response_serialize(request_internal *req,
+                                        response_internal *res);
+
+/**
+ * serialized_response_init allocates a serialized response with nothing to
+ * send, and room for `head_size` bytes of headers
+ */
+serialized_response *serialized_response_init(size_t head_size);
+
+/**
+ * serialized_response_free deallocates the serialized response along with the
+ * body it owns, if any
+ */
+void serialized_response_free(serialized_response *out);
+
+/**
+ * serialized_response_advance drops the first `len` bytes of what has yet to
+ * be sent of the serialized response, once they have been sent
+ */
+void serialized_response_advance(serialized_response *out, size_t len);
+
+/**
+ * serialized_response_remaining returns how many bytes of the serialized
+ * response have yet to be sent
+ */
+size_t serialized_response_remaining(serialized_response *out);
+
+/**
+ * response_set_connection settles whether the connection outlives the response
+ * and advertises as much in its Connection header
+ */
+void response_set_connection(client_context *ctx, request_internal *req,
+                             response_internal *res);
+
+/**
+ * response_stream_finish ends the response's streamed body, if the handler
+ * didn't, and frees its state
+ */
+void response_stream_finish(response_internal *res);
+
+/**
+ * response_send writes the given response to the given socket with as few
+ * calls as it takes, followed by the connection's pending file body, if any,
+ * and frees it. The connection is left open; if it should not be kept alive,
+ * its state is set to CONN_CLOSED for the owner to tear it down. If the
+ * connection defers sends, the response is instead stashed on the connection
+ * for the reactor to send
+ */
+void response_send(client_context *ctx, serialized_response *out);
+
+/**
+ * response_flush writes as much of the response stashed on a connection that
+ * defers its sends, and of its file body, as the socket takes without blocking.
+ * Whatever was written is dropped from the connection, so that a blocked flush
+ * may be resumed once the socket is writable again
  */
-buffer_t *response_serialize(request_internal *req, response_internal *res);
+flush_status response_flush(client_context *ctx);
 
 /**
- * response_send writes the given response to the given socket
+ * response_sendfile writes as much of the connection's pending file body as the
+ * socket takes without blocking, up to a fixed chunk size, and advances past
+ * what was written. Returns the number of bytes written, or -1 with errno set
  */
-void response_send(client_context *ctx, buffer_t *buf);
+ssize_t response_sendfile(client_context *ctx);
 
 /**
- * response_send_error pre-empts response_send with an error response
+ * response_close_file closes the connection's pending file body, if any
+ */
+void response_close_file(client_context *ctx);
+
+/**
+ * response_clear_body discards the response's body, whether a string or a file
+ */
+void response_clear_body(response_internal *res);
+
+/**
+ * response_send_continue tells a client that sent `Expect: 100-continue` to go
+ * ahead and send the request body
+ */
+void response_send_continue(client_context *ctx);
+
+/**
+ * response_send_error pre-empts response_send with an error response. The
+ * connection will always be marked for closing
  */
 void response_send_error(client_context *ctx, parse_error err);
 
+/**
+ * response_send_status pre-empts the router with an empty response of the given
+ * status. The connection will always be marked for closing
+ */
+void response_send_status(client_context *ctx, ys_http_status status);
+
 void response_send_protocol_error(int sockfd);
 #endif /* RESPONSE_H */
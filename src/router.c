@@ -4,14 +4,20 @@
 #include <stdarg.h>
 #include <string.h>
 
+#include "arena.h"
+#include "compute.h"
 #include "config.h"
+#include "header.h"
 #include "libutil/libutil.h"
 #include "logger.h"
 #include "middleware.h"
 #include "path.h"
+#include "reactor.h"
 #include "regexpr.h"
 #include "response.h"
+#include "static.h"
 #include "trie.h"
+#include "url.h"
 #include "xmalloc.h"
 
 #define CR(op) (response_internal *)op
@@ -43,9 +49,9 @@ static bool invoke_chain(request_internal *req, response_internal *res,
 
     if (has_elements(mh->ignore_paths)) {
       foreach (mh->ignore_paths, j) {
-        pcre *re = array_get(mh->ignore_paths, j);
+        regex *re = array_get(mh->ignore_paths, j);
 
-        if (regex_match(re, req->pure_path)) {
+        if (regex_match(re, req->pure_path.ptr, req->pure_path.len)) {
           goto continue_outer;
         }
       }
@@ -69,8 +75,8 @@ static bool invoke_chain(request_internal *req, response_internal *res,
 static ys_response *default_internal_error_handler(ys_request *req,
                                                    ys_response *res) {
   printlogf(YS_LOG_INFO,
-            "[router::%s] 500 handler in effect at request path %s\n", __func__,
-            ys_req_get_path(req));
+            "[router::%s] 500 handler in effect at request path %.*s\n",
+            __func__, VIEW_ARGS(((request_internal *)req)->path));
 
   ys_set_status(res, YS_STATUS_INTERNAL_SERVER_ERROR);
 
@@ -84,8 +90,8 @@ static ys_response *default_not_found_handler(ys_request *req,
                                               ys_response *res) {
   printlogf(YS_LOG_INFO,
             "[router::%s] default 404 handler in effect "
-            "at request path %s\n",
-            __func__, ys_req_get_path(req));
+            "at request path %.*s\n",
+            __func__, VIEW_ARGS(((request_internal *)req)->path));
 
   ys_set_status(res, YS_STATUS_NOT_FOUND);
 
@@ -99,53 +105,105 @@ static ys_response *default_method_not_allowed_handler(ys_request *req,
                                                        ys_response *res) {
   printlogf(YS_LOG_INFO,
             "[router::%s] default 405 handler in "
-            "effect at request path %s\n",
-            __func__, ys_req_get_path(req));
+            "effect at request path %.*s\n",
+            __func__, VIEW_ARGS(((request_internal *)req)->path));
 
   ys_set_status(res, YS_STATUS_YS_METHOD_NOT_ALLOWED);
 
   return res;
 }
 
+/**
+ * router_serve_static serves a request that matched no route from the first of
+ * the router's mounted directories to hold the requested file. Returns false
+ * if none does
+ */
+static bool router_serve_static(router_internal *router, request_internal *req,
+                                response_internal *res) {
+  if (!has_elements(router->static_mounts)) {
+    return false;
+  }
+
+  foreach (router->static_mounts, i) {
+    if (static_serve(array_get(router->static_mounts, i), req, res)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * match_sub_router finds the sub-router of `router` that `path` is nested
+ * under, per its first segment as path_split_first_delim splits it, and narrows
+ * `path` to the rest. Only the prefix is copied, into the arena, to look it up.
+ * Returns NULL, leaving `path` as it was, if there is no such sub-router
+ */
+static router_internal *match_sub_router(router_internal *router, arena *a,
+                                         str_view *path) {
+  if (!router->sub_routers || !router->sub_routers->count || path->len <= 1) {
+    return NULL;
+  }
+
+  const char *p = path->ptr;
+  size_t len = path->len;
+  const char *slash = memchr(p, '/', len);
+  const char *next = memchr(p + 1, '/', len - 1);
+  char *prefix;
+  str_view suffix = {PATH_DELIMITER, 1};
+
+  if (!slash || slash == p + len - 1) {
+    // No slash at all, or only a trailing one
+    prefix = arena_alloc(a, len + 1);
+    prefix[0] = '/';
+    memcpy(prefix + 1, p, slash ? len - 1 : len);
+    prefix[slash ? len : len + 1] = '\0';
+  } else {
+    prefix = arena_strndup(a, p, next ? (size_t)(next - p) : len);
+    if (next) {
+      suffix = (str_view){next, len - (next - p)};
+    }
+  }
+
+  router_internal *sub_router =
+      (router_internal *)ht_get(router->sub_routers, prefix);
+  if (sub_router) {
+    *path = suffix;
+  }
+
+  return sub_router;
+}
+
 /**
  * router_run_sub runs a sub-router against nested paths and returns a boolean
  * indicating whether sub-route was matched and the router was run. If a
  * sub-route was not matched, we should continue to running the router on the
- * full path
+ * full path. Otherwise, `sent` receives the result of running the sub-router
  */
 static bool router_run_sub(router_internal *router, client_context *ctx,
-                           request_internal *req) {
-  if (router->sub_routers && router->sub_routers->count) {
-    array_t *paths = path_split_first_delim(req->route_path);
-    char *prefix = array_get(paths, 0);
-    char *suffix = array_get(paths, 1);
-
-    if (prefix) {
-      router_internal *sub_router =
-          (router_internal *)ht_get(router->sub_routers, prefix);
-      if (sub_router) {
-        char *sub_path = suffix ? suffix : "/";
-        strcpy(req->route_path, sub_path);
-        printlogf(YS_LOG_DEBUG,
-                  "matched sub-router at path %s and sub-path %s\n", prefix,
-                  req->route_path);
-
-        router_run(sub_router, ctx, req);
-
-        array_free(paths);
-        return true;
-      }
-    }
-
-    array_free(paths);
+                           request_internal *req, bool *sent) {
+  str_view route_path = req->route_path;
+  router_internal *sub_router =
+      match_sub_router(router, ctx->arena, &route_path);
+  if (!sub_router) {
+    return false;
   }
 
-  return false;
+  printlogf(YS_LOG_DEBUG, "matched sub-router at sub-path %.*s\n",
+            VIEW_ARGS(route_path));
+
+  req->route_path = route_path;
+  *sent = router_run(sub_router, ctx, req);
+
+  return true;
 }
 
 ys_router_attr *ys_router_attr_init(void) {
   router_attr_internal *attr = xmalloc(sizeof(router_attr_internal));
   attr->use_cors = false;
+  attr->not_found_handler = NULL;
+  attr->internal_error_handler = NULL;
+  attr->method_not_allowed_handler = NULL;
   attr->middlewares = NULL;
 
   return (ys_router_attr *)attr;
@@ -163,6 +221,7 @@ ys_router *ys_router_init(ys_router_attr *attr) {
   router->middlewares = attr_internal->middlewares;
   router->use_cors = attr_internal->use_cors;
   router->sub_routers = NULL;
+  router->static_mounts = NULL;
 
   if (!attr_internal->not_found_handler) {
     printlogf(YS_LOG_DEBUG,
@@ -216,45 +275,131 @@ ys_router *ys_router_init(ys_router_attr *attr) {
 
 bool has(void *s, void *cmp) { return s_equals((char *)s, (char *)cmp); }
 
-void __router_register(ys_router *router, const char *path,
-                       ys_route_handler *handler, ys_http_method method, ...) {
-  array_t *methods = array_init();
-  if (!methods) {
-    DIE("[router::%s] failed to allocate methods array via array_init\n",
+/**
+ * register_route registers a route record for `handler` at `path` under each
+ * method in the 0-terminated list starting at `method` and continuing in
+ * `args`
+ */
+static void register_route(ys_router *router, const char *path,
+                           ys_route_handler *handler, unsigned int flags,
+                           size_t max_body_size, ys_http_method method,
+                           va_list args) {
+  unsigned int methods = 0;
+  while (method != 0) {
+    methods |= METHOD_BIT(method);
+    method = va_arg(args, ys_http_method);
+  }
+
+  if (!router || !path || !handler) {
+    DIE("[router::%s] invariant violation - router_register arguments cannot "
+        "be NULL\n",
         __func__);
   }
 
+  trie_insert(((router_internal *)router)->trie, methods, path,
+              (generic_handler *)handler, flags, max_body_size);
+}
+
+void __router_register(ys_router *router, const char *path,
+                       ys_route_handler *handler, ys_http_method method, ...) {
   va_list args;
   va_start(args, method);
 
-  while (method != 0) {
-    if (!array_push(methods, s_copy(ys_http_method_names[method]))) {
-      free(methods);
-      DIE("[router::%s] failed to insert into methods array\n", __func__);
-    }
+  register_route(router, path, handler, 0, 0, method, args);
 
-    method = va_arg(args, ys_http_method);
-  }
+  va_end(args);
+}
+
+void __router_register_with_flags(ys_router *router, const char *path,
+                                  ys_route_handler *handler,
+                                  unsigned int flags, ys_http_method method,
+                                  ...) {
+  va_list args;
+  va_start(args, method);
+
+  register_route(router, path, handler, flags, 0, method, args);
 
   va_end(args);
+}
 
-  if (!router || !methods || !path || !handler) {
+void __router_register_with_opts(ys_router *router, const char *path,
+                                 ys_route_handler *handler,
+                                 const ys_route_opts *opts,
+                                 ys_http_method method, ...) {
+  if (!opts) {
     DIE("[router::%s] invariant violation - router_register arguments cannot "
         "be NULL\n",
         __func__);
   }
 
-  trie_insert(((router_internal *)router)->trie, methods, path,
-              (generic_handler *)handler);
+  va_list args;
+  va_start(args, method);
+
+  register_route(router, path, handler, opts->flags, opts->max_body_size,
+                 method, args);
+
+  va_end(args);
 }
 
-void router_run(router_internal *router, client_context *ctx,
-                request_internal *req) {
-  if (router_run_sub(router, ctx, req)) {
+void router_compile(router_internal *router) {
+  trie_compile(router->trie);
+
+  if (!router->sub_routers) {
     return;
   }
 
+  // We must iterate the capacity here because hash table records are not
+  // stored contiguously
+  for (int i = 0; i < router->sub_routers->capacity; i++) {
+    ht_record *record = router->sub_routers->records[i];
+    if (record) {
+      router_compile(record->value);
+    }
+  }
+}
+
+route_action *router_find_action(router_internal *router,
+                                 request_internal *req) {
+  arena *a = req->conn->arena;
+  str_view path = req->route_path;
+
+  // Descend into sub-routers as router_run_sub does, but on a copy of the view
+  router_internal *sub_router;
+  while ((sub_router = match_sub_router(router, a, &path))) {
+    router = sub_router;
+  }
+
+  route_result *result = arena_alloc(a, sizeof(route_result));
+  if (!trie_search(router->trie, req->method, path.ptr, path.len, result)) {
+    return NULL;
+  }
+
+  req->route = result;
+  return result->action;
+}
+
+size_t router_body_limit(route_action *action) {
+  if (action && action->max_body_size > 0) {
+    return action->max_body_size;
+  }
+
+  if (action && (action->flags & YS_ROUTE_STREAM_BODY)) {
+    return 0;
+  }
+
+  return server_conf.max_body_size;
+}
+
+bool router_run(router_internal *router, client_context *ctx,
+                request_internal *req) {
+  bool sent;
+  if (router_run_sub(router, ctx, req, &sent)) {
+    return sent;
+  }
+
   response_internal *res = response_init();
+  res->req = req;
+
   array_t *mws = router->middlewares;
   if (has_elements(mws)) {
     res->done = invoke_chain(req, res, mws);
@@ -264,45 +409,121 @@ void router_run(router_internal *router, client_context *ctx,
     goto done;
   }
 
-  route_result *result =
-      trie_search(router->trie, req->method, req->route_path);
+  // A request whose body was awaited has had its route looked up already
+  route_result search;
+  route_result *route = req->route;
+  if (!route && trie_search(router->trie, req->method, req->route_path.ptr,
+                            req->route_path.len, &search)) {
+    route = &search;
+  }
 
-  if (!result) {
+  if (!route) {
     res = CR(router->internal_error_handler(CRR(req, res)));
     if (!res->status) {  // TODO: t
       res->status = YS_STATUS_INTERNAL_SERVER_ERROR;
     }
-  } else if ((result->flags & NOT_FOUND_MASK) == NOT_FOUND_MASK) {
-    res = CR(router->not_found_handler(CRR(req, res)));
-    if (!res->status) {
-      res->status = YS_STATUS_NOT_FOUND;
+  } else if ((route->flags & NOT_FOUND_MASK) == NOT_FOUND_MASK) {
+    // Registered routes take precedence over files of the same path
+    if (res->done || !router_serve_static(router, req, res)) {
+      res = CR(router->not_found_handler(CRR(req, res)));
+      if (!res->status) {
+        res->status = YS_STATUS_NOT_FOUND;
+      }
+    }
+  } else if ((route->flags & NOT_ALLOWED_MASK) == NOT_ALLOWED_MASK) {
+    if (route->allow) {
+      insert_header(res->headers, "Allow", route->allow, false);
     }
-  } else if ((result->flags & NOT_ALLOWED_MASK) == NOT_ALLOWED_MASK) {
+
     res = CR(router->method_not_allowed_handler(CRR(req, res)));
     if (!res->status) {
       res->status = YS_STATUS_YS_METHOD_NOT_ALLOWED;
     }
   } else {
-    req->parameters = result->parameters;
-    req->queries = result->queries;
+    memcpy(req->params, route->params,
+           route->num_params * sizeof(route_param));
+    req->num_params = route->num_params;
+
+    // The query string is parsed only for requests that reach a handler. The
+    // request frees the table once its response has been sent
+    if (req->pure_path.len < req->path.len) {
+      const char *query = req->pure_path.ptr + req->pure_path.len + 1;
+      size_t query_len = req->path.len - req->pure_path.len - 1;
+      req->queries = parse_query(arena_strndup(ctx->arena, query, query_len));
+    }
+
+    ys_route_handler *h = (ys_route_handler *)route->action->handler;
+    size_t max_body_size = router_body_limit(route->action);
+
+    // Bodies too large for the read buffer are refused before they're read;
+    // this catches the rest
+    if (!res->done && max_body_size > 0 && req->content_len > max_body_size) {
+      res->status = YS_STATUS_REQUEST_ENTITY_TOO_LARGE;
+      res->done = true;
+    }
 
-    ys_route_handler *h = (ys_route_handler *)result->action->handler;
+    // A reactor that runs handlers on its own thread mustn't wait on a slow
+    // uploader, so handlers that read their body from the client are run on
+    // the compute pool there too
+    bool offload = (route->action->flags & YS_ROUTE_COMPUTE) ||
+                   ((route->action->flags & YS_ROUTE_STREAM_BODY) &&
+                    ctx->reactor && !ctx->reactor->queue);
+
+    if (!res->done && offload) {
+      // The compute pool runs the handler and sends the response from here on
+      compute_dispatch(ctx, req, res, h);
+      return false;
+    }
 
     if (!res->done) {
       res = CR(h(CRR(req, res)));
     }
   }
 
-  free(result);
   goto done;
 
 done:
-  response_send(ctx, response_serialize(req, res));
+  router_send_response(ctx, req, res);
+  return true;
+}
+
+void router_send_response(client_context *ctx, request_internal *req,
+                          response_internal *res) {
+  // A streamed response's head and body were sent by the handler as it went;
+  // only the end of the body may be left to send
+  if (res->stream) {
+    response_stream_finish(res);
+
+    if (req->body_remaining > 0) {
+      ctx->keep_alive = false;
+    }
+
+    response_send(ctx, serialized_response_init(0));
+
+    request_free(req);
+    response_free(res);
+    return;
+  }
+
+  response_set_connection(ctx, req, res);
+
+  serialized_response *out = response_serialize(req, res);
 
-  // TODO: free ht
-  free(req);
-  free(res);
-  free(ctx);
+  // The body is sent from where the handler left it, which may be after the
+  // response itself is gone
+  out->body = res->body;
+  res->body = NULL;
+
+  // The connection sends the file body, if any, once the headers are out
+  ctx->out_fd = res->body_fd;
+  ctx->out_fd_offset = 0;
+  ctx->out_fd_remaining = res->body_len;
+  res->body_fd = -1;
+
+  response_send(ctx, out);
+
+  request_free(req);
+  response_free(res);
 }
 
 ys_router *ys_router_register_sub(ys_router *parent_router,
@@ -319,6 +540,31 @@ ys_router *ys_router_register_sub(ys_router *parent_router,
   return (ys_router *)sub_router;
 }
 
+void ys_router_serve_dir(ys_router *router, const char *prefix,
+                         const char *dir) {
+  router_internal *r = (router_internal *)router;
+
+  if (!router || !prefix || !dir) {
+    DIE("[router::%s] invariant violation - ys_router_serve_dir arguments "
+        "cannot be NULL\n",
+        __func__);
+  }
+
+  static_mount *mount = static_mount_init(prefix, dir);
+  if (!mount) {
+    DIE("[router::%s] unable to open directory %s. Are you sure the path is "
+        "correct?\n",
+        __func__, dir);
+  }
+
+  if (!r->static_mounts && !(r->static_mounts = array_init())) {
+    DIE("[router::%s] failed to allocate static mounts array via array_init\n",
+        __func__);
+  }
+
+  array_push(r->static_mounts, mount);
+}
+
 void ys_router_register_404_handler(ys_router_attr *attr, ys_route_handler *h) {
   ((router_attr_internal *)attr)->not_found_handler = h;
 }
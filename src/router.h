@@ -7,13 +7,15 @@
 #include "libutil/libutil.h"
 #include "libys.h"
 #include "request.h"
+#include "response.h"
 #include "trie.h"
 
 /**
  * A route record
  */
 typedef struct {
-  array_t *methods;
+  // A set of METHOD_BITs
+  unsigned int methods;
   char *path;
   void *(*handler)(void *, void *);
 } route_record;
@@ -40,13 +42,51 @@ typedef struct {
   array_t *middlewares;
   // <char*, router_internal*>
   hash_table *sub_routers;
+  // static_mount*[], tried in order when no route matches
+  array_t *static_mounts;
 } router_internal;
 
 /**
- * router_run matches an inbound HTTP request against a route and executes the
- * appropriate handler
+ * router_run matches an inbound HTTP request against a route, executes the
+ * appropriate handler and sends the response. The connection itself is left to
+ * the caller, which either closes it or waits for the next request.
+ *
+ * Returns false if the route was registered with YS_ROUTE_COMPUTE, in which
+ * case the request has been handed off to the compute pool and the connection
+ * will be returned to its reactor once the response is ready; the caller must
+ * not touch it again.
  */
-void router_run(router_internal *router, client_context *ctx,
+bool router_run(router_internal *router, client_context *ctx,
                 request_internal *req);
 
+/**
+ * router_compile compiles the route tries of a router and its sub-routers,
+ * which must be done once all routes have been registered and before any
+ * request is matched against them
+ */
+void router_compile(router_internal *router);
+
+/**
+ * router_find_action returns the action of the route a request would be
+ * dispatched to, descending into sub-routers as router_run does, or NULL if it
+ * matches no route. The route found is kept on the request, for router_run to
+ * use rather than search for it again
+ */
+route_action *router_find_action(router_internal *router,
+                                 request_internal *req);
+
+/**
+ * router_body_limit returns the largest request body the route of `action`
+ * accepts, or 0 if it accepts bodies of any size. A NULL `action` gets the
+ * server's default
+ */
+size_t router_body_limit(route_action *action);
+
+/**
+ * router_send_response finalizes the connection headers of a handled request's
+ * response, sends it, and deallocates both
+ */
+void router_send_response(client_context *ctx, request_internal *req,
+                          response_internal *res);
+
 #endif /* ROUTER_H */
@@ -1,27 +1,26 @@
+#define _GNU_SOURCE
+
 #include "server.h"
 
 #include <openssl/err.h>
 #include <openssl/ssl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
+#include <unistd.h>
 
-#include "client.h"
 #include "config.h"
 #include "lib.thread/libthread.h"
 #include "libys.h"
 #include "logger.h"
-#include "request.h"
-#include "response.h"
+#include "reactor.h"
 #include "router.h"
 #include "sighandler.h"
+#include "tls.h"
 #include "util.h"
 #include "xmalloc.h"
 
-typedef struct {
-  router_internal *r;
-  client_context *c;
-} thread_context;
-
 static SSL_CTX *create_context(void) {
   const SSL_METHOD *method = TLS_server_method();
   SSL_CTX *ctx = SSL_CTX_new(method);
@@ -31,6 +30,10 @@ static SSL_CTX *create_context(void) {
     DIE("[server::%s] failed to create SSL context\n", __func__);
   }
 
+  // A write that would block is retried once the socket drains, from a buffer
+  // rebuilt at whatever address the retry happens to use
+  SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
   return ctx;
 }
 
@@ -48,129 +51,163 @@ static void configure_context(SSL_CTX *ctx, const char *certfile,
   }
 }
 
+static work_queue_t *setup_work_queue(void) {
+  // The queue's positions are cache line-aligned
+  work_queue_t *queue = aligned_alloc(64, sizeof(work_queue_t));
+
+  if (!queue ||
+      !work_queue_init(queue, server_conf.queue_size, server_conf.threads)) {
+    DIE("[server::%s] failed to initialize work queue\n", __func__);
+  }
+
+  return queue;
+}
+
 /**
- * client_thread_handler handles client connections and executes the
- * user-defined router
+ * create_listener creates a non-blocking socket listening on `port`. If
+ * `reuseport` is true, the socket is created with SO_REUSEPORT so that several
+ * listeners may bind the same port and have the kernel balance connections
+ * across them
  */
-static void *client_thread_handler(void *arg) {
-  thread_context *ctx = arg;
+static int create_listener(int port, bool reuseport) {
+  int server_sockfd;
+  if ((server_sockfd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) == 0) {
+    perror("socket");
+    DIE("[server::%s] failed to initialize server socket on port %d\n",
+        __func__, port);
+  }
 
-  maybe_request maybe_req = req_read_and_parse(ctx->c);
+  {
+    int yes = 1;
+    // avoid the "Address already in use" error message
+    if (setsockopt(server_sockfd, SOL_SOCKET, SO_REUSEADDR, &yes,
+                   sizeof(yes)) == -1) {
+      perror("setsockopt");
+      DIE("[server::%s] failed to set sock opt\n", __func__);
+    }
 
-  // TODO: test + fix
-  if (maybe_req.err.code == IO_ERR || maybe_req.err.code == PARSE_ERR ||
-      maybe_req.err.code == REQ_TOO_LONG || maybe_req.err.code == DUP_HDR) {
-    printlogf(YS_LOG_INFO,
-              "[server::%s] error parsing client request with error code %d. "
-              "Pre-empting response with internal error handler\n",
-              __func__, maybe_req.err.code);
+    if (reuseport && setsockopt(server_sockfd, SOL_SOCKET, SO_REUSEPORT, &yes,
+                                sizeof(yes)) == -1) {
+      perror("setsockopt");
+      DIE("[server::%s] failed to set SO_REUSEPORT\n", __func__);
+    }
+  }
+
+  struct sockaddr_in address;
+  socklen_t addr_len = sizeof(address);
 
-    response_send_error(ctx->c, maybe_req.err.code);
+  memset((char *)&address, NULL_TERMINATOR, addr_len);
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons(port);
+
+  if (bind(server_sockfd, (struct sockaddr *)&address, addr_len) < 0) {
+    perror("bind");
+    DIE("[server::%s] failed to bind server socket on %s:%d\n", __func__,
+        address.sin_addr, port);
+  }
 
-    free(ctx);
-    return NULL;
+  if (listen(server_sockfd, MAX_QUEUED_CONNECTIONS) < 0) {
+    perror("listen");
+    DIE("[server::%s] failed to listen on %s:%d\n", __func__, address.sin_addr,
+        port);
   }
 
-  request_internal *req = maybe_req.req;
+  if (!set_nonblocking(server_sockfd, true)) {
+    DIE("[server::%s] failed to make server socket non-blocking\n", __func__);
+  }
 
-  printlogf(YS_LOG_INFO, "[server::%s] client request received: %s %s\n",
-            __func__, req->method, req->path);
+  return server_sockfd;
+}
 
-  router_run(ctx->r, ctx->c, req);
+typedef struct {
+  server_internal *server;
+  int cpu;
+} reactor_thread_context;
 
-  free(ctx);
-  return NULL;
+/**
+ * pin_to_cpu binds the calling thread to the given CPU. Memory the thread
+ * touches first is then allocated on that CPU's NUMA node
+ */
+static void pin_to_cpu(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (err != 0) {
+    printlogf(YS_LOG_INFO,
+              "[server::%s] failed to pin reactor to CPU %d (%d)\n", __func__,
+              cpu, err);
+  }
+#else
+  printlogf(YS_LOG_INFO,
+            "[server::%s] CPU affinity is not supported on this platform\n",
+            __func__);
+#endif
 }
 
-static void poll_client_connections(thread_pool_t *pool,
-                                    server_internal *server, int server_sockfd,
-                                    int port, struct sockaddr_in address,
-                                    ssize_t addr_len) {
-  fd_set readfds;
-  int client_sockfd;
-
-  while (true) {
-    FD_ZERO(&readfds);
-    FD_SET(server_sockfd, &readfds);
-
-    if (select(server_sockfd + 1, &readfds, NULL, NULL, NULL) == -1) {
-      perror("select");
-      printlogf(YS_LOG_DEBUG, "[server::%s] select failed; retrying...\n",
-                __func__);
-    }
+/**
+ * reactor_thread_handler runs one shared-nothing reactor with its own listening
+ * socket and poller. Every request it accepts is handled on this thread.
+ */
+static void *reactor_thread_handler(void *arg) {
+  reactor_thread_context *ctx = arg;
 
-    if (FD_ISSET(server_sockfd, &readfds)) {
-      if ((client_sockfd = accept(server_sockfd, (struct sockaddr *)&address,
-                                  (socklen_t *)&addr_len)) < 0) {
-        perror("accept");
-        printlogf(YS_LOG_INFO,
-                  "[server::%s] failed to accept client socket on %s:%d\n",
-                  __func__, address.sin_addr, port);
-
-        continue;
-      }
-
-      SSL *ssl = NULL;
-      if (server->sslctx) {
-        ssl = SSL_new(server->sslctx);
-        SSL_set_fd(ssl, client_sockfd);
-
-        if (SSL_accept(ssl) <= 0) {
-          ERR_print_errors_fp(stderr);
-          printlogf(YS_LOG_INFO,
-                    "[server::%s] failed to accept SSL connection\n", __func__);
-
-          response_send_protocol_error(client_sockfd);
-          SSL_free(ssl);
-          continue;
-        }
-      }
-
-      printlogf(YS_LOG_DEBUG,
-                "[server::%s] accepted connection from new client; spawning "
-                "handler thread...\n",
-                __func__);
-
-      client_context *ctx = xmalloc(sizeof(client_context));
-      ctx->sockfd = client_sockfd;
-      ctx->ssl = ssl;
-
-      thread_context *tc = xmalloc(sizeof(thread_context));
-      tc->c = ctx;
-      tc->r = server->router;
-
-      if (!thread_pool_dispatch(pool, client_thread_handler, tc, true)) {
-        DIE("[server::%s] failed to dispatch thread from pool\n", __func__);
-      }
-    }
+  // Pin before allocating anything so that the reactor's memory is CPU-local
+  if (server_conf.cpu_affinity) {
+    pin_to_cpu(ctx->cpu);
   }
+
+  int listen_fd = create_listener(ctx->server->port, true);
+  reactor_run(reactor_init(ctx->server, listen_fd, NULL));
+
+  return NULL;
 }
 
-static thread_pool_t *setup_thread_pool(void) {
-  thread_pool_t *pool = calloc(1, sizeof(thread_pool_t));
-  if (!pool) {
-    DIE("[server::%s] failed to initialized thread pool\n", __func__);
+/**
+ * start_reactors runs `server_conf.reactors` reactors, one per thread. The
+ * calling thread runs the last of them, so this function does not return.
+ */
+static void start_reactors(server_internal *s) {
+  long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_cpus < 1) {
+    num_cpus = 1;
   }
 
-  const unsigned int num_threads = server_conf.threads;
-  thread_pool_init(pool);
+  int num_reactors =
+      server_conf.reactors == REACTORS_AUTO ? num_cpus : server_conf.reactors;
+
+  printlogf(YS_LOG_INFO, "[server::%s] Starting %d reactors on port %d...\n",
+            __func__, num_reactors, s->port);
 
-  for (unsigned int i = 0; i < num_threads; i++) {
-    thread_t *client_thread = thread_init(0, "client thread");
+  reactor_thread_context *ctx;
+  for (int i = 0; i < num_reactors - 1; i++) {
+    ctx = xmalloc(sizeof(reactor_thread_context));
+    ctx->server = s;
+    ctx->cpu = i % num_cpus;
 
-    // Make this a detached thread
-    // TODO: change threads API to use detached method for clarity
-    thread_set_attr(client_thread, false);
-    thread_pool_insert(pool, client_thread);
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, reactor_thread_handler, ctx) != 0) {
+      DIE("[server::%s] failed to create reactor thread\n", __func__);
+    }
+
+    pthread_detach(tid);
   }
 
-  return pool;
+  ctx = xmalloc(sizeof(reactor_thread_context));
+  ctx->server = s;
+  ctx->cpu = (num_reactors - 1) % num_cpus;
+
+  reactor_thread_handler(ctx);
 }
 
 ys_server_attr *ys_server_attr_init(ys_router *router) {
   server_attr_internal *attr = xmalloc(sizeof(server_attr_internal));
   attr->router = (router_internal *)router;
   attr->use_https = false;
+  attr->io_engine = YS_IO_ENGINE_POLL;
   attr->port = 0;
   attr->cert_path = NULL;
   attr->key_path = NULL;
@@ -203,6 +240,10 @@ void ys_server_use_https(ys_server_attr *attr, char *cert_path,
   }
 }
 
+void ys_server_set_io_engine(ys_server_attr *attr, ys_io_engine engine) {
+  ((server_attr_internal *)attr)->io_engine = engine;
+}
+
 void ys_server_disable_https(ys_server_attr *attr) {
   ((server_attr_internal *)attr)->use_https = false;
 }
@@ -222,6 +263,7 @@ ys_server *ys_server_init(ys_server_attr *attr) {
   server_internal *server = xmalloc(sizeof(server_internal));
   server->router = (router_internal *)a->router;
   server->port = a->port ? a->port : server_conf.port;
+  server->io_engine = a->io_engine;
 
   if (a->use_https) {
     printlogf(YS_LOG_INFO, "HTTPs enabled - initializing SSL context\n");
@@ -233,6 +275,8 @@ ys_server *ys_server_init(ys_server_attr *attr) {
     server->sslctx = NULL;
   }
 
+  server->tls = NULL;
+
   return (ys_server *)server;
 }
 
@@ -243,55 +287,42 @@ void ys_server_start(ys_server *server) {
     printlogf(YS_LOG_INFO, "Loading TLS cert %s and key %s\n", s->cert_path,
               s->key_path);
     configure_context(s->sslctx, s->cert_path, s->key_path);
+    s->tls = tls_setup_resumption(s->sslctx);
+    tls_setup_ktls(s->sslctx);
   }
 
+  // Routes can no longer change, so their tries are frozen for searching
+  router_compile(s->router);
+
   setup_sigint_handler();
   setup_sigsegv_handler();
+  setup_sigpipe_handler();
 
-  thread_pool_t *pool = setup_thread_pool();
-  int port = s->port;
-
-  int server_sockfd;
-  if ((server_sockfd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) == 0) {
-    perror("socket");
-    DIE("[server::%s] failed to initialize server socket on port %d\n",
-        __func__, port);
+  if (server_conf.reactors) {
+    start_reactors(s);
   }
 
-  {
-    int yes = 1;
-    // avoid the "Address already in use" error message
-    if (setsockopt(server_sockfd, SOL_SOCKET, SO_REUSEADDR, &yes,
-                   sizeof(yes)) == -1) {
-      perror("setsockopt");
-      DIE("[server::%s] failed to set sock opt\n", __func__);
-    }
-  }
+  work_queue_t *queue = setup_work_queue();
+  int server_sockfd = create_listener(s->port, false);
 
-  struct sockaddr_in address;
-  socklen_t addr_len = sizeof(address);
+  printlogf(YS_LOG_INFO, "[server::%s] Listening on port %d...\n", __func__,
+            s->port);
 
-  memset((char *)&address, NULL_TERMINATOR, addr_len);
-  address.sin_family = AF_INET;
-  address.sin_addr.s_addr = INADDR_ANY;
-  address.sin_port = htons(port);
+  reactor_run(reactor_init(s, server_sockfd, queue));
+}
 
-  if (bind(server_sockfd, (struct sockaddr *)&address, addr_len) < 0) {
-    perror("bind");
-    DIE("[server::%s] failed to bind server socket on %s:%d\n", __func__,
-        address.sin_addr, port);
-  }
+ys_tls_stats ys_server_get_tls_stats(ys_server *server) {
+  tls_session_state *tls = ((server_internal *)server)->tls;
+  ys_tls_stats stats = {0};
 
-  if (listen(server_sockfd, MAX_QUEUED_CONNECTIONS) < 0) {
-    perror("listen");
-    DIE("[server::%s] failed to listen on %s:%d\n", __func__, address.sin_addr,
-        port);
+  if (tls) {
+    stats.resumption_hits = atomic_load(&tls->resumption_hits);
+    stats.resumption_misses = atomic_load(&tls->resumption_misses);
+    stats.ticket_key_rotations = atomic_load(&tls->ticket_key_rotations);
+    stats.ktls_connections = atomic_load(&tls->ktls_connections);
   }
 
-  printlogf(YS_LOG_INFO, "[server::%s] Listening on port %d...\n", __func__,
-            port);
-
-  poll_client_connections(pool, s, server_sockfd, port, address, addr_len);
+  return stats;
 }
 
 void ys_server_free(ys_server *server) {
@@ -4,11 +4,14 @@
 #include <openssl/ssl.h>
 #include <stdbool.h>
 
+#include "libys.h"
 #include "router.h"
+#include "tls.h"
 
 typedef struct {
   int port;
   bool use_https;
+  ys_io_engine io_engine;
   router_internal *router;
   char *cert_path;
   char *key_path;
@@ -19,11 +22,15 @@ typedef struct {
  */
 typedef struct {
   int port;
+  ys_io_engine io_engine;
   router_internal *router;
 
   char *cert_path;
   char *key_path;
   SSL_CTX *sslctx;
+
+  // Session ticket keys and resumption counters; NULL unless HTTPs is enabled
+  tls_session_state *tls;
 } server_internal;
 
 #endif /* SERVER_H */
@@ -14,3 +14,5 @@ static void segfault_handler(int s) {
   DIE("Caught SIGSEGV (%d) signal, shutting down...\n", s);
 }
 void setup_sigsegv_handler(void) { signal(SIGSEGV, segfault_handler); }
+
+void setup_sigpipe_handler(void) { signal(SIGPIPE, SIG_IGN); }
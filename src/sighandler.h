@@ -11,4 +11,10 @@ void setup_sigint_handler(void);
  */
 void setup_sigsegv_handler(void);
 
+/**
+ * Ignores SIGPIPE so writes to a client that has gone away fail with EPIPE
+ * instead of terminating the server
+ */
+void setup_sigpipe_handler(void);
+
 #endif /* SIGNAL_H */
@@ -0,0 +1,289 @@
+#define _GNU_SOURCE  // for strptime, timegm
+
+#include "static.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "config.h"
+#include "header.h"
+#include "libutil/libutil.h"
+#include "logger.h"
+#include "xmalloc.h"
+
+static const char INDEX_FILE[] = "index.html";
+
+static const char HTTP_DATE_FMT[] = "%a, %d %b %Y %H:%M:%S GMT";
+
+/**
+ * request_header returns the first value of the request header `key`, matched
+ * case-insensitively, or NULL if the request has no such header
+ */
+static const char *request_header(request_internal *req, const char *key) {
+  for (int i = 0; i < req->headers->capacity; i++) {
+    ht_record *header = req->headers->records[i];
+
+    if (header && s_casecmp(header->key, key) && has_elements(header->value)) {
+      return array_get(header->value, 0);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * accepts_gzip tests whether the client's Accept-Encoding admits gzip, either
+ * by name or by a wildcard, with a non-zero quality
+ */
+static bool accepts_gzip(request_internal *req) {
+  double gzip_q = -1;
+  double wildcard_q = -1;
+
+  for (int i = 0; i < req->headers->capacity; i++) {
+    ht_record *header = req->headers->records[i];
+    if (!header || !s_casecmp(header->key, "Accept-Encoding")) continue;
+
+    foreach ((array_t *)header->value, j) {
+      const char *v = array_get(header->value, j);
+
+      while (*v) {
+        while (*v == ' ' || *v == '\t' || *v == ',') v++;
+
+        size_t len = strcspn(v, ",; \t");
+        const char *coding = v;
+        v += len;
+
+        double q = 1;
+        const char *params_end = v + strcspn(v, ",");
+        const char *qparam = strstr(v, "q=");
+        if (qparam && qparam < params_end) {
+          q = strtod(qparam + 2, NULL);
+        }
+        v = params_end;
+
+        if (len == 4 && strncasecmp(coding, "gzip", len) == 0) {
+          gzip_q = q;
+        } else if (len == 1 && *coding == '*') {
+          wildcard_q = q;
+        }
+      }
+    }
+  }
+
+  return gzip_q >= 0 ? gzip_q > 0 : wildcard_q > 0;
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+/**
+ * decode_path percent-decodes the `len` bytes of a request path relative to a
+ * mount, mapping a directory to its index file. Returns NULL if the path is
+ * malformed or would escape the mount's directory: a decoded path may hold no
+ * NUL or backslash, nor start with a slash, as `%2F` would otherwise make it
+ * absolute
+ */
+static char *decode_path(const char *path, size_t len) {
+  char *decoded = xmalloc(len + sizeof(INDEX_FILE));
+  size_t n = 0;
+
+  for (size_t i = 0; i < len; i++) {
+    char c = path[i];
+
+    if (c == '%') {
+      int hi = i + 2 < len ? hex_value(path[i + 1]) : -1;
+      int lo = hi != -1 ? hex_value(path[i + 2]) : -1;
+
+      if (lo == -1) {
+        free(decoded);
+        return NULL;
+      }
+
+      c = (char)(hi << 4 | lo);
+      i += 2;
+    }
+
+    if (c == '\0' || c == '\\' || (n == 0 && c == '/')) {
+      free(decoded);
+      return NULL;
+    }
+
+    decoded[n++] = c;
+  }
+
+  decoded[n] = '\0';
+
+  // Refuse any `..` segment outright, whatever it would resolve to
+  for (char *segment = decoded; segment;) {
+    size_t segment_len = strcspn(segment, "/");
+    if (segment_len == 2 && segment[0] == '.' && segment[1] == '.') {
+      free(decoded);
+      return NULL;
+    }
+
+    segment = segment[segment_len] ? segment + segment_len + 1 : NULL;
+  }
+
+  if (n == 0 || decoded[n - 1] == '/') {
+    memcpy(decoded + n, INDEX_FILE, sizeof(INDEX_FILE));
+  }
+
+  return decoded;
+}
+
+/**
+ * etag_matches tests whether the If-None-Match list `tags` holds `etag`, or
+ * the wildcard. Per RFC 7232, weak and strong tags are compared alike
+ */
+static bool etag_matches(const char *tags, const char *etag) {
+  size_t etag_len = strlen(etag);
+
+  while (*tags) {
+    while (*tags == ' ' || *tags == '\t' || *tags == ',') tags++;
+
+    if (strncmp(tags, "W/", 2) == 0) {
+      tags += 2;
+    }
+
+    size_t len = strcspn(tags, ", \t");
+    if ((len == 1 && *tags == '*') ||
+        (len == etag_len && strncmp(tags, etag, len) == 0)) {
+      return true;
+    }
+
+    tags += len;
+  }
+
+  return false;
+}
+
+/**
+ * is_not_modified tests whether the client's cached copy of the file is
+ * current, per its If-None-Match or, failing that, its If-Modified-Since
+ */
+static bool is_not_modified(request_internal *req, cached_file *file) {
+  const char *tags = request_header(req, "If-None-Match");
+  if (tags) {
+    return etag_matches(tags, file->etag);
+  }
+
+  const char *since = request_header(req, "If-Modified-Since");
+  if (!since) {
+    return false;
+  }
+
+  struct tm tm_since;
+  memset(&tm_since, 0, sizeof(tm_since));
+
+  const char *end = strptime(since, HTTP_DATE_FMT, &tm_since);
+  return end && !*end && file->mtime <= timegm(&tm_since);
+}
+
+static_mount *static_mount_init(const char *prefix, const char *dir) {
+  file_cache *cache = file_cache_init(dir, server_conf.static_cache_size);
+  if (!cache) {
+    return NULL;
+  }
+
+  static_mount *mount = xmalloc(sizeof(static_mount));
+  mount->prefix = s_copy(prefix);
+  mount->prefix_len = strlen(prefix);
+  mount->cache = cache;
+
+  while (mount->prefix_len > 0 &&
+         mount->prefix[mount->prefix_len - 1] == '/') {
+    mount->prefix[--mount->prefix_len] = '\0';
+  }
+
+  return mount;
+}
+
+bool static_serve(static_mount *mount, request_internal *req,
+                  response_internal *res) {
+  const char *path = req->route_path.ptr;
+  size_t path_len = 0;
+  while (path_len < req->route_path.len && path[path_len] != '?' &&
+         path[path_len] != '#') {
+    path_len++;
+  }
+
+  if (path_len < mount->prefix_len ||
+      strncmp(path, mount->prefix, mount->prefix_len) != 0 ||
+      (path_len > mount->prefix_len && path[mount->prefix_len] != '/')) {
+    return false;
+  }
+
+  path += mount->prefix_len;
+  path_len -= mount->prefix_len;
+  while (path_len > 0 && *path == '/') {
+    path++;
+    path_len--;
+  }
+
+  char *file_path = decode_path(path, path_len);
+  if (!file_path) {
+    return false;
+  }
+
+  cached_file file;
+  bool found =
+      file_cache_open(mount->cache, file_path, accepts_gzip(req), &file);
+
+  printlogf(YS_LOG_DEBUG, "[static::%s] %s %s in %s\n", __func__,
+            found ? "serving" : "no such file", file_path,
+            mount->cache->root);
+  free(file_path);
+
+  if (!found) {
+    return false;
+  }
+
+  if (req->method != YS_METHOD_GET && req->method != YS_METHOD_HEAD) {
+    close(file.fd);
+
+    insert_header(res->headers, "Allow", "GET, HEAD", false);
+    res->status = YS_STATUS_YS_METHOD_NOT_ALLOWED;
+
+    return true;
+  }
+
+  // The file's headers outlive the snapshot, so they're copied into the
+  // connection's arena, which holds them until the response has been sent
+  arena *a = req->conn->arena;
+  insert_header(res->headers, CONTENT_TYPE, file.content_type, false);
+  insert_header(res->headers, "ETag",
+                arena_strndup(a, file.etag, strlen(file.etag)), false);
+  insert_header(
+      res->headers, "Last-Modified",
+      arena_strndup(a, file.last_modified, strlen(file.last_modified)), false);
+
+  if (file.has_gzip) {
+    insert_header(res->headers, "Vary", "Accept-Encoding", false);
+  }
+
+  if (file.gzip) {
+    insert_header(res->headers, "Content-Encoding", "gzip", false);
+  }
+
+  if (is_not_modified(req, &file)) {
+    close(file.fd);
+    res->status = YS_STATUS_NOT_MODIFIED;
+
+    return true;
+  }
+
+  response_clear_body(res);
+  res->body_fd = file.fd;
+  res->body_len = file.size;
+  res->status = YS_STATUS_OK;
+
+  return true;
+}
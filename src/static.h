@@ -0,0 +1,38 @@
+#ifndef STATIC_H
+#define STATIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "file_cache.h"
+#include "request.h"
+#include "response.h"
+
+/**
+ * static_mount is a directory whose files are served beneath a route prefix
+ */
+typedef struct {
+  // The route prefix, without a trailing slash; empty for the root
+  char *prefix;
+  size_t prefix_len;
+
+  file_cache *cache;
+} static_mount;
+
+/**
+ * static_mount_init mounts the directory `dir` at the route prefix `prefix`,
+ * caching up to `server_conf.static_cache_size` bytes of its files. Returns
+ * NULL if `dir` can't be opened
+ */
+static_mount *static_mount_init(const char *prefix, const char *dir);
+
+/**
+ * static_serve prepares the response to a request for a file of the mount:
+ * the file itself, a 304 if the client's copy is current, or a 405 if the
+ * method isn't GET. Returns false if the request isn't for one of the mount's
+ * files, in which case the response is left as it was
+ */
+bool static_serve(static_mount *mount, request_internal *req,
+                  response_internal *res);
+
+#endif /* STATIC_H */
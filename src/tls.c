@@ -0,0 +1,313 @@
+#include "tls.h"
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <string.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include "config.h"
+#include "logger.h"
+#include "xmalloc.h"
+
+// Whether OpenSSL can install a connection's keys in the kernel
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define HAVE_KTLS
+#endif
+
+// Distinguishes sessions established by Ys from those of any other SSL_CTX
+static const unsigned char SESSION_ID_CONTEXT[] = "ys";
+
+/**
+ * monotonic_now returns the current monotonic clock time in seconds
+ */
+static time_t monotonic_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+/**
+ * generate_key fills `key` with a random name and secrets
+ */
+static bool generate_key(tls_ticket_key *key) {
+  return RAND_bytes(key->name, sizeof(key->name)) == 1 &&
+         RAND_bytes(key->aes_key, sizeof(key->aes_key)) == 1 &&
+         RAND_bytes(key->hmac_key, sizeof(key->hmac_key)) == 1;
+}
+
+bool tls_ticket_keys_init(tls_ticket_keys *tickets, time_t rotation_interval,
+                          time_t now) {
+  memset(tickets->keys, 0, sizeof(tickets->keys));
+  pthread_rwlock_init(&tickets->lock, NULL);
+
+  tickets->rotation_interval = rotation_interval;
+  tickets->rotated_at = now;
+  tickets->num_keys = 1;
+
+  return generate_key(&tickets->keys[0]);
+}
+
+bool tls_ticket_keys_rotate(tls_ticket_keys *tickets, time_t now) {
+  pthread_rwlock_rdlock(&tickets->lock);
+  bool due = now - tickets->rotated_at >= tickets->rotation_interval;
+  pthread_rwlock_unlock(&tickets->lock);
+
+  if (!due) {
+    return false;
+  }
+
+  tls_ticket_key key;
+  if (!generate_key(&key)) {
+    printlogf(YS_LOG_INFO,
+              "[tls::%s] failed to generate session ticket key; keeping the "
+              "current one\n",
+              __func__);
+    return false;
+  }
+
+  pthread_rwlock_wrlock(&tickets->lock);
+
+  // Another thread may have rotated the keys while we weren't holding the lock
+  bool rotated = now - tickets->rotated_at >= tickets->rotation_interval;
+  if (rotated) {
+    memmove(&tickets->keys[1], &tickets->keys[0],
+            (TLS_TICKET_KEYS - 1) * sizeof(tls_ticket_key));
+    tickets->keys[0] = key;
+    tickets->rotated_at = now;
+
+    if (tickets->num_keys < TLS_TICKET_KEYS) {
+      tickets->num_keys++;
+    }
+  }
+
+  pthread_rwlock_unlock(&tickets->lock);
+
+  OPENSSL_cleanse(&key, sizeof(key));
+  return rotated;
+}
+
+int tls_ticket_keys_find(tls_ticket_keys *tickets, const unsigned char *name,
+                         tls_ticket_key *key) {
+  int index = -1;
+
+  pthread_rwlock_rdlock(&tickets->lock);
+
+  for (unsigned int i = 0; i < tickets->num_keys; i++) {
+    if (memcmp(tickets->keys[i].name, name, TLS_TICKET_KEY_NAME_LEN) == 0) {
+      *key = tickets->keys[i];
+      index = i;
+      break;
+    }
+  }
+
+  pthread_rwlock_unlock(&tickets->lock);
+
+  return index;
+}
+
+/**
+ * current_key copies the key that encrypts new tickets into `key`, rotating
+ * the keys first if they are due
+ */
+static void current_key(tls_session_state *state, tls_ticket_key *key) {
+  if (tls_ticket_keys_rotate(&state->tickets, monotonic_now())) {
+    atomic_fetch_add(&state->ticket_key_rotations, 1);
+    printlogf(YS_LOG_DEBUG, "[tls::%s] rotated session ticket keys\n",
+              __func__);
+  }
+
+  pthread_rwlock_rdlock(&state->tickets.lock);
+  *key = state->tickets.keys[0];
+  pthread_rwlock_unlock(&state->tickets.lock);
+}
+
+/**
+ * init_ticket_cipher readies `cctx` to encrypt (or decrypt) a session ticket
+ * with `key`, generating the IV first when encrypting. Returns false on error
+ */
+static bool init_ticket_cipher(EVP_CIPHER_CTX *cctx, tls_ticket_key *key,
+                               unsigned char *iv, int enc) {
+  if (enc) {
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+      return false;
+    }
+
+    return EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key->aes_key,
+                              iv) == 1;
+  }
+
+  return EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key->aes_key, iv) ==
+         1;
+}
+
+/**
+ * lookup_ticket_key finds the key with which to encrypt a new ticket, or with
+ * which to decrypt the ticket named `key_name`. Returns the value OpenSSL
+ * expects of a ticket key callback when no key is found (0), on success (1),
+ * or when the ticket was encrypted with a retired key and should be renewed
+ * (2)
+ */
+static int lookup_ticket_key(SSL *ssl, unsigned char *key_name,
+                             tls_ticket_key *key, int enc) {
+  tls_session_state *state = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+
+  if (enc) {
+    current_key(state, key);
+    memcpy(key_name, key->name, TLS_TICKET_KEY_NAME_LEN);
+    return 1;
+  }
+
+  int index = tls_ticket_keys_find(&state->tickets, key_name, key);
+  if (index == -1) {
+    // The key has been retired for too long; fall back to a full handshake
+    return 0;
+  }
+
+  return index == 0 ? 1 : 2;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/**
+ * ticket_key_cb encrypts and decrypts session tickets with the rotating
+ * ticket keys
+ */
+static int ticket_key_cb(SSL *ssl, unsigned char key_name[16],
+                         unsigned char iv[EVP_MAX_IV_LENGTH],
+                         EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *hctx, int enc) {
+  tls_ticket_key key;
+  int ret = lookup_ticket_key(ssl, key_name, &key, enc);
+
+  if (ret > 0) {
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key,
+                                          sizeof(key.hmac_key)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA256", 0),
+        OSSL_PARAM_construct_end()};
+
+    if (!init_ticket_cipher(cctx, &key, iv, enc) ||
+        EVP_MAC_CTX_set_params(hctx, params) != 1) {
+      ret = -1;
+    }
+  }
+
+  OPENSSL_cleanse(&key, sizeof(key));
+  return ret;
+}
+#else
+/**
+ * ticket_key_cb encrypts and decrypts session tickets with the rotating
+ * ticket keys
+ */
+static int ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+                         EVP_CIPHER_CTX *cctx, HMAC_CTX *hctx, int enc) {
+  tls_ticket_key key;
+  int ret = lookup_ticket_key(ssl, key_name, &key, enc);
+
+  if (ret > 0 && (!init_ticket_cipher(cctx, &key, iv, enc) ||
+                  HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key),
+                               EVP_sha256(), NULL) != 1)) {
+    ret = -1;
+  }
+
+  OPENSSL_cleanse(&key, sizeof(key));
+  return ret;
+}
+#endif
+
+tls_session_state *tls_setup_resumption(SSL_CTX *ctx) {
+  tls_session_state *state = xmalloc(sizeof(tls_session_state));
+  atomic_init(&state->resumption_hits, 0);
+  atomic_init(&state->resumption_misses, 0);
+  atomic_init(&state->ticket_key_rotations, 0);
+  atomic_init(&state->ktls_connections, 0);
+
+  SSL_CTX_set_app_data(ctx, state);
+  SSL_CTX_set_session_id_context(ctx, SESSION_ID_CONTEXT,
+                                 sizeof(SESSION_ID_CONTEXT) - 1);
+  SSL_CTX_set_timeout(ctx, server_conf.tls_session_timeout);
+
+  if (server_conf.tls_session_cache_size > 0) {
+    // OpenSSL's cache is shared by every connection made from this context
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, server_conf.tls_session_cache_size);
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  }
+
+  if (!server_conf.tls_session_tickets) {
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    return state;
+  }
+
+  if (!tls_ticket_keys_init(&state->tickets,
+                            server_conf.tls_ticket_key_rotation,
+                            monotonic_now())) {
+    ERR_print_errors_fp(stderr);
+    DIE("[tls::%s] failed to generate session ticket key\n", __func__);
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key_cb);
+#else
+  SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key_cb);
+#endif
+
+  return state;
+}
+
+void tls_record_handshake(tls_session_state *state, SSL *ssl) {
+  if (SSL_session_reused(ssl)) {
+    atomic_fetch_add(&state->resumption_hits, 1);
+  } else {
+    atomic_fetch_add(&state->resumption_misses, 1);
+  }
+}
+
+void tls_setup_ktls(SSL_CTX *ctx) {
+  if (!server_conf.tls_ktls) {
+    return;
+  }
+
+#ifdef HAVE_KTLS
+  // OpenSSL quietly keeps handling records itself for any connection whose
+  // keys the kernel won't take, e.g. because the `tls` module isn't loaded
+  SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#else
+  (void)ctx;
+  printlogf(YS_LOG_INFO,
+            "[tls::%s] kTLS requires OpenSSL 3.0 or later, built with kTLS "
+            "support; records will be encrypted by OpenSSL\n",
+            __func__);
+#endif
+}
+
+void tls_detect_ktls(tls_session_state *state, SSL *ssl, bool *send,
+                     bool *recv) {
+  *send = false;
+  *recv = false;
+
+#ifdef HAVE_KTLS
+  if (!server_conf.tls_ktls) {
+    return;
+  }
+
+  *send = BIO_get_ktls_send(SSL_get_wbio(ssl));
+  *recv = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+
+  if (*send || *recv) {
+    atomic_fetch_add(&state->ktls_connections, 1);
+  }
+
+  printlogf(YS_LOG_DEBUG, "[tls::%s] kTLS send: %d, receive: %d\n", __func__,
+            *send, *recv);
+#else
+  (void)state;
+  (void)ssl;
+#endif
+}
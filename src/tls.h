@@ -0,0 +1,115 @@
+#ifndef TLS_H
+#define TLS_H
+
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Length of a session ticket key's name, as fixed by OpenSSL
+#define TLS_TICKET_KEY_NAME_LEN 16
+
+// Length of each of a session ticket key's AES-256 and HMAC-SHA256 secrets
+#define TLS_TICKET_SECRET_LEN 32
+
+// Number of session ticket keys held at once: the current key, which encrypts
+// new tickets, and the key it replaced, which still decrypts older ones
+#define TLS_TICKET_KEYS 2
+
+/**
+ * tls_ticket_key is a key with which session tickets are encrypted and
+ * authenticated. Its name is embedded in each ticket so that the key can be
+ * found again when the ticket is presented
+ */
+typedef struct {
+  unsigned char name[TLS_TICKET_KEY_NAME_LEN];
+  unsigned char aes_key[TLS_TICKET_SECRET_LEN];
+  unsigned char hmac_key[TLS_TICKET_SECRET_LEN];
+} tls_ticket_key;
+
+/**
+ * tls_ticket_keys is a rotating set of session ticket keys, shared by every
+ * thread that performs handshakes
+ */
+typedef struct {
+  pthread_rwlock_t lock;
+
+  // keys[0] is the current key; the rest are retired keys, newest first
+  tls_ticket_key keys[TLS_TICKET_KEYS];
+  unsigned int num_keys;
+
+  // Monotonic time (in seconds) at which the current key was generated
+  time_t rotated_at;
+
+  // The number of seconds after which the current key is replaced
+  time_t rotation_interval;
+} tls_ticket_keys;
+
+/**
+ * tls_session_state holds a server's session ticket keys and its session
+ * resumption counters
+ */
+typedef struct {
+  tls_ticket_keys tickets;
+
+  // Handshakes that resumed a session, either from the cache or a ticket
+  atomic_ulong resumption_hits;
+  // Handshakes that negotiated a new session
+  atomic_ulong resumption_misses;
+  atomic_ulong ticket_key_rotations;
+
+  // Handshakes after which the kernel took over encrypting the connection
+  atomic_ulong ktls_connections;
+} tls_session_state;
+
+/**
+ * tls_setup_resumption configures the session cache and session tickets of
+ * `ctx` per `server_conf`, and allocates the state that backs them
+ */
+tls_session_state *tls_setup_resumption(SSL_CTX *ctx);
+
+/**
+ * tls_record_handshake counts a completed handshake as a resumption hit or miss
+ */
+void tls_record_handshake(tls_session_state *state, SSL *ssl);
+
+/**
+ * tls_setup_ktls asks OpenSSL to install each connection's keys in the kernel
+ * once its handshake is complete, if `server_conf` enables kTLS
+ */
+void tls_setup_ktls(SSL_CTX *ctx);
+
+/**
+ * tls_detect_ktls reports whether the kernel encrypts (`send`) and decrypts
+ * (`recv`) the records of a connection whose handshake is complete. Either is
+ * false when kTLS is disabled, unsupported by OpenSSL or the kernel, or
+ * unavailable for the negotiated cipher, in which case OpenSSL handles records
+ * itself
+ */
+void tls_detect_ktls(tls_session_state *state, SSL *ssl, bool *send,
+                     bool *recv);
+
+/**
+ * tls_ticket_keys_init generates the first key of a set of session ticket keys
+ * that rotates every `rotation_interval` seconds. Returns false if no key
+ * could be generated
+ */
+bool tls_ticket_keys_init(tls_ticket_keys *tickets, time_t rotation_interval,
+                          time_t now);
+
+/**
+ * tls_ticket_keys_rotate replaces the current key with a new one if it is due
+ * as of `now`, retiring it and discarding the oldest retired key. Returns
+ * whether the keys were rotated
+ */
+bool tls_ticket_keys_rotate(tls_ticket_keys *tickets, time_t now);
+
+/**
+ * tls_ticket_keys_find copies the key named `name` into `key`. Returns its
+ * index, where 0 is the current key, or -1 if no such key is held
+ */
+int tls_ticket_keys_find(tls_ticket_keys *tickets, const unsigned char *name,
+                         tls_ticket_key *key);
+
+#endif /* TLS_H */
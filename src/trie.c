@@ -1,13 +1,12 @@
 #include "trie.h"
 
-#include <pcre.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "cache.h"
 #include "libutil/libutil.h"
 #include "logger.h"
+#include "param.h"
 #include "path.h"
-#include "regexpr.h"
-#include "url.h"
 #include "util.h"
 #include "xmalloc.h"
 
@@ -20,26 +19,55 @@ const unsigned int NOT_FOUND_MASK = 0x01;
 // Route not allowed flag
 const unsigned int NOT_ALLOWED_MASK = 0x02;
 
-static route_action *action_init(generic_handler *handler) {
+static route_action *action_init(generic_handler *handler, unsigned int flags,
+                                 size_t max_body_size) {
   route_action *action = xmalloc(sizeof(route_action));
   action->handler = handler;
+  action->flags = flags;
+  action->max_body_size = max_body_size;
 
   return action;
 }
 
-static route_result *result_init(void) {
-  route_result *result = xmalloc(sizeof(route_result));
-  result->parameters = ht_init(0);
-  result->flags = INITIAL_FLAG_STATE;
+/**
+ * node_set_actions stores an action for `handler` under each method in the
+ * set `methods`, replacing any the node already holds, and updates the node's
+ * Allow header value to match
+ */
+static void node_set_actions(trie_node *node, unsigned int methods,
+                             generic_handler *handler, unsigned int flags,
+                             size_t max_body_size) {
+  for (int m = YS_METHOD_GET; m < NUM_METHODS; m++) {
+    if (methods & METHOD_BIT(m)) {
+      free(node->actions[m]);
+      node->actions[m] = action_init(handler, flags, max_body_size);
+    }
+  }
+
+  node->allowed |= methods;
+
+  // Long enough for every method name, each followed by a separator
+  char allow[128] = "";
+  for (int m = YS_METHOD_GET; m < NUM_METHODS; m++) {
+    if (node->allowed & METHOD_BIT(m)) {
+      if (allow[0]) {
+        strcat(allow, ", ");
+      }
+      strcat(allow, ys_http_method_names[m]);
+    }
+  }
 
-  return result;
+  free(node->allow);
+  node->allow = s_copy(allow);
 }
 
 /**
- * node_init allocates memory for a new node, its children and action members
+ * node_init allocates memory for a new node of the trie, its children and
+ * action members
  */
-static trie_node *node_init(void) {
+static trie_node *node_init(route_trie *trie) {
   trie_node *node = xmalloc(sizeof(trie_node));
+  node->index = trie->num_nodes++;
 
   node->children = ht_init(0);
   if (!node->children) {
@@ -47,11 +75,11 @@ static trie_node *node_init(void) {
         __func__);
   }
 
-  node->actions = ht_init(0);
-  if (!node->actions) {
-    DIE("[trie::%s] failed to initialize hash table for node actions\n",
-        __func__);
+  for (int m = 0; m < NUM_METHODS; m++) {
+    node->actions[m] = NULL;
   }
+  node->allowed = 0;
+  node->allow = NULL;
 
   return node;
 }
@@ -59,7 +87,9 @@ static trie_node *node_init(void) {
 route_trie *trie_init(void) {
   route_trie *trie = xmalloc(sizeof(route_trie));
 
-  trie->root = node_init();
+  trie->num_nodes = 0;
+  trie->radix = NULL;
+  trie->root = node_init(trie);
   trie->regex_cache = ht_init(0);
   if (!trie->regex_cache) {
     DIE("[trie::%s] failed to initialize hash table for trie regex cache\n",
@@ -69,19 +99,16 @@ route_trie *trie_init(void) {
   return trie;
 }
 
-void trie_insert(route_trie *trie, array_t *methods, const char *path,
-                 generic_handler *handler) {
+void trie_insert(route_trie *trie, unsigned int methods, const char *path,
+                 generic_handler *handler, unsigned int flags,
+                 size_t max_body_size) {
   char *realpath = s_copy(path);
   trie_node *curr = trie->root;
 
   // Handle root path
   if (s_equals(realpath, PATH_ROOT)) {
     curr->label = realpath;
-
-    foreach (methods, i) {
-      route_action *action = action_init(handler);
-      ht_insert(curr->actions, array_get(methods, i), action);
-    }
+    node_set_actions(curr, methods, handler, flags, max_body_size);
 
     return;
   }
@@ -94,7 +121,7 @@ void trie_insert(route_trie *trie, array_t *methods, const char *path,
     if (next) {
       curr = next->value;
     } else {
-      trie_node *node = node_init();
+      trie_node *node = node_init(trie);
 
       node->label = split_path;
       ht_insert(curr->children, split_path, node);
@@ -104,13 +131,7 @@ void trie_insert(route_trie *trie, array_t *methods, const char *path,
     // Overwrite existing data on last path
     if (i == array_size(paths) - 1) {
       curr->label = split_path;
-
-      foreach (methods, j) {
-        char *method = array_get(methods, j);
-
-        route_action *action = action_init(handler);
-        ht_insert(curr->actions, method, action);
-      }
+      node_set_actions(curr, methods, handler, flags, max_body_size);
 
       break;
     }
@@ -119,131 +140,465 @@ void trie_insert(route_trie *trie, array_t *methods, const char *path,
   array_free(paths);
 }
 
-route_result *trie_search(route_trie *trie, const char *method,
-                          const char *search_path) {
-  // Extract query string, if present
-  char *realpath = s_copy(search_path);
-  route_result *result = result_init();
-  trie_node *curr = trie->root;
+/**
+ * is_param tests whether a node of the trie is a parameter
+ */
+static bool is_param(const trie_node *node) {
+  return node->label[0] == PARAMETER_DELIMITER[0];
+}
 
-  if (has_query_string(search_path)) {
-    array_t *arr = str_cut(realpath, "?");
-    // Remove query from path
-    realpath = array_get(arr, 0);
-    // Grab query and parse it into key/value[] pairs
-    char *query = array_get(arr, 1);
+/**
+ * compare_children orders a node's static children by label, ahead of its
+ * parameters, which keep the order in which they were inserted
+ */
+static int compare_children(const void *a, const void *b) {
+  const trie_node *x = *(trie_node *const *)a;
+  const trie_node *y = *(trie_node *const *)b;
+
+  if (is_param(x) != is_param(y)) {
+    return is_param(x) - is_param(y);
+  }
+
+  if (is_param(x)) {
+    return (x->index > y->index) - (x->index < y->index);
+  }
+
+  return strcmp(x->label, y->label);
+}
 
-    if (query) {
-      result->queries = parse_query(query);
+/**
+ * sorted_children returns the children of `node` in the order of
+ * compare_children. `count` receives how many there are
+ */
+static trie_node **sorted_children(trie_node *node, unsigned int *count) {
+  *count = 0;
+  trie_node **children =
+      xmalloc((node->children->count + 1) * sizeof(trie_node *));
+
+  // We must iterate the capacity here because hash table records are not
+  // stored contiguously
+  for (int i = 0; i < node->children->capacity; i++) {
+    ht_record *record = node->children->records[i];
+    if (record) {
+      children[(*count)++] = record->value;
     }
+  }
 
-    array_free(arr);
+  qsort(children, *count, sizeof(trie_node *), compare_children);
+
+  return children;
+}
+
+/**
+ * only_child returns the single child of `node`, or NULL if it has no child or
+ * more than one
+ */
+static trie_node *only_child(trie_node *node) {
+  if (node->children->count != 1) {
+    return NULL;
   }
 
-  array_t *paths = expand_path(realpath);
-  foreach (paths, i) {
-    char *path = array_get(paths, i);
+  for (int i = 0; i < node->children->capacity; i++) {
+    ht_record *record = node->children->records[i];
+    if (record) {
+      return record->value;
+    }
+  }
 
-    ht_record *next = ht_search(curr->children, path);
-    if (next) {
-      curr = next->value;
+  return NULL;
+}
+
+/**
+ * label_bytes returns the room the labels of `node`'s descendants take in a
+ * label pool, each NUL-terminated, which is enough for their compiled labels
+ */
+static size_t label_bytes(trie_node *node) {
+  size_t bytes = 0;
+
+  for (int i = 0; i < node->children->capacity; i++) {
+    ht_record *record = node->children->records[i];
+    if (record) {
+      trie_node *child = record->value;
+      bytes += strlen(child->label) + 1 + label_bytes(child);
+    }
+  }
+
+  return bytes;
+}
+
+/**
+ * append_label appends the `len` bytes at `s` to the label of `node`, which
+ * ends the tree's label pool, along with a NUL terminator
+ */
+static void append_label(radix_tree *radix, radix_node *node, size_t *pool_len,
+                         const char *s, size_t len) {
+  if (node->label_len + len > UINT16_MAX) {
+    DIE("[trie::%s] route path is too long\n", __func__);
+  }
+
+  memcpy(radix->labels + *pool_len, s, len);
+  *pool_len += len;
+  radix->labels[*pool_len] = NULL_TERMINATOR;
+  node->label_len += len;
+}
+
+/**
+ * radix_free deallocates a compiled trie
+ */
+static void radix_free(radix_tree *radix) {
+  for (uint32_t i = 0; i < radix->num_param_sets; i++) {
+    regex_free(radix->param_sets[i].re);
+    free(radix->param_sets[i].groups);
+  }
+
+  free(radix->nodes);
+  free(radix->labels);
+  free(radix->routes);
+  free(radix->params);
+  free(radix->param_sets);
+  free(radix);
+}
+
+/**
+ * compile_param_set combines the patterns of the parameters of `node`, whose
+ * children are `children`, into a param_set if it has several left to PCRE
+ */
+static void compile_param_set(radix_tree *radix, radix_node *node,
+                              trie_node **children) {
+  char **patterns = xmalloc(node->num_params * sizeof(char *));
+  regex **compiled = xmalloc(node->num_params * sizeof(regex *));
+  unsigned int len = 0;
+  bool combinable = true;
+
+  for (unsigned int j = 0; j < node->num_params; j++) {
+    radix_node *child = &radix->nodes[node->children + node->num_static + j];
+    param_matcher *matcher = &radix->params[child->param];
+
+    if (matcher->kind != PARAM_REGEX) {
       continue;
     }
 
-    if (curr->children->count == 0) {
-      if (!s_equals(curr->label, path)) {
-        // No matching route result found
-        result->flags |= NOT_FOUND_MASK;
-        return result;
-      }
+    // A pattern that didn't compile fails the search when reached
+    if (!matcher->re) {
+      combinable = false;
       break;
     }
 
-    bool is_param_match = false;
-
-    // We must iterate the capacity here because hash table records are not
-    // stored contiguously
-    for (int j = 0; j < curr->children->capacity; j++) {
-      ht_record *child_record = curr->children->records[j];
-      // If there's no record in this slot, continue
-      if (!child_record) {
-        continue;
-      }
+    patterns[len] = derive_label_pattern(children[node->num_static + j]->label);
+    compiled[len++] = matcher->re;
+  }
 
-      trie_node *child = child_record->value;
-      char child_prefix = child->label[0];
+  if (combinable && len > 1 &&
+      param_set_init(&radix->param_sets[radix->num_param_sets], patterns,
+                     compiled, len)) {
+    node->param_set = radix->num_param_sets++;
+  }
 
-      if (child_prefix == PARAMETER_DELIMITER[0]) {
-        char *pattern = derive_label_pattern(child->label);
-        if (!pattern) {
-          result->flags |= NOT_FOUND_MASK;
-          return result;
-        }
+  for (unsigned int i = 0; i < len; i++) {
+    free(patterns[i]);
+  }
+  free(patterns);
+  free(compiled);
+}
 
-        pcre *re = regex_cache_get(trie->regex_cache, pattern);
-        if (!re) {
-          printlogf(YS_LOG_INFO, "[trie::%s] regex was NULL\n", __func__);
+void trie_compile(route_trie *trie) {
+  unsigned int max_nodes = trie->num_nodes;
+
+  radix_tree *radix = xmalloc(sizeof(radix_tree));
+  radix->nodes = xmalloc(max_nodes * sizeof(radix_node));
+  radix->labels = xmalloc(label_bytes(trie->root) + 1);
+  radix->routes = xmalloc(max_nodes * sizeof(radix_route));
+  radix->params = xmalloc(max_nodes * sizeof(param_matcher));
+  radix->param_sets = xmalloc(max_nodes * sizeof(param_set));
+  radix->num_param_sets = 0;
+
+  // The node of the trie each compiled node stands for, whose children become
+  // its own. That of a merged chain is the last of the chain
+  trie_node **sources = xmalloc(max_nodes * sizeof(trie_node *));
+  // The number of parameters on the path to each compiled node
+  unsigned int *depths = xmalloc(max_nodes * sizeof(unsigned int));
+
+  uint32_t num_nodes = 1;
+  uint32_t num_routes = 0;
+  uint32_t num_params = 0;
+  size_t pool_len = 0;
+
+  radix->nodes[0] = (radix_node){.param_set = NO_PARAM_SET};
+  radix->labels[0] = NULL_TERMINATOR;
+  sources[0] = trie->root;
+  depths[0] = 0;
+
+  // Nodes are compiled in the order they're laid out, breadth-first
+  for (uint32_t i = 0; i < num_nodes; i++) {
+    trie_node *source = sources[i];
+    radix_node *node = &radix->nodes[i];
+
+    if (source->allowed) {
+      radix_route *route = &radix->routes[num_routes];
+      memcpy(route->actions, source->actions, sizeof(route->actions));
+      route->allow = source->allow;
+
+      node->allowed = source->allowed;
+      node->route = num_routes++;
+    }
 
-          return NULL;  // 500
+    unsigned int num_children;
+    trie_node **children = sorted_children(source, &num_children);
+    node->children = num_nodes;
+
+    for (unsigned int j = 0; j < num_children; j++) {
+      trie_node *child = children[j];
+      radix_node *compiled = &radix->nodes[num_nodes];
+      *compiled = (radix_node){.label = pool_len, .param_set = NO_PARAM_SET};
+      depths[num_nodes] = depths[i];
+
+      if (is_param(child)) {
+        char *key = derive_parameter_key(child->label);
+
+        append_label(radix, compiled, &pool_len, key, strlen(key));
+        compiled->first_len = compiled->label_len;
+        param_matcher_init(&radix->params[num_params], child->label,
+                           trie->regex_cache);
+        compiled->param = num_params++;
+        node->num_params++;
+
+        if (++depths[num_nodes] > MAX_ROUTE_PARAMS) {
+          DIE("[trie::%s] route has more than %d parameters\n", __func__,
+              MAX_ROUTE_PARAMS);
         }
 
-        if (!regex_match(re, path)) {
-          // No parameter match
-          result->flags |= NOT_FOUND_MASK;
-          return result;
+        free(key);
+      } else {
+        append_label(radix, compiled, &pool_len, child->label,
+                     strlen(child->label));
+        compiled->first_len = compiled->label_len;
+
+        // A chain of static nodes without routes of their own, each the only
+        // child of the last, is matched as one
+        trie_node *next;
+        while (!child->allowed && (next = only_child(child)) &&
+               !is_param(next)) {
+          append_label(radix, compiled, &pool_len, PATH_DELIMITER, 1);
+          append_label(radix, compiled, &pool_len, next->label,
+                       strlen(next->label));
+          child = next;
         }
 
-        char *param_key = derive_parameter_key(child->label);
-        ht_insert(result->parameters, param_key, path);
+        node->num_static++;
+      }
+
+      pool_len++;
+      sources[num_nodes++] = child;
+    }
+
+    compile_param_set(radix, node, children);
+    free(children);
+  }
 
-        ht_record *next = ht_search(curr->children, child->label);
-        if (!next) {
-          printlogf(YS_LOG_INFO,
-                    "[trie::%s] did not match a route but expected "
-                    "to, where label is %s\n",
-                    __func__, child->label);
+  free(sources);
+  free(depths);
+  radix->num_nodes = num_nodes;
 
-          return NULL;  // 500
+  if (trie->radix) {
+    radix_free(trie->radix);
+  }
+  trie->radix = radix;
+}
+
+/**
+ * find_static returns the static child of `node` whose label begins with the
+ * path segment of `len` bytes at `seg`, or NULL if it has none
+ */
+static const radix_node *find_static(const radix_tree *radix,
+                                     const radix_node *node, const char *seg,
+                                     size_t len) {
+  const radix_node *children = radix->nodes + node->children;
+  size_t lo = 0;
+  size_t hi = node->num_static;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const radix_node *child = &children[mid];
+    size_t first_len = child->first_len;
+
+    int cmp = memcmp(seg, radix->labels + child->label,
+                     len < first_len ? len : first_len);
+    if (cmp == 0) {
+      cmp = (len > first_len) - (len < first_len);
+    }
+
+    if (cmp == 0) {
+      return child;
+    }
+
+    if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * segment_iter iterates over the segments of a path in place, skipping empty
+ * ones such as those of a trailing slash
+ */
+typedef struct {
+  const char *pos;
+  const char *end;
+} segment_iter;
+
+/**
+ * next_segment advances `it` past its next segment, which it stores in `seg`.
+ * Returns false once there are none left
+ */
+static bool next_segment(segment_iter *it, str_view *seg) {
+  while (it->pos < it->end && *it->pos == PATH_DELIMITER[0]) {
+    it->pos++;
+  }
+
+  if (it->pos == it->end) {
+    return false;
+  }
+
+  const char *delim = memchr(it->pos, PATH_DELIMITER[0], it->end - it->pos);
+  seg->ptr = it->pos;
+  seg->len = (delim ? delim : it->end) - it->pos;
+  it->pos += seg->len;
+
+  return true;
+}
+
+/**
+ * match_label matches the label of a static node, whose first segment has
+ * matched the last segment taken from `it`, against those that follow. `it` is
+ * advanced past them only if the whole label matches
+ */
+static bool match_label(const radix_tree *radix, const radix_node *node,
+                        segment_iter *it) {
+  const char *label = radix->labels + node->label;
+  size_t offset = node->first_len;
+  segment_iter next = *it;
+
+  while (offset < node->label_len) {
+    // Skip the delimiter that ends the last segment
+    offset++;
+
+    size_t len = strcspn(label + offset, PATH_DELIMITER);
+
+    str_view seg;
+    if (!next_segment(&next, &seg) || seg.len != len ||
+        memcmp(seg.ptr, label + offset, len) != 0) {
+      return false;
+    }
+
+    offset += len;
+  }
+
+  *it = next;
+  return true;
+}
+
+bool trie_search(route_trie *trie, ys_http_method method,
+                 const char *search_path, size_t len, route_result *result) {
+  const radix_tree *radix = trie->radix;
+  if (!radix) {
+    DIE("[trie::%s] trie searched before it was compiled\n", __func__);
+  }
+
+  result->action = NULL;
+  result->num_params = 0;
+  result->flags = INITIAL_FLAG_STATE;
+  result->allow = NULL;
+
+  // The query string, if present, is left to the caller
+  const char *query = memchr(search_path, '?', len);
+  segment_iter it = {search_path, query ? query : search_path + len};
+
+  const radix_node *curr = radix->nodes;
+  str_view seg;
+  while (next_segment(&it, &seg)) {
+    // Static children take precedence over parameters
+    const radix_node *next = find_static(radix, curr, seg.ptr, seg.len);
+    if (next) {
+      if (!match_label(radix, next, &it)) {
+        result->flags |= NOT_FOUND_MASK;
+        return true;
+      }
+
+      curr = next;
+      continue;
+    }
+
+    const radix_node *params = radix->nodes + curr->children + curr->num_static;
+
+    const param_matcher *matcher = NULL;
+    long long int_value = 0;
+
+    // Parameters left to PCRE may be matched all at once, the first time one
+    // is reached, which gives the first of them that matches
+    const param_set *set = curr->param_set == NO_PARAM_SET
+                               ? NULL
+                               : &radix->param_sets[curr->param_set];
+    int set_match = -1;
+    int num_regexes = 0;
+
+    for (unsigned int j = 0; j < curr->num_params; j++) {
+      matcher = &radix->params[params[j].param];
+      if (matcher->kind == PARAM_REGEX && !matcher->re) {
+        printlogf(YS_LOG_INFO, "[trie::%s] regex was NULL\n", __func__);
+
+        return false;  // 500
+      }
+
+      if (set && matcher->kind == PARAM_REGEX) {
+        if (num_regexes++ == 0) {
+          set_match = param_set_match(set, seg);
+        }
+
+        if (set_match == num_regexes - 1) {
+          next = &params[j];
+          break;
         }
 
-        curr = next->value;
-        is_param_match = true;
+        continue;
+      }
 
+      if (param_match(matcher, seg, &int_value)) {
+        next = &params[j];
         break;
       }
     }
 
     // No parameter match
-    if (!is_param_match) {
+    if (!next) {
       result->flags |= NOT_FOUND_MASK;
-      return result;
+      return true;
     }
-  }
-  array_free(paths);
 
-  if (s_equals(realpath, PATH_ROOT)) {
-    // No matching handler
-    if (curr->actions->count == 0) {
-      result->flags |= NOT_FOUND_MASK;
-      return result;
-    }
+    // trie_compile refuses routes with more parameters than there's room for
+    bool is_int = matcher->kind == PARAM_INT || matcher->kind == PARAM_UINT;
+    result->params[result->num_params++] =
+        (route_param){radix->labels + next->label, seg, is_int, int_value};
+
+    curr = next;
   }
 
-  ht_record *action_record = ht_search(curr->actions, method);
   // No matching handler
-  if (action_record == NULL) {
-    result->flags |= NOT_ALLOWED_MASK;
-    return result;
+  if (curr->allowed == 0) {
+    result->flags |= NOT_FOUND_MASK;
+    return true;
   }
 
-  route_action *next_action = action_record->value;
-  // No matching handler
-  if (next_action == NULL) {
+  if (!(curr->allowed & METHOD_BIT(method))) {
     result->flags |= NOT_ALLOWED_MASK;
-    return result;
+    result->allow = radix->routes[curr->route].allow;
+    return true;
   }
 
-  result->action = next_action;
+  result->action = radix->routes[curr->route].actions[method];
 
-  return result;
+  return true;
 }
@@ -2,10 +2,15 @@
 #define TRIE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "libhash/libhash.h"
 #include "libutil/libutil.h"
+#include "libys.h"
 #include "logger.h"
+#include "param.h"
+#include "util.h"
 
 // Initial state for route result record
 extern const unsigned int INITIAL_FLAG_STATE;
@@ -16,33 +21,118 @@ extern const unsigned int NOT_FOUND_MASK;
 // Route not allowed flag
 extern const unsigned int NOT_ALLOWED_MASK;
 
+// The number of slots in a table indexed by ys_http_method, where slot 0 stands
+// for any method the server doesn't know
+#define NUM_METHODS (YS_METHOD_TRACE + 1)
+
+// METHOD_BIT is the bit standing for `method` in a set of methods
+#define METHOD_BIT(method) (1u << (method))
+
+// The param_set index of a compiled node without one
+#define NO_PARAM_SET UINT32_MAX
+
+// The most parameters a route may capture
+#define MAX_ROUTE_PARAMS 8
+
 typedef void *generic_handler(void *, void *);
 
+/**
+ * route_param is a parameter captured from a request's path. Its key belongs to
+ * the trie, and its value is a view of the path searched
+ */
+typedef struct {
+  const char *key;
+  str_view value;
+  // Whether the parameter is of an integer type, and if so its value
+  bool is_int;
+  long long int_value;
+} route_param;
+
+// Stores a route's handler
+typedef struct {
+  generic_handler *handler;
+  // ys_route_flag bits the route was registered with
+  unsigned int flags;
+  // The largest request body the route accepts, or 0 for the default
+  size_t max_body_size;
+} route_action;
+
 typedef struct {
   char *label;
   hash_table *children;
-  hash_table *actions;
+  // The node's actions, indexed by ys_http_method, the set of methods that
+  // have one, and that set as the value of an Allow header
+  route_action *actions[NUM_METHODS];
+  unsigned int allowed;
+  char *allow;
+  // The order in which the node was inserted, among all of the trie's nodes
+  unsigned int index;
 } trie_node;
 
-// A trie data structure used for routing
+/**
+ * radix_node is a node of a compiled trie. A static node's label is one or
+ * more path segments, a chain of nodes with a single child apiece having been
+ * merged into one; a parameter node's label is the parameter's key
+ */
+typedef struct {
+  // The label's offset in the tree's label pool, its length, and the length of
+  // its first segment, by which static siblings are sorted
+  uint32_t label;
+  uint16_t label_len;
+  uint16_t first_len;
+  // The index of the node's first child. Its static children come first,
+  // followed by its parameters in the order they were inserted
+  uint32_t children;
+  uint16_t num_static;
+  uint16_t num_params;
+  // The methods the node has actions for, and the index of its route if any
+  uint16_t allowed;
+  uint32_t route;
+  // The index of a parameter node's pattern
+  uint32_t param;
+  // The index of the param_set combining the patterns of the node's parameters
+  // left to PCRE, or NO_PARAM_SET if it has fewer than two
+  uint32_t param_set;
+} radix_node;
+
+// The actions of a compiled node, and the value of its Allow header
+typedef struct {
+  route_action *actions[NUM_METHODS];
+  const char *allow;
+} radix_route;
+
+/**
+ * radix_tree is the read-only form of a trie that it's searched in, its nodes
+ * laid out breadth-first so that each node's children are adjacent
+ */
+typedef struct {
+  radix_node *nodes;
+  uint32_t num_nodes;
+  char *labels;
+  radix_route *routes;
+  // The matcher of each parameter node
+  param_matcher *params;
+  param_set *param_sets;
+  uint32_t num_param_sets;
+} radix_tree;
+
+// A trie data structure used for routing. Routes are inserted into its nodes,
+// which trie_compile then lays out as a radix tree for searching
 typedef struct {
   trie_node *root;
   hash_table *regex_cache;
+  unsigned int num_nodes;
+  radix_tree *radix;
 } route_trie;
 
-// Stores a route's handler
-typedef struct {
-  generic_handler *handler;
-} route_action;
-
 // Trie search result record
 typedef struct {
   route_action *action;
-  // hash_table<char*, char*>
-  hash_table *parameters;
-  // hash_table<char*, hash_set<char*>>
-  hash_table *queries;
+  route_param params[MAX_ROUTE_PARAMS];
+  unsigned int num_params;
   unsigned int flags;
+  // The Allow header value of a path matched under another method
+  const char *allow;
 } route_result;
 
 /**
@@ -51,17 +141,29 @@ typedef struct {
 route_trie *trie_init(void);
 
 /**
- * trie_insert inserts a node into the trie at `path` and each method of
- * `methods`
+ * trie_insert inserts a node into the trie at `path` and each method in the set
+ * `methods` of METHOD_BITs. `flags` and `max_body_size` are stored alongside
+ * the handler
+ */
+void trie_insert(route_trie *trie, unsigned int methods, const char *path,
+                 generic_handler *handler, unsigned int flags,
+                 size_t max_body_size);
+
+/**
+ * trie_compile lays out the routes inserted into the trie as a radix tree,
+ * which trie_search searches. A trie must be compiled again once routes have
+ * been inserted into it, and must not be searched while being compiled
  */
-void trie_insert(route_trie *trie, array_t *methods, const char *path,
-                 generic_handler *handler);
+void trie_compile(route_trie *trie);
 
 /**
- * trie_search searches a trie for a node matching the given method and path and
- * returns a result object, or NULL if not found
+ * trie_search searches a compiled trie for a node matching the given method and
+ * the path of `len` bytes at `search_path`, which need not be NUL-terminated,
+ * and fills in `result`. Any query string is ignored. The parameters captured
+ * are views of `search_path`, which must outlive them. Returns false if the
+ * search failed for want of a parameter's pattern
  */
-route_result *trie_search(route_trie *trie, const char *method,
-                          const char *search_path);
+bool trie_search(route_trie *trie, ys_http_method method,
+                 const char *search_path, size_t len, route_result *result);
 
 #endif /* TRIE_H */
@@ -0,0 +1,213 @@
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "xmalloc.h"
+
+// Ops the uring engine submits, all of which the kernel must support
+static const int REQUIRED_OPS[] = {IORING_OP_ACCEPT, IORING_OP_RECV,
+                                   IORING_OP_SEND,   IORING_OP_READ,
+                                   IORING_OP_CLOSE,  IORING_OP_TIMEOUT,
+                                   IORING_OP_POLL_ADD};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * supports_required_ops probes the kernel for every op in REQUIRED_OPS
+ */
+static bool supports_required_ops(int fd) {
+  size_t len = sizeof(struct io_uring_probe) +
+               IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *probe = xmalloc(len);
+  memset(probe, 0, len);
+
+  bool ok = sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe,
+                                  IORING_OP_LAST) == 0;
+
+  for (size_t i = 0; ok && i < sizeof(REQUIRED_OPS) / sizeof(int); i++) {
+    int op = REQUIRED_OPS[i];
+    ok = op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+  }
+
+  free(probe);
+  return ok;
+}
+
+static void uring_unmap(uring *ring) {
+  if (ring->sqes && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+
+  if (ring->cq_ring && ring->cq_ring != MAP_FAILED &&
+      ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+
+  if (ring->sq_ring && ring->sq_ring != MAP_FAILED) {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+}
+
+uring *uring_init(unsigned entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+
+  int fd = sys_io_uring_setup(entries, &p);
+  if (fd == -1) {
+    printlogf(YS_LOG_DEBUG, "[uring::%s] io_uring_setup failed (%d)\n",
+              __func__, errno);
+    return NULL;
+  }
+
+  if (!(p.features & IORING_FEAT_NODROP) || !supports_required_ops(fd)) {
+    printlogf(YS_LOG_DEBUG,
+              "[uring::%s] kernel lacks io_uring features required by Ys\n",
+              __func__);
+    close(fd);
+    return NULL;
+  }
+
+  uring *ring = xmalloc(sizeof(uring));
+  memset(ring, 0, sizeof(uring));
+  ring->fd = fd;
+
+  ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size =
+      p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+  // Both rings may share a single mapping
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_size > ring->sq_ring_size) {
+      ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  }
+
+  ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+  if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+    printlogf(YS_LOG_DEBUG, "[uring::%s] failed to map io_uring (%d)\n",
+              __func__, errno);
+    uring_unmap(ring);
+    close(fd);
+    free(ring);
+    return NULL;
+  }
+
+  char *sq = ring->sq_ring;
+  ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+
+  char *cq = ring->cq_ring;
+  ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+  return ring;
+}
+
+struct io_uring_sqe *uring_get_sqe(uring *ring) {
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  unsigned tail = *ring->sq_tail + ring->sq_pending;
+
+  if (tail - head > *ring->sq_mask) {
+    // The queue is full; hand what we have to the kernel to make room
+    if (uring_submit_and_wait(ring, 0) == -1) {
+      return NULL;
+    }
+
+    return uring_get_sqe(ring);
+  }
+
+  unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+
+  ring->sq_array[index] = index;
+  ring->sq_pending++;
+
+  return sqe;
+}
+
+bool uring_reserve(uring *ring, unsigned n) {
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  unsigned used = *ring->sq_tail + ring->sq_pending - head;
+
+  if (*ring->sq_mask + 1 - used >= n) {
+    return true;
+  }
+
+  return uring_submit_and_wait(ring, 0) != -1;
+}
+
+int uring_submit_and_wait(uring *ring, unsigned wait_nr) {
+  // Publish the new entries before the kernel reads the tail
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->sq_pending,
+                   __ATOMIC_RELEASE);
+  ring->sq_pending = 0;
+
+  int ret;
+  do {
+    // Anything the kernel has yet to consume, including entries left over from
+    // an interrupted call
+    unsigned to_submit =
+        *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr,
+                             wait_nr ? IORING_ENTER_GETEVENTS : 0);
+  } while (ret == -1 && errno == EINTR);
+
+  return ret;
+}
+
+struct io_uring_cqe *uring_peek_cqe(uring *ring) {
+  unsigned head = *ring->cq_head;
+
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(uring *ring) {
+  __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* HAVE_IO_URING */
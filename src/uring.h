@@ -0,0 +1,90 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+
+// Every op the uring engine relies on (accept, recv, send, read, close,
+// timeout) is available as of the kernel headers that introduced fast poll
+#ifdef IORING_FEAT_FAST_POLL
+#define HAVE_IO_URING
+#endif
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+/**
+ * uring is a minimal io_uring instance: a submission queue and a completion
+ * queue, both mapped into user space
+ */
+typedef struct uring {
+  int fd;
+
+  // Submission queue
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  // SQEs handed out by uring_get_sqe but not yet submitted to the kernel
+  unsigned sq_pending;
+
+  // Completion queue
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+} uring;
+
+/**
+ * uring_init sets up a new io_uring instance with room for `entries`
+ * submissions. Returns NULL if io_uring is unavailable (e.g. the kernel is too
+ * old, or the syscalls are blocked) or lacks any op the uring engine needs
+ */
+uring *uring_init(unsigned entries);
+
+/**
+ * uring_get_sqe returns a zeroed submission queue entry, submitting pending
+ * entries first if the queue is full
+ */
+struct io_uring_sqe *uring_get_sqe(uring *ring);
+
+/**
+ * uring_reserve ensures at least `n` submission queue entries are free, so that
+ * a chain of linked entries is never split across submissions. Returns false on
+ * error
+ */
+bool uring_reserve(uring *ring, unsigned n);
+
+/**
+ * uring_submit_and_wait submits all pending entries and waits for at least
+ * `wait_nr` completions. Returns -1 on error
+ */
+int uring_submit_and_wait(uring *ring, unsigned wait_nr);
+
+/**
+ * uring_peek_cqe returns the next completion, or NULL if there is none. The
+ * completion must be released with uring_cqe_seen once it has been handled
+ */
+struct io_uring_cqe *uring_peek_cqe(uring *ring);
+
+/**
+ * uring_cqe_seen releases the completion last returned by uring_peek_cqe
+ */
+void uring_cqe_seen(uring *ring);
+
+#endif /* HAVE_IO_URING */
+
+#endif /* URING_H */
@@ -3,108 +3,67 @@
 
 #include "libutil/libutil.h"
 #include "util.h"
+#include "xmalloc.h"
 
 /**
- * unescape unescapes a string `s`
+ * unescape unescapes the `len` bytes of `s` into a new string, or returns NULL
+ * if they hold a malformed escape
  */
-static char* unescape(const char* s) {
-  // % char count
-  int n = 0;
-  bool has_plus = false;
+static char* unescape(const char* s, size_t len) {
+  char* unescaped = xmalloc(len + 1);
+  size_t n = 0;
 
-  for (unsigned int i = 0; i < strlen(s);) {
+  for (size_t i = 0; i < len; i++) {
     switch (s[i]) {
       case '%':
-        n++;
-        if (i + 2 >= strlen(s) || !ishex(s[i + 1]) || !ishex(s[i + 2])) {
-          s = s_substr(s, i, strlen(s), true);
-          if (strlen(s) > 3) {
-            s = s_substr(s, 0, 3, true);
-          }
-
+        if (i + 2 >= len || !ishex(s[i + 1]) || !ishex(s[i + 2])) {
+          free(unescaped);
           return NULL;  // err
         }
 
-        i += 3;
-        break;
-
-      case '+':
-        has_plus = true;
-
-        i++;
-        break;
-
-      default:
-        i++;
-    }
-  }
-
-  if (n == 0 && !has_plus) {
-    return s_copy(s);
-  }
-
-  buffer_t* b = buffer_init(NULL);
-
-  for (unsigned int i = 0; i < strlen(s); i++) {
-    switch (s[i]) {
-      case '%':
-        buffer_append(b, tostr(unhex(s[i + 1]) << 4 | unhex(s[i + 2])));
-
+        unescaped[n++] = unhex(s[i + 1]) << 4 | unhex(s[i + 2]);
         i += 2;
         break;
 
       case '+':
-        buffer_append(b, " ");
-
+        unescaped[n++] = ' ';
         break;
 
       default:
-        buffer_append(b, tostr(s[i]));
+        unescaped[n++] = s[i];
     }
   }
 
-  return buffer_state(b);
+  unescaped[n] = '\0';
+  return unescaped;
 }
 
 hash_table* parse_query(const char* query) {
   hash_table* ht = ht_init(0);
 
   while (!s_nullish(query)) {
-    // Either two key/value statements, or a [path, query]
-    array_t* pair = str_cut(query, "&");
-    if (!pair) {
-      return ht;
-    }
-
-    char* key = array_get(pair, 0);
-    query = array_get(pair, 1);
+    // Each setting runs up to the next ampersand, if there is one
+    const char* setting = query;
+    size_t len = strcspn(setting, "&");
+    query = setting[len] ? setting + len + 1 : NULL;
 
-    if (strchr(key, ';')) {
+    if (memchr(setting, ';', len)) {
       continue;
     }
 
-    if (s_nullish(key)) {
-      continue;
-    }
-
-    array_t* kv_pair = str_cut(key, "=");
-    if (!kv_pair) {
-      return ht;
-    }
-
-    key = array_get(kv_pair, 0);
-    char* value = array_get(kv_pair, 1);
-    if (!value || !key) {
+    const char* eq = memchr(setting, '=', len);
+    if (!eq || eq == setting || eq == setting + len - 1) {
       continue;
     }
 
-    key = unescape(key);
+    char* key = unescape(setting, eq - setting);
     if (!key) {
       continue;
     }
 
-    value = unescape(value);
+    char* value = unescape(eq + 1, setting + len - eq - 1);
     if (!value) {
+      free(key);
       continue;
     }
 
@@ -114,11 +73,26 @@ hash_table* parse_query(const char* query) {
     } else {
       array_push(values, value);
     }
+
+    // The table holds a copy of its own
+    free(key);
   }
 
   return ht;
 }
 
+void query_free(hash_table* queries) {
+  for (int i = 0; i < queries->capacity; i++) {
+    ht_record* query = queries->records[i];
+
+    if (query && query->value) {
+      array_free_ptrs(query->value);
+    }
+  }
+
+  ht_delete_table(queries);
+}
+
 bool has_query_string(const char* url) {
   const char* qmark = strchr(url, '?');
   if (!qmark) {
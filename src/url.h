@@ -18,6 +18,12 @@
  */
 hash_table* parse_query(const char* query);
 
+/**
+ * query_free deallocates a hash table returned by parse_query, along with the
+ * keys and values in it
+ */
+void query_free(hash_table* queries);
+
 /**
  * has_query_string tests whether a string `url` has a valid query string
  * @see
@@ -1,5 +1,6 @@
 #include "util.h"
 
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -10,6 +11,18 @@
 
 const char NULL_TERMINATOR = '\0';
 
+bool view_equals(str_view v, const char *s) {
+  return strlen(s) == v.len && memcmp(v.ptr, s, v.len) == 0;
+}
+
+char *view_copy(str_view v) {
+  char *copy = xmalloc(v.len + 1);
+  memcpy(copy, v.ptr, v.len);
+  copy[v.len] = NULL_TERMINATOR;
+
+  return copy;
+}
+
 char *safe_itoa(int x) {
   int length = snprintf(NULL, 0, "%d", x);
   char *str = xmalloc(length + 1);
@@ -135,3 +148,14 @@ char *tostr(char c) {
 bool is_ascii(char c) { return 0x20 <= c && c < 0x7f; }
 
 bool is_port_in_range(int port) { return port >= 1024 && port < 65535; }
+
+bool set_nonblocking(int fd, bool nonblocking) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1) {
+    return false;
+  }
+
+  flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+
+  return fcntl(fd, F_SETFL, flags) != -1;
+}
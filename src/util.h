@@ -8,6 +8,29 @@
 
 extern const char NULL_TERMINATOR;
 
+/**
+ * str_view refers to `len` bytes of a string it does not own, and which need
+ * not be NUL-terminated, such as part of a request in the connection's read
+ * buffer
+ */
+typedef struct {
+  const char *ptr;
+  size_t len;
+} str_view;
+
+// VIEW_ARGS expands a str_view into the arguments of a "%.*s" conversion
+#define VIEW_ARGS(v) (int)(v).len, (v).ptr
+
+/**
+ * view_equals tests whether the view `v` holds exactly the string `s`
+ */
+bool view_equals(str_view v, const char *s);
+
+/**
+ * view_copy returns a NUL-terminated copy of the view `v`
+ */
+char *view_copy(str_view v);
+
 /**
  * safe_itoa safely converts an int into a string
  */
@@ -64,4 +87,10 @@ bool is_ascii(char c);
  * is_port_in_range tests whether the port is valid and non-reserved
  */
 bool is_port_in_range(int port);
+
+/**
+ * set_nonblocking toggles O_NONBLOCK on the file descriptor `fd`. Returns false
+ * if the descriptor's flags could not be updated
+ */
+bool set_nonblocking(int fd, bool nonblocking);
 #endif /* UTIL_H */
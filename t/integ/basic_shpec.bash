@@ -45,6 +45,83 @@ describe 'libys basic integration tests'
     assert equal "$status" '404 Not Found'
   ti
 
+  it 'sends a file body whole'
+    res="$(curl -s "$SERVER_ADDR/file" | cksum)"
+    assert equal "$(cksum < t/integ/main.c)" "$res"
+  ti
+
+  it 'sets the Content-Type header to application/octet-stream by default for a file body'
+    res="$(curl -s -D - -o /dev/null "$SERVER_ADDR/file" | get_header 'Content-Type')"
+    assert equal 'application/octet-stream' "$res"
+  ti
+
+  it 'serves the files of a mounted directory'
+    res="$(curl -s "$SERVER_ADDR/static/main.c" | cksum)"
+    assert equal "$(cksum < t/integ/main.c)" "$res"
+  ti
+
+  it 'derives the Content-Type of a mounted file from its extension'
+    res="$(curl -s -D - -o /dev/null "$SERVER_ADDR/static/basic_shpec.bash" | get_header 'Content-Type')"
+    assert equal 'application/octet-stream' "$res"
+
+    res="$(curl -s -D - -o /dev/null "$SERVER_ADDR/static/certs/localhost.pem" | get_header 'Content-Type')"
+    assert equal 'application/x-x509-ca-cert' "$res"
+  ti
+
+  it 'returns 304 for a mounted file the client has a current copy of'
+    etag="$(curl -s -D - -o /dev/null "$SERVER_ADDR/static/main.c" | get_header 'ETag')"
+    res="$(curl -s -i "$SERVER_ADDR/static/main.c" -H "If-None-Match: $etag")"
+
+    status="$(get_status <<< "$res")"
+    assert equal "$status" '304 Not Modified'
+  ti
+
+  it 'returns 404 for paths that would escape a mounted directory'
+    res="$(curl -s -i --path-as-is "$SERVER_ADDR/static/../main.c")"
+
+    status="$(get_status <<< "$res")"
+    assert equal "$status" '404 Not Found'
+  ti
+
+  it 'reads a request body larger than the read buffer'
+    res="$(head -c 2000000 /dev/zero | curl -s "$SERVER_ADDR/upload" --data-binary @-)"
+    assert equal "$res" '2000000'
+  ti
+
+  it 'returns 413 for a request body over the route'"'"'s limit'
+    res="$(head -c 5000000 /dev/zero | curl -s -i "$SERVER_ADDR/upload" --data-binary @-)"
+
+    status="$(get_status <<< "$res")"
+    assert equal "$status" '413 Request Entity Too Large'
+  ti
+
+  it 'streams a request body to the handler'
+    res="$(head -c 20000000 /dev/zero | curl -s "$SERVER_ADDR/upload/stream" --data-binary @-)"
+    assert equal "$res" '20000000'
+  ti
+
+  it 'decodes a chunked request body'
+    res="$(head -c 2000000 /dev/zero | curl -s -H 'Transfer-Encoding: chunked' "$SERVER_ADDR/upload" --data-binary @-)"
+    assert equal "$res" '2000000'
+  ti
+
+  it 'streams a chunked request body to the handler'
+    res="$(head -c 20000000 /dev/zero | curl -s -H 'Transfer-Encoding: chunked' "$SERVER_ADDR/upload/stream" --data-binary @-)"
+    assert equal "$res" '20000000'
+  ti
+
+  it 'streams a chunked response body'
+    res="$(curl -s -i "$SERVER_ADDR/export?n=100000")"
+
+    assert equal "$(grep -ci 'Transfer-Encoding: chunked' <<< "$res")" '1'
+    assert equal "$(grep -c '^{"id":' <<< "$res")" '100000'
+  ti
+
+  it 'runs a compute route on the compute pool'
+    res="$(curl -s "$SERVER_ADDR/compute/1000")"
+    assert equal "$res" '500500'
+  ti
+
   it 'handles a request with duplicate headers'
     res="$(curl -s -i "$SERVER_ADDR" -H 'header:v' -H 'header:v2')"
 
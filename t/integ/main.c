@@ -269,6 +269,19 @@ ys_response *meta_handler(ys_request *req, ys_response *res) {
   return res;
 }
 
+ys_response *compute_handler(ys_request *req, ys_response *res) {
+  long long n = 0;
+  ys_req_get_parameter_int(req, "n", &n);
+
+  long long sum = 0;
+  for (long long i = 1; i <= n; i++) {
+    sum += i;
+  }
+
+  ys_set_body(res, "%lld", sum);
+  return res;
+}
+
 ys_response *root_handler(ys_request *req, ys_response *res) {
   ys_set_header(res, "X-Powered-By", "integ-test");
   ys_set_header(res, "X-Not-Exposed", "integ-test");
@@ -280,6 +293,55 @@ ys_response *root_handler(ys_request *req, ys_response *res) {
   return res;
 }
 
+ys_response *file_handler(ys_request *req, ys_response *res) {
+  if (!ys_set_body_file(res, "./t/integ/main.c")) {
+    ys_set_status(res, YS_STATUS_NOT_FOUND);
+    return res;
+  }
+
+  ys_set_status(res, YS_STATUS_OK);
+  return res;
+}
+
+ys_response *upload_handler(ys_request *req, ys_response *res) {
+  ys_set_body(res, "%zu", ys_req_get_body_len(req));
+  return res;
+}
+
+ys_response *upload_stream_handler(ys_request *req, ys_response *res) {
+  char buf[16384];
+  size_t total = 0;
+  ssize_t n;
+
+  while ((n = ys_req_read_body(req, buf, sizeof(buf))) > 0) {
+    total += n;
+  }
+
+  if (n == -1) {
+    ys_set_status(res, YS_STATUS_BAD_REQUEST);
+    return res;
+  }
+
+  ys_set_body(res, "%zu", total);
+  return res;
+}
+
+ys_response *export_handler(ys_request *req, ys_response *res) {
+  char **count = ys_req_get_query(req, "n");
+  int n = count ? atoi(count[0]) : 0;
+  char line[64];
+
+  ys_set_header(res, "Content-Type", "application/x-ndjson");
+  for (int i = 0; i < n; i++) {
+    int len = snprintf(line, sizeof(line), "{\"id\":%d}\n", i);
+    if (!ys_response_write(res, line, len)) {
+      break;
+    }
+  }
+
+  return res;
+}
+
 ys_cors_opts *setup_cors(void) {
   ys_cors_opts *opts = ys_cors_opts_init();
 
@@ -293,6 +355,7 @@ ys_cors_opts *setup_cors(void) {
 
 int main(int argc, char **argv) {
   const char *use_ssl = argc > 0 && s_equals("USE_SSL", argv[1]);
+  const char *use_uring = argc > 0 && s_equals("USE_URING", argv[1]);
 
   records = malloc(sizeof(db_record));
 
@@ -307,6 +370,20 @@ int main(int argc, char **argv) {
 
   ys_router_register(router, "/", root_handler, YS_METHOD_GET);
   ys_router_register(router, "/metadata", meta_handler, YS_METHOD_GET);
+  ys_router_register_with_flags(router, "/compute/:n<uint>", compute_handler,
+                                YS_ROUTE_COMPUTE, YS_METHOD_GET);
+
+  ys_router_register(router, "/file", file_handler, YS_METHOD_GET);
+
+  ys_route_opts upload_opts = {.max_body_size = 4 * 1024 * 1024};
+  ys_router_register_with_opts(router, "/upload", upload_handler,
+                               &upload_opts, YS_METHOD_POST);
+
+  ys_route_opts stream_opts = {.flags = YS_ROUTE_STREAM_BODY};
+  ys_router_register_with_opts(router, "/upload/stream", upload_stream_handler,
+                               &stream_opts, YS_METHOD_POST);
+  ys_router_register(router, "/export", export_handler, YS_METHOD_GET);
+  ys_router_serve_dir(router, "/static", "./t/integ");
 
   ys_router_register(router, record_path, handle_get, YS_METHOD_GET);
   ys_router_register(router, record_path, handle_delete, YS_METHOD_DELETE);
@@ -336,6 +413,10 @@ int main(int argc, char **argv) {
   if (!use_ssl) {
     ys_server_disable_https(srv_attr);
   }
+
+  if (use_uring) {
+    ys_server_set_io_engine(srv_attr, YS_IO_ENGINE_URING);
+  }
   ys_server *server = ys_server_init(srv_attr);
 
   ys_server_start(server);
@@ -0,0 +1,36 @@
+#include "arena.c"
+
+#include <stdint.h>
+
+#include "tap.c/tap.h"
+#include "tests.h"
+
+void test_arena_alloc(void) {
+  arena* a = arena_init();
+
+  char* s = arena_strndup(a, "hello, world", 5);
+  void* p = arena_alloc(a, 3);
+  void* q = arena_alloc(a, 1);
+
+  is(s, "hello", "a copy is NUL-terminated");
+  ok((uintptr_t)p % ARENA_ALIGN == 0 && (uintptr_t)q % ARENA_ALIGN == 0 &&
+         (char*)q - (char*)p == ARENA_ALIGN,
+     "allocations are aligned and taken from the same block");
+
+  char* large = arena_alloc(a, ARENA_BLOCK_SIZE * 2);
+  memset(large, 'x', ARENA_BLOCK_SIZE * 2);
+  ok(a->blocks->cap == ARENA_BLOCK_SIZE * 2 && a->blocks->next != NULL,
+     "an allocation too large for a block gets one of its own");
+
+  arena_block* first = a->blocks->next;
+  arena_reset(a);
+  ok(a->blocks == first && a->blocks->next == NULL && a->blocks->used == 0,
+     "a reset keeps only the first block, emptied");
+
+  ok(arena_alloc(a, 8) == (void*)first->data,
+     "allocations start over after a reset");
+
+  arena_free(a);
+}
+
+void run_arena_tests(void) { test_arena_alloc(); }
@@ -7,7 +7,22 @@ void reset_server_conf(void) {
   server_conf.log_file = NULL;
   server_conf.log_level = DEFAULT_LOG_LEVEL;
   server_conf.threads = DEFAULT_NUM_THREADS;
+  server_conf.queue_size = DEFAULT_QUEUE_SIZE;
+  server_conf.queue_full = QUEUE_FULL_WAIT;
+  server_conf.compute_threads = COMPUTE_THREADS_AUTO;
+  server_conf.reactors = 0;
+  server_conf.cpu_affinity = false;
   server_conf.port = DEFAULT_PORT_NUM;
+  server_conf.keep_alive_timeout = DEFAULT_KEEP_ALIVE_TIMEOUT;
+  server_conf.keep_alive_max_requests = DEFAULT_KEEP_ALIVE_MAX_REQUESTS;
+  server_conf.tls_session_cache_size = DEFAULT_TLS_SESSION_CACHE_SIZE;
+  server_conf.tls_session_timeout = DEFAULT_TLS_SESSION_TIMEOUT;
+  server_conf.tls_session_tickets = true;
+  server_conf.tls_ticket_key_rotation = DEFAULT_TLS_TICKET_KEY_ROTATION;
+  server_conf.tls_handshake_timeout = DEFAULT_TLS_HANDSHAKE_TIMEOUT;
+  server_conf.tls_ktls = false;
+  server_conf.static_cache_size = DEFAULT_STATIC_CACHE_SIZE;
+  server_conf.max_body_size = DEFAULT_MAX_BODY_SIZE;
 }
 
 void test_config_defaults(void) {
@@ -16,6 +31,33 @@ void test_config_defaults(void) {
   ok(server_conf.threads == DEFAULT_NUM_THREADS,
      "default number of threads is set");
   ok(server_conf.port == DEFAULT_PORT_NUM, "default port number is set");
+  ok(server_conf.queue_size == DEFAULT_QUEUE_SIZE,
+     "default queue size is set");
+  ok(server_conf.queue_full == QUEUE_FULL_WAIT,
+     "waits on a full queue by default");
+  ok(server_conf.compute_threads == COMPUTE_THREADS_AUTO,
+     "one compute thread per CPU by default");
+  ok(server_conf.reactors == 0, "per-core reactors are disabled by default");
+  ok(server_conf.cpu_affinity == false, "CPU affinity is disabled by default");
+  ok(server_conf.keep_alive_timeout == DEFAULT_KEEP_ALIVE_TIMEOUT,
+     "default keep-alive timeout is set");
+  ok(server_conf.keep_alive_max_requests == DEFAULT_KEEP_ALIVE_MAX_REQUESTS,
+     "default keep-alive max requests is set");
+  ok(server_conf.tls_session_cache_size == DEFAULT_TLS_SESSION_CACHE_SIZE,
+     "default TLS session cache size is set");
+  ok(server_conf.tls_session_timeout == DEFAULT_TLS_SESSION_TIMEOUT,
+     "default TLS session timeout is set");
+  ok(server_conf.tls_session_tickets == true,
+     "TLS session tickets are enabled by default");
+  ok(server_conf.tls_ticket_key_rotation == DEFAULT_TLS_TICKET_KEY_ROTATION,
+     "default TLS ticket key rotation interval is set");
+  ok(server_conf.tls_handshake_timeout == DEFAULT_TLS_HANDSHAKE_TIMEOUT,
+     "default TLS handshake timeout is set");
+  ok(server_conf.tls_ktls == false, "kTLS is disabled by default");
+  ok(server_conf.static_cache_size == DEFAULT_STATIC_CACHE_SIZE,
+     "default static cache size is set");
+  ok(server_conf.max_body_size == DEFAULT_MAX_BODY_SIZE,
+     "default max body size is set");
 }
 
 void test_parse_config_ok(void) {
@@ -29,6 +71,34 @@ void test_parse_config_ok(void) {
   ok(server_conf.threads == 4,
      "number of threads is what's specified in config");
   ok(server_conf.port == 8000, "port number is what's specified in config");
+  ok(server_conf.queue_size == 64, "queue size is what's specified in config");
+  ok(server_conf.queue_full == QUEUE_FULL_REJECT,
+     "queue full behavior is what's specified in config");
+  ok(server_conf.compute_threads == 2,
+     "number of compute threads is what's specified in config");
+  ok(server_conf.reactors == REACTORS_AUTO,
+     "number of reactors is what's specified in config");
+  ok(server_conf.cpu_affinity == true,
+     "CPU affinity is what's specified in config");
+  ok(server_conf.keep_alive_timeout == 10,
+     "keep-alive timeout is what's specified in config");
+  ok(server_conf.keep_alive_max_requests == 0,
+     "keep-alive max requests is what's specified in config");
+  ok(server_conf.tls_session_cache_size == 0,
+     "TLS session cache size is what's specified in config");
+  ok(server_conf.tls_session_timeout == 600,
+     "TLS session timeout is what's specified in config");
+  ok(server_conf.tls_session_tickets == false,
+     "TLS session tickets setting is what's specified in config");
+  ok(server_conf.tls_ticket_key_rotation == 120,
+     "TLS ticket key rotation interval is what's specified in config");
+  ok(server_conf.tls_handshake_timeout == 3,
+     "TLS handshake timeout is what's specified in config");
+  ok(server_conf.tls_ktls == true, "kTLS setting is what's specified in config");
+  ok(server_conf.static_cache_size == 1048576,
+     "static cache size is what's specified in config");
+  ok(server_conf.max_body_size == 10485760,
+     "max body size is what's specified in config");
 }
 
 void test_parse_config_ok_empty(void) {
@@ -56,7 +56,7 @@ request_internal *toreq(ys_http_method method, array_t *headers) {
   }
 
   request_internal *req = malloc(sizeof(request_internal));
-  req->method = ys_http_method_names[method];
+  req->method = method;
   req->headers = ht;
 
   return req;
@@ -112,7 +112,7 @@ void check_headers(char *test_name, hash_table *actual, array_t *expected) {
 ys_cors_opts *make_opts(array_t *allowed_origins, array_t *allowed_methods,
                         array_t *allowed_headers, array_t *expose_headers,
                         bool allow_credentials) {
-  cors_opts_internal *o = malloc(sizeof(cors_opts_internal));
+  cors_opts_internal *o = calloc(1, sizeof(cors_opts_internal));
   o->allowed_origins = allowed_origins;
   o->allowed_methods = allowed_methods;
   o->allowed_headers = allowed_headers;
@@ -309,7 +309,7 @@ void test_cors_middleware(void) {
 
     // Build mock request
     request_internal *req = &(request_internal){
-        .method = ys_http_method_names[test.method],
+        .method = test.method,
     };
     req->headers = ht_init(0);
 
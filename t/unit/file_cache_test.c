@@ -0,0 +1,170 @@
+#include "file_cache.c"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "tap.c/tap.h"
+#include "tests.h"
+
+// How long to wait for inotify to deliver a change, in 10ms polls
+#define INOTIFY_POLLS 200
+
+static void write_file(const char* dir, const char* name, const char* data) {
+  char* path = fmt_str("%s/%s", dir, name);
+  FILE* fp = fopen(path, "w");
+  fputs(data, fp);
+  fclose(fp);
+  free(path);
+}
+
+static void remove_file(const char* dir, const char* name) {
+  char* path = fmt_str("%s/%s", dir, name);
+  unlink(path);
+  free(path);
+}
+
+/**
+ * open_until opens `path` until the snapshot is `size` bytes long, giving the
+ * inotify thread time to invalidate a stale entry
+ */
+static bool open_until(file_cache* cache, const char* path, bool accept_gzip,
+                       off_t size, cached_file* file) {
+  for (int i = 0; i < INOTIFY_POLLS; i++) {
+    if (!file_cache_open(cache, path, accept_gzip, file)) {
+      return false;
+    }
+
+    close(file->fd);
+    if (file->size == size) {
+      return true;
+    }
+
+    usleep(10000);
+  }
+
+  return false;
+}
+
+void test_file_cache_content_type(void) {
+  ok(file_cache_content_type("css/app.css") == YS_MIME_TYPE_CSS,
+     "the Content-Type is derived from the extension");
+  ok(file_cache_content_type("INDEX.HTML") == YS_MIME_TYPE_HTML,
+     "extensions are matched case-insensitively");
+  ok(file_cache_content_type("v1.2/README") == YS_MIME_TYPE_BIN,
+     "a file without an extension is application/octet-stream");
+}
+
+void test_file_cache_open(void) {
+  char dir[] = "/tmp/ys_file_cache_testXXXXXX";
+  mkdtemp(dir);
+  write_file(dir, "a.txt", "hello");
+
+  file_cache* cache = file_cache_init(dir, 1 << 20);
+  cached_file file;
+
+  ok(file_cache_open(cache, "missing.txt", false, &file) == false,
+     "a missing file can't be opened");
+  ok(file_cache_open(cache, ".", false, &file) == false,
+     "a directory can't be opened");
+
+  ok(file_cache_open(cache, "a.txt", false, &file) == true && file.size == 5 &&
+         file.content_type == YS_MIME_TYPE_TXT && !file.has_gzip,
+     "a file is opened along with its headers");
+
+  char buf[8] = {0};
+  ok(pread(file.fd, buf, sizeof(buf), 0) == 5 && strcmp(buf, "hello") == 0,
+     "the snapshot's fd reads the file");
+  close(file.fd);
+
+  file_cache_open(cache, "a.txt", false, &file);
+  close(file.fd);
+  ok(cache->hits == 1 && cache->misses == 3 && cache->count == 1,
+     "a file is loaded once and then served from the cache");
+
+  char etag[FILE_CACHE_ETAG_LEN];
+  memcpy(etag, file.etag, sizeof(etag));
+
+  file_cache_entry* entry = load_entry(cache, "a.txt");
+  ok(is_fresh(cache, entry) == true, "an unchanged entry is fresh");
+
+  write_file(dir, "a.txt", "hello, world");
+  ok(is_fresh(cache, entry) == false, "a modified file's entry is stale");
+  entry_free(entry);
+
+  ok(open_until(cache, "a.txt", false, 12, &file) == true &&
+         strcmp(file.etag, etag) != 0,
+     "a modified file is reloaded with a new ETag");
+
+  write_file(dir, "a.txt.gz", "gz");
+  ok(open_until(cache, "a.txt", true, 2, &file) == true && file.gzip &&
+         file.has_gzip && file.content_type == YS_MIME_TYPE_TXT,
+     "a new .gz sibling is served to clients that accept gzip");
+  ok(strstr(file.etag, "-gz\"") != NULL,
+     "the .gz sibling has an ETag of its own");
+
+  file_cache_open(cache, "a.txt", false, &file);
+  close(file.fd);
+  ok(file.size == 12 && !file.gzip && file.has_gzip,
+     "the file itself is served to clients that don't accept gzip");
+
+  remove_file(dir, "a.txt.gz");
+  remove_file(dir, "a.txt");
+  bool gone = false;
+  for (int i = 0; i < INOTIFY_POLLS && !gone; i++) {
+    if (!(gone = !file_cache_open(cache, "a.txt", false, &file))) {
+      close(file.fd);
+      usleep(10000);
+    }
+  }
+  ok(gone == true, "a deleted file is no longer served");
+
+  rmdir(dir);
+}
+
+void test_file_cache_eviction(void) {
+  char dir[] = "/tmp/ys_file_cache_testXXXXXX";
+  mkdtemp(dir);
+  write_file(dir, "a", "a");
+  write_file(dir, "b", "b");
+  write_file(dir, "c", "c");
+
+  // Room for two single-page files
+  file_cache* cache = file_cache_init(dir, 2 * FILE_CACHE_PAGE_SIZE);
+  cached_file file;
+
+  file_cache_open(cache, "a", false, &file);
+  close(file.fd);
+  file_cache_open(cache, "b", false, &file);
+  close(file.fd);
+  file_cache_open(cache, "a", false, &file);
+  close(file.fd);
+  file_cache_open(cache, "c", false, &file);
+  close(file.fd);
+
+  ok(cache->count == 2 && cache->evictions == 1 &&
+         cache->bytes <= cache->budget,
+     "the cache stays within its budget");
+  ok(find_entry(cache, "a") && find_entry(cache, "c") &&
+         !find_entry(cache, "b"),
+     "the least recently used file is evicted");
+
+  file_cache* uncached = file_cache_init(dir, 0);
+  ok(file_cache_open(uncached, "a", false, &file) == true &&
+         uncached->count == 0,
+     "files are served uncached when the budget is 0");
+  close(file.fd);
+
+  ok(file_cache_init("/nonexistent/dir", 0) == NULL,
+     "a missing directory can't be cached");
+
+  remove_file(dir, "a");
+  remove_file(dir, "b");
+  remove_file(dir, "c");
+  rmdir(dir);
+}
+
+void run_file_cache_tests(void) {
+  test_file_cache_content_type();
+  test_file_cache_open();
+  test_file_cache_eviction();
+}
@@ -169,6 +169,22 @@ void test_derive_headers(void) {
   array_free(actual);
 }
 
+void test_header_has_token(void) {
+  hash_table *ht = ht_init(0);
+  insert_header(ht, "connection", "Upgrade, Keep-Alive", true);
+
+  ok(header_has_token(ht, CONNECTION, "keep-alive") == true,
+     "matches the header key and token case-insensitively");
+  ok(header_has_token(ht, CONNECTION, "upgrade") == true,
+     "matches any token in a comma-separated list");
+  ok(header_has_token(ht, CONNECTION, "close") == false,
+     "returns false if the token is not present");
+  ok(header_has_token(ht, CONNECTION, "keep") == false,
+     "does not match a partial token");
+  ok(header_has_token(ht, TRANSFER_ENCODING, "chunked") == false,
+     "returns false if the header key does not exist");
+}
+
 void run_header_tests(void) {
   test_token_table();
   test_to_canonical_mime_header_key();
@@ -178,4 +194,5 @@ void run_header_tests(void) {
   test_derive_headers();
 
   test_insert_header();
+  test_header_has_token();
 }
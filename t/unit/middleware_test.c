@@ -85,14 +85,14 @@ void test_ys_add_middleware_with_opts_macro(void) {
   ok(array_size(mh->ignore_paths) == 2,
      "contains only the specified ignore paths");
 
-  ok(regex_match(array_get(mh->ignore_paths, 0), "/ignore1") == true,
+  ok(regex_match(array_get(mh->ignore_paths, 0), "/ignore1", 8) == true,
      "matches on the ignore path");
-  ok(regex_match(array_get(mh->ignore_paths, 0), "/ignore") == false,
+  ok(regex_match(array_get(mh->ignore_paths, 0), "/ignore", 7) == false,
      "does not match on an unspecified path");
 
-  ok(regex_match(array_get(mh->ignore_paths, 1), "/ignore2") == true,
+  ok(regex_match(array_get(mh->ignore_paths, 1), "/ignore2", 8) == true,
      "matches on the ignore path");
-  ok(regex_match(array_get(mh->ignore_paths, 1), "/") == false,
+  ok(regex_match(array_get(mh->ignore_paths, 1), "/", 1) == false,
      "does not match on an unspecified path");
 
   assert_middleware(mh, h2);
@@ -0,0 +1,118 @@
+#include "param.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include "tap.c/tap.h"
+#include "tests.h"
+
+/**
+ * matches tests `value` against a matcher for the parameter labelled `label`
+ */
+static bool matches(const char *label, const char *value) {
+  hash_table *cache = ht_init(0);
+  param_matcher m;
+  long long int_value;
+
+  param_matcher_init(&m, label, cache);
+
+  return param_match(&m, (str_view){value, strlen(value)}, &int_value);
+}
+
+void test_param_matcher_init(void) {
+  hash_table *cache = ht_init(0);
+  param_matcher m;
+
+  param_matcher_init(&m, ":id<uint>", cache);
+  ok(m.kind == PARAM_UINT, "a type is matched natively");
+
+  param_matcher_init(&m, ":id[^\\d+$]", cache);
+  ok(m.kind == PARAM_CLASS,
+     "a pattern equivalent to a type is matched natively");
+
+  param_matcher_init(&m, ":id", cache);
+  ok(m.kind == PARAM_ANY, "a parameter without a pattern matches any segment");
+
+  param_matcher_init(&m, ":id[^x\\d{2}$]", cache);
+  ok(m.kind == PARAM_REGEX && m.re != NULL, "other patterns are left to PCRE");
+}
+
+void test_param_match(void) {
+  ok(matches(":id<int>", "-42") && matches(":id<int>", "7") &&
+         !matches(":id<int>", "4a") && !matches(":id<int>", "-"),
+     "int matches signed decimal integers only");
+  ok(matches(":id<uint>", "42") && !matches(":id<uint>", "-42"),
+     "uint matches unsigned decimal integers only");
+  ok(!matches(":id<int>", "99999999999999999999"),
+     "an integer too large for a long long is no match");
+  ok(matches(":id<uuid>", "123e4567-E89B-12d3-a456-426614174000") &&
+         !matches(":id<uuid>", "123e4567e89b12d3a456426614174000") &&
+         !matches(":id<uuid>", "123e4567-e89b-12d3-a456-42661417400g"),
+     "uuid matches canonical UUIDs only");
+  ok(matches(":id<hex>", "00fF") && !matches(":id<hex>", "0x1"),
+     "hex matches hex digits only");
+  ok(matches(":id<alpha>", "abcXYZ") && !matches(":id<alpha>", "ab1"),
+     "alpha matches letters only");
+  ok(matches(":id<slug>", "my-post-2") && !matches(":id<slug>", "My-Post"),
+     "slug matches lowercase letters, digits and dashes only");
+  ok(matches(":slug[^[a-z0-9-]+$]", "my-post") &&
+         !matches(":slug[^[a-z0-9-]+$]", "my_post"),
+     "a pattern with a bracket expression is matched in full");
+  ok(matches(":id[^x\\d{2}$]", "x12") && !matches(":id[^x\\d{2}$]", "x1"),
+     "patterns left to PCRE are matched with it");
+}
+
+void test_param_parse_int(void) {
+  long long value;
+
+  ok(param_parse_int((str_view){"-9223372036854775808", 20}, true, &value) &&
+         value == LLONG_MIN,
+     "parses the smallest long long");
+  ok(param_parse_int((str_view){"9223372036854775807", 19}, false, &value) &&
+         value == LLONG_MAX,
+     "parses the largest long long");
+  ok(!param_parse_int((str_view){"9223372036854775808", 19}, true, &value),
+     "refuses a value too large for a long long");
+  ok(param_parse_int((str_view){"123/", 3}, false, &value) && value == 123,
+     "parses only the given length");
+}
+
+/**
+ * init_set combines the `len` `patterns` into `set`
+ */
+static bool init_set(param_set *set, char **patterns, unsigned int len) {
+  regex *compiled[len];
+  for (unsigned int i = 0; i < len; i++) {
+    compiled[i] = regex_compile(patterns[i]);
+  }
+
+  return param_set_init(set, patterns, compiled, len);
+}
+
+void test_param_set(void) {
+  param_set set;
+  char *patterns[] = {"^x\\d$", "^\\d{2}$", "^(a)(b)?c$", "^\\d+$"};
+
+  ok(init_set(&set, patterns, 4), "anchored patterns are combined");
+  ok(param_set_match(&set, (str_view){"x1", 2}) == 0 &&
+         param_set_match(&set, (str_view){"ac", 2}) == 2,
+     "the pattern matched is told apart, captures of its own or not");
+  ok(param_set_match(&set, (str_view){"12", 2}) == 1,
+     "the first of the patterns that match is the one matched");
+  ok(param_set_match(&set, (str_view){"zz", 2}) == -1,
+     "a value that matches no pattern matches none");
+
+  char *unanchored[] = {"^x$", "\\d+"};
+  char *alternatives[] = {"^x$", "^a|b$"};
+  char *backreferences[] = {"^x$", "^(a)\\1$"};
+  ok(!init_set(&set, unanchored, 2) && !init_set(&set, alternatives, 2) &&
+         !init_set(&set, backreferences, 2),
+     "patterns that'd match differently in an alternation aren't combined");
+}
+
+void run_param_tests(void) {
+  test_param_matcher_init();
+  test_param_match();
+  test_param_parse_int();
+  test_param_set();
+}
@@ -36,7 +36,10 @@ void test_derive_label_pattern(void) {
       {.name = "EmptyRegex", .input = ":id[]", .expected = NULL},
       {.name = "NoRegex", .input = ":id", .expected = "(.+)"},
       {.name = "LiteralRegex", .input = ":id[xxx]", .expected = "xxx"},
-      {.name = "WildcardRegex", .input = ":id[*]", .expected = "*"}};
+      {.name = "WildcardRegex", .input = ":id[*]", .expected = "*"},
+      {.name = "BracketExpression",
+       .input = ":slug[^[a-z0-9-]+$]",
+       .expected = "^[a-z0-9-]+$"}};
 
   for (int i = 0; i < sizeof(tests) / sizeof(test_case_t); i++) {
     test_case_t test_case = tests[i];
@@ -51,7 +54,8 @@ void test_derive_parameter_key(void) {
       {.name = "BasicKey", .input = ":id[^\\d+$]", .expected = "id"},
       {.name = "BasicKeyEmptyRegex", .input = ":val[]", .expected = "val"},
       {.name = "BasicKeyWildcardRegex", .input = ":ex[(.*)]", .expected = "ex"},
-      {.name = "BasicKeyNoRegex", .input = ":id", .expected = "id"}};
+      {.name = "BasicKeyNoRegex", .input = ":id", .expected = "id"},
+      {.name = "BasicKeyType", .input = ":id<int>", .expected = "id"}};
 
   for (int i = 0; i < sizeof(tests) / sizeof(test_case_t); i++) {
     test_case_t test_case = tests[i];
@@ -61,6 +65,21 @@ void test_derive_parameter_key(void) {
   }
 }
 
+void test_derive_parameter_type(void) {
+  test_case_t tests[] = {
+      {.name = "BasicType", .input = ":id<uuid>", .expected = "uuid"},
+      {.name = "NoType", .input = ":id", .expected = NULL},
+      {.name = "RegexWithAngleBrackets", .input = ":id[<a>]", .expected = NULL},
+      {.name = "UnterminatedType", .input = ":id<int", .expected = NULL}};
+
+  for (int i = 0; i < sizeof(tests) / sizeof(test_case_t); i++) {
+    test_case_t test_case = tests[i];
+
+    char *type = derive_parameter_type(test_case.input);
+    is(type, test_case.expected, test_case.name);
+  }
+}
+
 void test_path_split_first_delim(void) {
   typedef struct {
     char *input;
@@ -159,6 +178,7 @@ void run_path_tests(void) {
 
   test_derive_label_pattern();
   test_derive_parameter_key();
+  test_derive_parameter_type();
 
   test_path_split_first_delim();
   test_path_split_dir();
@@ -1,17 +1,19 @@
 #include "request.c"
 
 #include <stdio.h>
+#include <sys/socket.h>
 
 #include "libys.h"
 #include "tap.c/tap.h"
 #include "tests.h"
 
 static ys_request *make_req(void) {
-  request_internal *req = malloc(sizeof(ys_request));
-  req->parameters = ht_init(0);
+  request_internal *req = calloc(1, sizeof(request_internal));
+  req->conn = client_init(-1, NULL);
 
-  ht_insert(req->parameters, "k1", "v1");
-  ht_insert(req->parameters, "k2", "v2");
+  req->params[0] = (route_param){"k1", {"v1/k2", 2}};
+  req->params[1] = (route_param){"k2", {"v2", 2}};
+  req->num_params = 2;
 
   return (ys_request *)req;
 }
@@ -71,11 +73,28 @@ void test_ys_req_get_parameter(void) {
 }
 
 void test_ys_req_get_parameter_no_param(void) {
-  ys_request *req = malloc(sizeof(ys_request));
+  ys_request *req = calloc(1, sizeof(request_internal));
 
   is(ys_req_get_parameter(req, "k1"), NULL, "returns NULL if no parameters");
 }
 
+void test_ys_req_get_parameter_int(void) {
+  request_internal *req = (request_internal *)make_req();
+  req->params[2] = (route_param){"n", {"-5", 2}};
+  req->params[3] = (route_param){"typed", {"7", 1}, true, 7};
+  req->num_params = 4;
+
+  long long value = 0;
+  ok(ys_req_get_parameter_int((ys_request *)req, "n", &value) && value == -5,
+     "parses an integer parameter");
+  ok(ys_req_get_parameter_int((ys_request *)req, "typed", &value) &&
+         value == 7,
+     "returns the value of an integer-typed parameter");
+  ok(!ys_req_get_parameter_int((ys_request *)req, "k1", &value) &&
+         !ys_req_get_parameter_int((ys_request *)req, "k3", &value),
+     "returns false for a parameter that's no integer or isn't there");
+}
+
 void test_ys_req_num_parameters(void) {
   ys_request *req = make_req();
 
@@ -84,7 +103,7 @@ void test_ys_req_num_parameters(void) {
 }
 
 void test_ys_req_num_parameters_no_param(void) {
-  ys_request *req = malloc(sizeof(ys_request));
+  ys_request *req = calloc(1, sizeof(request_internal));
 
   ok(ys_req_num_parameters(req) == 0,
      "returns the correct number of parameters");
@@ -96,12 +115,433 @@ void test_ys_req_has_parameters(void) {
   ok(ys_req_has_parameters(req) == true,
      "returns true if the request has parameters");
 
-  ys_request *req2 = malloc(sizeof(ys_request));
+  ys_request *req2 = calloc(1, sizeof(request_internal));
 
   ok(ys_req_has_parameters(req2) == false,
      "returns false if the request has no parameters");
 }
 
+static client_context *make_client(const char *buf) {
+  client_context *ctx = client_init(-1, NULL);
+  ctx->buflen = strlen(buf);
+  memcpy(ctx->buf, buf, ctx->buflen + 1);
+
+  return ctx;
+}
+
+void test_req_parse(void) {
+  client_context *ctx = make_client(
+      "POST /path?q=1 HTTP/1.1\r\nHost: localhost\r\nPragma: "
+      "no-cache\r\nContent-Length: 4\r\n\r\nbody");
+
+  maybe_request maybe_req = req_parse(ctx);
+  request_internal *req = maybe_req.req;
+
+  ok(req->method == YS_METHOD_POST && s_equals(req->method_name, "POST"),
+     "parses the request method");
+  ok(view_equals(req->path, "/path?q=1"), "parses the request path");
+  ok(view_equals(req->pure_path, "/path"), "derives the pure path");
+  is(req->body, "body", "parses the request body");
+  is(get_first_header(req->headers, "Host"), "localhost",
+     "parses the request headers");
+  ok(req->minor_version == 1, "parses the protocol version");
+  ok(req->path.ptr == ctx->buf + 5 &&
+         req->body == ctx->buf + ctx->req_len - 4 &&
+         req->raw.ptr == ctx->buf && req->raw.len == ctx->buflen,
+     "refers to the request line and body in the read buffer");
+
+  char *scratch = ys_req_alloc((ys_request *)req, 16);
+  request_free(req);
+  client_reset(ctx);
+  ok(ctx->arena->blocks->used == 0 &&
+         (char *)ctx->arena->blocks->data <= scratch &&
+         scratch < (char *)ctx->arena->blocks->data + ARENA_BLOCK_SIZE,
+     "the request's memory comes from the connection's arena, and is "
+     "released along with it");
+
+  req = req_parse(make_client("BREW /pot HTTP/1.1\r\n\r\n")).req;
+  ok(req->method == 0 && s_equals(req->method_name, "BREW"),
+     "keeps the name of a method it doesn't know");
+}
+
+void test_req_parse_incomplete(void) {
+  client_context *ctx = make_client("GET / HTTP/1.1\r\nHost: local");
+
+  ok(req_parse(ctx).err.code == REQ_INCOMPLETE,
+     "returns REQ_INCOMPLETE when the headers have not been fully read");
+
+  strcat(ctx->buf, "host\r\n\r\n");
+  ctx->buflen = strlen(ctx->buf);
+
+  request_internal *req = req_parse(ctx).req;
+  is(get_first_header(req->headers, "Host"), "localhost",
+     "parses the request once the remaining bytes have been read");
+}
+
+void test_req_parse_invalid(void) {
+  client_context *ctx = make_client("GET / HTTP/1.1\r\n\x01\r\n\r\n");
+
+  ok(req_parse(ctx).err.code == PARSE_ERR,
+     "returns PARSE_ERR for a malformed request");
+
+  ctx = make_client("GET / HTTP/1.1\r\n");
+  memset(ctx->buf + ctx->buflen, 'a', REQ_BUFFER_SIZE - ctx->buflen);
+  ctx->buflen = REQ_BUFFER_SIZE;
+  ctx->buf[ctx->buflen] = NULL_TERMINATOR;
+
+  ok(req_parse(ctx).err.code == REQ_TOO_LONG,
+     "returns REQ_TOO_LONG if the buffer fills before the headers end");
+}
+
+void test_req_parse_keep_alive(void) {
+  ok(req_parse(make_client("GET / HTTP/1.1\r\n\r\n")).req->keep_alive == true,
+     "keeps HTTP/1.1 connections alive by default");
+  ok(req_parse(make_client("GET / HTTP/1.1\r\nConnection: close\r\n\r\n"))
+             .req->keep_alive == false,
+     "closes HTTP/1.1 connections that send Connection: close");
+  ok(req_parse(make_client("GET / HTTP/1.0\r\n\r\n")).req->keep_alive ==
+         false,
+     "closes HTTP/1.0 connections by default");
+  ok(req_parse(make_client(
+                   "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"))
+             .req->keep_alive == true,
+     "keeps HTTP/1.0 connections alive if they send Connection: keep-alive");
+  ok(req_parse(make_client("POST / HTTP/1.1\r\nTransfer-Encoding: "
+                           "chunked\r\nContent-Length: 2\r\n\r\n"
+                           "2\r\nab\r\n0\r\n\r\n"))
+             .req->keep_alive == false,
+     "closes connections whose request is framed by both chunking and a "
+     "Content-Length");
+}
+
+void test_req_parse_incomplete_body(void) {
+  client_context *ctx =
+      make_client("POST / HTTP/1.1\r\nContent-Length: 8\r\n\r\nbody");
+
+  ok(req_parse(ctx).err.code == REQ_INCOMPLETE,
+     "returns REQ_INCOMPLETE when the body has not been fully read");
+
+  strcat(ctx->buf, "body");
+  ctx->buflen = strlen(ctx->buf);
+
+  is(req_parse(ctx).req->body, "bodybody",
+     "parses the request once the remaining body has been read");
+}
+
+void test_req_parse_content_length(void) {
+  ok(req_parse(make_client("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n"))
+             .err.code == BAD_LENGTH &&
+         req_parse(make_client(
+                       "POST / HTTP/1.1\r\nContent-Length: 4x\r\n\r\nbody"))
+                 .err.code == BAD_LENGTH,
+     "returns BAD_LENGTH for a Content-Length that isn't a decimal number");
+  ok(req_parse(make_client("POST / HTTP/1.1\r\nContent-Length: "
+                           "99999999999999999999999\r\n\r\n"))
+             .err.code == BAD_LENGTH,
+     "returns BAD_LENGTH for a Content-Length that overflows");
+  ok(req_parse(make_client("POST / HTTP/1.1\r\nContent-Length: 3\r\n"
+                           "Content-Length: 4\r\n\r\nbody"))
+                 .err.code == BAD_LENGTH &&
+         req_parse(make_client(
+                       "POST / HTTP/1.1\r\nContent-Length: 3, 4\r\n\r\nbody"))
+                 .err.code == BAD_LENGTH,
+     "returns BAD_LENGTH for Content-Lengths that differ");
+
+  request_internal *req =
+      req_parse(make_client("POST / HTTP/1.1\r\nContent-Length: 3, 3\r\n\r\n"
+                            "abc"))
+          .req;
+  ok(req->body_len == 3,
+     "accepts a Content-Length list that repeats the same value");
+
+  req = req_parse(make_client("POST / HTTP/1.1\r\nContent-Length: "
+                              "18446744073709551614\r\n\r\nab"))
+            .req;
+  ok(req->body_len == 2 &&
+         req->body_remaining == 18446744073709551614ULL - 2,
+     "leaves a body too large for the buffer on the connection");
+}
+
+void test_req_parse_pipelined(void) {
+  client_context *ctx = make_client(
+      "POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabcGET /b "
+      "HTTP/1.1\r\n\r\nGET /c HTTP/1.1\r\n");
+
+  request_internal *req = req_parse(ctx).req;
+  ok(view_equals(req->path, "/a"), "parses the first pipelined request");
+  ok(req->body_len == 3 && memcmp(req->body, "abc", 3) == 0,
+     "does not include the pipelined request in the request body");
+
+  client_reset(ctx);
+  req = req_parse(ctx).req;
+  ok(view_equals(req->path, "/b"),
+     "parses the next pipelined request from the leftover bytes");
+  ok(req->keep_alive == true, "keeps the connection alive between them");
+
+  client_reset(ctx);
+  ok(req_parse(ctx).err.code == REQ_INCOMPLETE,
+     "returns REQ_INCOMPLETE for a partially pipelined request");
+  ok(ctx->buflen == strlen("GET /c HTTP/1.1\r\n"),
+     "retains the partial request in the buffer");
+}
+
+/**
+ * make_large_request returns a POST head declaring a body of `len` bytes
+ */
+static char *make_large_request(size_t len) {
+  return fmt_str("POST /upload HTTP/1.1\r\nContent-Length: %zu\r\n\r\n",
+                 len);
+}
+
+void test_req_parse_large_body(void) {
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+  size_t len = 3 * REQ_BUFFER_SIZE;
+  char *body = malloc(len);
+  for (size_t i = 0; i < len; i++) {
+    body[i] = (char)(i % 251);
+  }
+
+  char *head = make_large_request(len);
+  client_context *ctx = make_client(head);
+  ctx->sockfd = fds[0];
+  set_nonblocking(fds[0], true);
+  memcpy(ctx->buf + ctx->buflen, body, 100);
+  ctx->buflen += 100;
+
+  request_internal *req = req_parse(ctx).req;
+  ok(req->body_len == 100 && req->content_len == len &&
+         req->body_remaining == len - 100 && req->keep_alive == true,
+     "leaves a body too large for the read buffer on the connection");
+
+  req_await_body(ctx, req);
+  ok(req_parse(ctx).err.code == REQ_INCOMPLETE,
+     "returns REQ_INCOMPLETE until the whole body has been read");
+
+  write(fds[1], body + 100, len - 100);
+  write(fds[1], "GET / HTTP/1.1\r\n\r\n", 18);
+  req_read(ctx);
+
+  req = req_parse(ctx).req;
+  ok(req->body_len == len && memcmp(req->body, body, len) == 0,
+     "reads the rest of the body into the body buffer");
+  ok(ctx->body_cap <= len, "grows the body buffer no larger than the body");
+
+  char *copy = ys_req_get_body((ys_request *)req);
+  ok(memcmp(copy, body, len) == 0 && ys_req_get_body_len((ys_request *)req) ==
+                                        len,
+     "returns the whole body, NULs included");
+  free(copy);
+
+  client_reset(ctx);
+  ok(ctx->body != NULL && ctx->body_len == 0 && req_read(ctx) == 18 &&
+         ctx->buflen == 18,
+     "keeps a modest body buffer and reads the next request into the buffer");
+
+  close(fds[0]);
+  close(fds[1]);
+  free(head);
+  free(body);
+}
+
+void test_ys_req_read_body(void) {
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+  size_t len = 2 * REQ_BUFFER_SIZE;
+  char *head = make_large_request(len);
+  client_context *ctx = make_client(head);
+  ctx->sockfd = fds[0];
+  set_nonblocking(fds[0], true);
+  memset(ctx->buf + ctx->buflen, 'a', 10);
+  ctx->buflen += 10;
+
+  char *rest = malloc(len - 10);
+  memset(rest, 'b', len - 10);
+  write(fds[1], rest, len - 10);
+  write(fds[1], "GET", 3);
+
+  ys_request *req = (ys_request *)req_parse(ctx).req;
+  char buf[REQ_BUFFER_SIZE];
+
+  ok(ys_req_read_body(req, buf, sizeof(buf)) == 10 && buf[9] == 'a',
+     "reads the part of the body that arrived with the head first");
+
+  size_t total = 10;
+  ssize_t n;
+  while ((n = ys_req_read_body(req, buf, sizeof(buf))) > 0) {
+    total += n;
+  }
+
+  ok(n == 0 && total == len && buf[0] == 'b',
+     "reads the rest of the body from the connection");
+  ok(read(fds[0], buf, sizeof(buf)) == 3,
+     "doesn't read past the end of the body");
+
+  close(fds[1]);
+  req = (ys_request *)req_parse(make_client(head)).req;
+  ((request_internal *)req)->conn->sockfd = fds[0];
+  ok(ys_req_read_body(req, buf, sizeof(buf)) == -1,
+     "fails if the client hangs up partway through the body");
+
+  close(fds[0]);
+  free(head);
+  free(rest);
+}
+
+void test_req_parse_expect_continue(void) {
+  client_context *ctx = make_client(
+      "POST / HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: "
+      "4\r\n\r\n");
+
+  ok(req_parse(ctx).err.code == REQ_EXPECT_CONTINUE,
+     "asks for a 100 Continue when the client awaits one");
+
+  ctx->continued = true;
+  ok(req_parse(ctx).err.code == REQ_INCOMPLETE,
+     "asks for a 100 Continue only once");
+
+  ctx = make_client(
+      "POST / HTTP/1.0\r\nExpect: 100-continue\r\nContent-Length: "
+      "4\r\n\r\n");
+  ok(req_parse(ctx).err.code == REQ_INCOMPLETE,
+     "doesn't send HTTP/1.0 clients a 100 Continue");
+}
+
+void test_req_parse_chunked(void) {
+  client_context *ctx = make_client(
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nbody\r\n"
+      "0\r\n\r\nGET / HTTP/1.1\r\n\r\n");
+  request_internal *req = req_parse(ctx).req;
+
+  ok(req->body_len == 4 && memcmp(req->body, "body", 4) == 0 &&
+         req->content_len == 4 && req->body_remaining == 0,
+     "decodes a chunked body that arrived with the head");
+  ok(req->keep_alive == true && ctx->buflen - ctx->req_len == 18 &&
+         strcmp(ctx->buf + ctx->req_len, "GET / HTTP/1.1\r\n\r\n") == 0,
+     "leaves the request pipelined after a chunked body in the buffer");
+
+  req = req_parse(make_client(
+                      "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, Chunked\r\n"
+                      "Content-Length: 100\r\n\r\n2\r\nab\r\n0\r\n\r\n"))
+            .req;
+  ok(req->chunked == true && req->content_len == 2,
+     "decodes a body whose final coding is chunked, whatever its "
+     "Content-Length");
+
+  ok(req_parse(make_client("POST / HTTP/1.1\r\nTransfer-Encoding: "
+                           "chunked\r\n\r\n4\r\nbodyX\r\n"))
+             .err.code == BAD_CHUNK,
+     "returns BAD_CHUNK if the chunked body is malformed");
+
+  ok(req_parse(make_client("POST / HTTP/1.1\r\nTransfer-Encoding: "
+                           "gzip\r\n\r\nbody"))
+                 .err.code == BAD_ENCODING &&
+         req_parse(make_client("POST / HTTP/1.1\r\nTransfer-Encoding: "
+                               "chunked, gzip\r\nContent-Length: 4\r\n\r\n"
+                               "body"))
+                 .err.code == BAD_ENCODING,
+     "returns BAD_ENCODING if the final transfer coding isn't chunked");
+}
+
+void test_req_parse_chunked_body(void) {
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+  client_context *ctx = make_client(
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n");
+  ctx->sockfd = fds[0];
+  set_nonblocking(fds[0], true);
+
+  request_internal *req = req_parse(ctx).req;
+  ok(req->body_len == 5 && req->body_remaining == BODY_REMAINING_UNKNOWN,
+     "leaves a chunked body without its last chunk on the connection");
+
+  req->max_body_size = 100;
+  req_await_body(ctx, req);
+  ok(req_parse(ctx).err.code == REQ_INCOMPLETE,
+     "returns REQ_INCOMPLETE until the last chunk has been read");
+
+  const char rest[] = "6\r\n world\r\n0\r\n\r\nGET / HTTP/1.1\r\n\r\n";
+  write(fds[1], rest, sizeof(rest) - 1);
+  req_read(ctx);
+
+  req = req_parse(ctx).req;
+  ok(req->body_len == 11 && strcmp(req->body, "hello world") == 0 &&
+         req->content_len == 11,
+     "decodes the rest of the body into the body buffer");
+
+  client_reset(ctx);
+  ok(ctx->buflen == 18 && strncmp(ctx->buf, "GET /", 5) == 0,
+     "hands the request pipelined after the body back to the read buffer");
+
+  ctx = make_client("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+  ctx->sockfd = fds[0];
+  req = req_parse(ctx).req;
+  req->max_body_size = 8;
+  req_await_body(ctx, req);
+
+  write(fds[1], "10\r\n", 4);
+  req_read(ctx);
+  ok(req_parse(ctx).err.code == REQ_TOO_LONG,
+     "refuses a chunk that would take the body over the limit");
+
+  ctx = make_client("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+  ctx->sockfd = fds[0];
+  req_await_body(ctx, req_parse(ctx).req);
+
+  write(fds[1], "2\r\nab\r\nzz\r\n", 11);
+  req_read(ctx);
+  ok(req_parse(ctx).err.code == BAD_CHUNK,
+     "returns BAD_CHUNK if a chunk read later is malformed");
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+void test_ys_req_read_body_chunked(void) {
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+  const char *head =
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n";
+  client_context *ctx = make_client(head);
+  ctx->sockfd = fds[0];
+  set_nonblocking(fds[0], true);
+
+  const char rest[] = "4\r\ndefg\r\n0\r\n\r\nGET";
+  write(fds[1], rest, sizeof(rest) - 1);
+
+  ys_request *req = (ys_request *)req_parse(ctx).req;
+  char buf[REQ_BUFFER_SIZE];
+
+  ok(ys_req_read_body(req, buf, sizeof(buf)) == 3 &&
+         strncmp(buf, "abc", 3) == 0,
+     "reads the chunks that arrived with the head first");
+
+  ssize_t n = ys_req_read_body(req, buf, sizeof(buf));
+  ok(n == 4 && strncmp(buf, "defg", 4) == 0 &&
+         ys_req_read_body(req, buf, sizeof(buf)) == 0,
+     "decodes the rest of the chunks as they're read");
+  ok(ctx->buflen - ctx->req_len == 3 &&
+         ys_req_get_body_len(req) == 7,
+     "hands the bytes after the last chunk back to the read buffer");
+
+  ctx = make_client(head);
+  ctx->sockfd = fds[0];
+  req = (ys_request *)req_parse(ctx).req;
+  ((request_internal *)req)->max_body_size = 5;
+
+  write(fds[1], rest, sizeof(rest) - 1);
+  ys_req_read_body(req, buf, sizeof(buf));
+  ok(ys_req_read_body(req, buf, sizeof(buf)) == -1,
+     "fails if the body grows past the limit");
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
 void run_request_tests(void) {
   test_fix_pragma_cache_control();
   test_fix_pragma_cache_control_has_cache_control();
@@ -110,8 +550,23 @@ void run_request_tests(void) {
   test_ys_req_get_parameter();
   test_ys_req_get_parameter_no_param();
 
+  test_ys_req_get_parameter_int();
   test_ys_req_num_parameters();
   test_ys_req_num_parameters_no_param();
 
   test_ys_req_has_parameters();
+
+  test_req_parse();
+  test_req_parse_incomplete();
+  test_req_parse_invalid();
+  test_req_parse_keep_alive();
+  test_req_parse_incomplete_body();
+  test_req_parse_content_length();
+  test_req_parse_pipelined();
+  test_req_parse_large_body();
+  test_ys_req_read_body();
+  test_req_parse_expect_continue();
+  test_req_parse_chunked();
+  test_req_parse_chunked_body();
+  test_ys_req_read_body_chunked();
 }
@@ -2,26 +2,27 @@
 
 #include <stdarg.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 
 #include "header.h"
 #include "tap.c/tap.h"
 #include "tests.h"
 
 void test_is_2xx_connect(void) {
-  request_internal* req = malloc(sizeof(req));
+  request_internal* req = malloc(sizeof(request_internal));
   response_internal* res = response_init();
 
-  req->method = "CONNECT";
+  req->method = YS_METHOD_CONNECT;
   ys_set_status((ys_response*)res, YS_STATUS_NO_CONTENT);
   ok(is_2xx_connect(req, res) == true,
      "a 204 CONNECT request is a 2xx connect");
 
-  req->method = "CONNECT";
+  req->method = YS_METHOD_CONNECT;
   ys_set_status((ys_response*)res, YS_STATUS_NOT_FOUND);
   ok(is_2xx_connect(req, res) == false,
      "a 404 CONNECT request is not a 2xx connect");
 
-  req->method = "OPTIONS";
+  req->method = YS_METHOD_OPTIONS;
   ys_set_status((ys_response*)res, YS_STATUS_NO_CONTENT);
   ok(is_2xx_connect(req, res) == false,
      "a 204 OPTIONS request is not a 2xx connect");
@@ -47,11 +48,24 @@ void test_is_nocontent(void) {
   ok(is_nocontent(res) == false, "a 200 response is not a no content response");
 }
 
+/**
+ * flatten joins the pieces of a serialized response into one string
+ */
+static char* flatten(serialized_response* out) {
+  buffer_t* buf = buffer_init(NULL);
+  for (size_t i = 0; i < (size_t)out->msg.msg_iovlen; i++) {
+    buffer_append_with(buf, out->msg.msg_iov[i].iov_base,
+                       out->msg.msg_iov[i].iov_len);
+  }
+
+  return buffer_state(buf);
+}
+
 void test_response_serialize(void) {
   typedef struct {
     char* name;
     char* expected;
-    char* method;
+    ys_http_method method;
     char* body;
     int status;
     hash_table* headers;
@@ -63,7 +77,7 @@ void test_response_serialize(void) {
        .headers = to_headers(
            to_header("Vary", array_collect("Origin")),
            to_header("X-Powered-By", array_collect("Unit-Test")), NULL),
-       .method = "GET",
+       .method = YS_METHOD_GET,
        .status = YS_STATUS_OK,
        .expected = "HTTP/1.1 200 OK\r\nVary: Origin\r\nX-Powered-By: "
                    "Unit-Test\r\nContent-Type: text/plain\r\nContent-Length: "
@@ -72,7 +86,7 @@ void test_response_serialize(void) {
       {.name = "MultipleValuesSameHeaderKey",
        .body = "body",
        .status = YS_STATUS_ACCEPTED,
-       .method = "POST",
+       .method = YS_METHOD_POST,
        .headers = to_headers(
            to_header("Vary", array_collect("Origin", "Request-Method", "Etc")),
            NULL),
@@ -83,14 +97,14 @@ void test_response_serialize(void) {
       {.name = "OmitContentLength_For204",
        .body = "body",
        .status = YS_STATUS_NO_CONTENT,
-       .method = "OPTIONS",
+       .method = YS_METHOD_OPTIONS,
        .headers = ht_init(0),
        .expected = "HTTP/1.1 204 No Content\r\n\r\n"},
 
       {.name = "OmitContentLength_ForInformational",
        .body = "test",
        .status = YS_STATUS_SWITCHING_PROTOCOLS,
-       .method = "HEAD",
+       .method = YS_METHOD_HEAD,
        .headers = ht_init(0),
        .expected = "HTTP/1.1 101 Switching Protocols\r\n\r\n"},
 
@@ -99,7 +113,7 @@ void test_response_serialize(void) {
        .headers = to_headers(
            to_header("Vary", array_collect("Origin")),
            to_header("X-Powered-By", array_collect("Unit-Test")), NULL),
-       .method = "GET",
+       .method = YS_METHOD_GET,
        .status = YS_STATUS_OK,
        .expected = "HTTP/1.1 200 OK\r\nVary: Origin\r\nX-Powered-By: "
                    "Unit-Test\r\nContent-Length: 0\r\n\r\n"},
@@ -107,13 +121,13 @@ void test_response_serialize(void) {
       {.name = "NoContentLength_When2xxConnect",
        .body = "body",
        .status = YS_STATUS_NO_CONTENT,
-       .method = "CONNECT",
+       .method = YS_METHOD_CONNECT,
        .headers = ht_init(0),
        .expected = "HTTP/1.1 204 No Content\r\n\r\n"},
       {.name = "AddsTextPlainContentType_WhenGivenBodyAndNotSet",
        .body = "body",
        .status = YS_STATUS_OK,
-       .method = "CONNECT",
+       .method = YS_METHOD_CONNECT,
        .headers = ht_init(0),
        .expected = "HTTP/1.1 200 OK\r\n\r\n"}};
 
@@ -128,13 +142,61 @@ void test_response_serialize(void) {
     ys_set_body((ys_response*)res, test.body);
     ys_set_status((ys_response*)res, test.status);
 
-    char* response = buffer_state(response_serialize(req, res));
+    serialized_response* out = response_serialize(req, res);
+    char* response = flatten(out);
 
     is(response, test.expected,
        "the response string is serialized properly and compliant to RFC 7230");
   }
 }
 
+void test_serialized_response(void) {
+  response_internal* res = response_init();
+  ys_set_body((ys_response*)res, "body");
+
+  serialized_response* out = response_serialize(NULL, res);
+  ok(out->msg.msg_iovlen == 3 && out->iov[2].iov_base == res->body &&
+         strncmp(out->iov[0].iov_base, "HTTP/1.1 200 OK\r\n", 17) == 0,
+     "the status line, headers and body are gathered without copying the "
+     "body");
+
+  size_t len = serialized_response_remaining(out);
+  serialized_response_advance(out, out->iov[0].iov_len + 2);
+  ok(serialized_response_remaining(out) == len - out->iov[0].iov_len - 2 &&
+         out->msg.msg_iovlen == 2,
+     "a partial send advances past the pieces sent");
+
+  serialized_response_advance(out, serialized_response_remaining(out));
+  ok(out->msg.msg_iovlen == 0 && serialized_response_remaining(out) == 0,
+     "nothing remains once the whole response has been sent");
+
+  res->status = 299;
+  out = response_serialize(NULL, res);
+  ok(strcmp(out->iov[0].iov_base, "HTTP/1.1 299 \r\n") == 0,
+     "a status without a name of its own gets a status line");
+}
+
+void test_serialize_head(void) {
+  char digits[UINT_DIGITS_MAX + 1];
+  ok(format_uint(digits, 0) == 1 && strcmp(digits, "0") == 0 &&
+         format_uint(digits, 18446744073709551615ULL) == 20 &&
+         strcmp(digits, "18446744073709551615") == 0,
+     "integers are formatted in full");
+
+  response_internal* res = response_init();
+  ys_set_header((ys_response*)res, "X-Multi", "a");
+  ys_set_header((ys_response*)res, "X-Multi", "b");
+
+  header_line extra[] = {{CONTENT_LENGTH, "12"}};
+  serialized_response* out = serialize_head(res, extra, 1);
+  ok(out->head_len == strlen(out->head) &&
+         strstr(out->head, "X-Multi: a, b\r\n") != NULL &&
+         strstr(out->head, "Content-Length: 12\r\n\r\n") ==
+             out->head + out->head_len - 22,
+     "the head is written into exactly the room it takes");
+  serialized_response_free(out);
+}
+
 void ys_set_body_test(void) {
   response_internal* res = response_init();
 
@@ -143,12 +205,201 @@ void ys_set_body_test(void) {
   is(res->body, "test - xtestx\ncookie - x\t cookie\t x \t\t20\n");
 }
 
+void ys_set_body_file_test(void) {
+  // Binary contents, with NULs that a string body would truncate at
+  const char contents[] = {'y', 's', '\0', '\x01', '\0', '\xff', 'z'};
+
+  char path[] = "/tmp/ys_response_testXXXXXX";
+  int fd = mkstemp(path);
+  write(fd, contents, sizeof(contents));
+  close(fd);
+
+  response_internal* res = response_init();
+  ok(ys_set_body_file((ys_response*)res, path) == true,
+     "a regular file can be set as the body");
+  ok(res->body_len == sizeof(contents), "the body length is the file's size");
+
+  char* serialized = flatten(response_serialize(NULL, res));
+  ok(strstr(serialized, "Content-Length: 7\r\n") != NULL,
+     "the Content-Length is the file's size");
+  ok(strstr(serialized, "Content-Type: application/octet-stream\r\n") != NULL,
+     "a file body's Content-Type defaults to application/octet-stream");
+
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+  client_context* ctx = client_init(fds[0], NULL);
+  ctx->keep_alive = true;
+  ctx->out_fd = res->body_fd;
+  ctx->out_fd_remaining = res->body_len;
+  res->body_fd = -1;
+
+  serialized_response* head = serialized_response_init(5);
+  memcpy(head->head, "head:", 5);
+  push_iov(head, head->head, 5);
+  response_send(ctx, head);
+
+  char received[32] = {0};
+  ssize_t n = read(fds[1], received, sizeof(received));
+  ok(n == 5 + sizeof(contents) &&
+         memcmp(received + 5, contents, sizeof(contents)) == 0,
+     "the file is sent whole after the headers, NULs included");
+  ok(ctx->out_fd == -1, "the file is closed once it has been sent");
+
+  client_close(ctx);
+  close(fds[1]);
+
+  ok(ys_set_body_file((ys_response*)res, "/tmp") == false,
+     "a directory can't be set as the body");
+  ok(ys_set_body_file((ys_response*)res, "/nonexistent/file") == false,
+     "a missing file can't be set as the body");
+
+  unlink(path);
+}
+
+/**
+ * drain reads whatever has been sent to `fd` into `buf`, NUL-terminated
+ */
+static size_t drain(int fd, char* buf, size_t cap) {
+  size_t len = 0;
+  ssize_t n;
+
+  while (len < cap - 1 &&
+         (n = recv(fd, buf + len, cap - 1 - len, MSG_DONTWAIT)) > 0) {
+    len += n;
+  }
+
+  buf[len] = '\0';
+  return len;
+}
+
+/**
+ * make_stream returns a response to a request over `ctx` in HTTP/1.`minor`
+ */
+static response_internal* make_stream(client_context* ctx, int minor) {
+  request_internal* req = calloc(1, sizeof(request_internal));
+  req->method = YS_METHOD_GET;
+  req->minor_version = minor;
+  req->headers = ht_init(0);
+  req->conn = ctx;
+
+  response_internal* res = response_init();
+  res->req = req;
+  ctx->keep_alive = true;
+
+  return res;
+}
+
+void ys_response_stream_test(void) {
+  int fds[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  client_context* ctx = client_init(fds[0], NULL);
+
+  size_t cap = 64 * 1024;
+  char* received = malloc(cap);
+  char* large = malloc(STREAM_BUFFER_SIZE + 1);
+  memset(large, 'x', STREAM_BUFFER_SIZE + 1);
+
+  response_internal* res = make_stream(ctx, 1);
+  ys_response* r = (ys_response*)res;
+
+  ok(ys_response_write(r, "hello", 5) == true, "a write begins the response");
+  drain(fds[1], received, cap);
+  ok(strstr(received, "Transfer-Encoding: chunked\r\n") != NULL &&
+         strstr(received, "Content-Length") == NULL &&
+         strstr(received, "hello") == NULL,
+     "the head is sent at once and small writes are gathered");
+
+  ys_response_write(r, large, STREAM_BUFFER_SIZE + 1);
+  ys_response_write(r, ", world", 7);
+  ok(ys_response_end(r) == true && ys_response_write(r, "!", 1) == false,
+     "nothing may be written once the body has ended");
+
+  size_t len = drain(fds[1], received, cap);
+  struct phr_chunked_decoder decoder = {.consume_trailer = 1};
+  ok(phr_decode_chunked(&decoder, received, &len) == 0 &&
+         len == STREAM_BUFFER_SIZE + 13 &&
+         strncmp(received, "hellox", 6) == 0 &&
+         strncmp(received + len - 8, "x, world", 8) == 0,
+     "the body is sent as well-formed chunks, ending with the last chunk");
+  ok(ctx->keep_alive == true, "a chunked body leaves the connection open");
+  response_stream_finish(res);
+
+  res = make_stream(ctx, 1);
+  r = (ys_response*)res;
+  ys_response_begin(r, 3);
+  ok(ys_response_write(r, "abcd", 4) == false &&
+         ys_response_write(r, "abc", 3) == true && ys_response_end(r) == true,
+     "a body of a given length can't be written past it");
+
+  drain(fds[1], received, cap);
+  ok(strstr(received, "Content-Length: 3\r\n\r\nabc") != NULL &&
+         strstr(received, "chunked") == NULL,
+     "a body of a given length isn't chunked");
+  response_stream_finish(res);
+
+  res = make_stream(ctx, 1);
+  r = (ys_response*)res;
+  ys_response_begin(r, 5);
+  ys_response_write(r, "ab", 2);
+  ok(ys_response_end(r) == false && ctx->keep_alive == false,
+     "a body cut short of its length closes the connection");
+  response_stream_finish(res);
+  drain(fds[1], received, cap);
+
+  res = make_stream(ctx, 0);
+  r = (ys_response*)res;
+  ys_response_write(r, "abc", 3);
+  response_stream_finish(res);
+
+  drain(fds[1], received, cap);
+  ok(strstr(received, "Connection: close\r\n") != NULL &&
+         strstr(received, "\r\n\r\nabc") != NULL &&
+         ctx->keep_alive == false,
+     "an HTTP/1.0 client is sent the body until the connection closes");
+
+  res = make_stream(ctx, 1);
+  res->req->method = YS_METHOD_HEAD;
+  r = (ys_response*)res;
+  ys_response_begin(r, 3);
+  ok(ys_response_write(r, "abc", 3) == true && ys_response_flush(r) == true &&
+         ys_response_end(r) == true,
+     "a body streamed in response to HEAD may be written");
+
+  drain(fds[1], received, cap);
+  ok(strstr(received, "Content-Length: 3\r\n") != NULL &&
+         strstr(received, "abc") == NULL && ctx->keep_alive == true,
+     "a response to HEAD keeps its Content-Length but not its body");
+  response_stream_finish(res);
+
+  res = make_stream(ctx, 1);
+  res->req->method = YS_METHOD_HEAD;
+  r = (ys_response*)res;
+  ys_response_write(r, large, STREAM_BUFFER_SIZE + 1);
+  response_stream_finish(res);
+
+  size_t head_len = drain(fds[1], received, cap);
+  ok(strstr(received, "chunked") == NULL &&
+         strcmp(received + head_len - 4, "\r\n\r\n") == 0 &&
+         ctx->keep_alive == true,
+     "a response to HEAD of unknown length is sent no chunks");
+
+  client_close(ctx);
+  close(fds[1]);
+  free(received);
+  free(large);
+}
+
 void run_response_tests(void) {
   test_is_2xx_connect();
   test_is_informational();
   test_is_nocontent();
 
   test_response_serialize();
+  test_serialized_response();
+  test_serialize_head();
 
   ys_set_body_test();
+  ys_set_body_file_test();
+  ys_response_stream_test();
 }
@@ -0,0 +1,221 @@
+#include "static.c"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "tap.c/tap.h"
+#include "tests.h"
+
+static void write_file(const char* dir, const char* name, const char* data) {
+  char* path = fmt_str("%s/%s", dir, name);
+  FILE* fp = fopen(path, "w");
+  fputs(data, fp);
+  fclose(fp);
+  free(path);
+}
+
+static void remove_file(const char* dir, const char* name) {
+  char* path = fmt_str("%s/%s", dir, name);
+  unlink(path);
+  free(path);
+}
+
+/**
+ * to_request builds a request for `path`, with the header `key` if not NULL
+ */
+static request_internal* to_request(ys_http_method method, const char* path,
+                                    const char* key, const char* value) {
+  static client_context* conn;
+  if (!conn) {
+    conn = client_init(-1, NULL);
+  }
+
+  request_internal* req = malloc(sizeof(request_internal));
+  req->conn = conn;
+  req->method = method;
+  req->route_path = (str_view){path, strlen(path)};
+  req->headers = ht_init(0);
+
+  if (key) {
+    insert_header(req->headers, key, value, true);
+  }
+
+  return req;
+}
+
+/**
+ * serve runs static_serve against a fresh response, which it leaves in `res`
+ */
+static bool serve(static_mount* mount, request_internal* req,
+                  response_internal** res) {
+  *res = response_init();
+  bool served = static_serve(mount, req, *res);
+
+  free(req);
+
+  return served;
+}
+
+void test_decode_path(void) {
+  char* decoded = decode_path("css/a%20b.css?", 13);
+  is(decoded, "css/a b.css", "percent-encoded bytes are decoded");
+  free(decoded);
+
+  decoded = decode_path("docs/", 5);
+  is(decoded, "docs/index.html", "a directory maps to its index file");
+  free(decoded);
+
+  ok(decode_path("a/../b", 6) == NULL && decode_path("%2e%2e/b", 8) == NULL,
+     "a .. segment is refused, encoded or not");
+  ok(decode_path("a%00b", 5) == NULL && decode_path("a%2", 3) == NULL,
+     "an encoded NUL or truncated escape is refused");
+  ok(decode_path("%2Fetc/passwd", 13) == NULL &&
+         decode_path("a%5Cb", 5) == NULL,
+     "an encoded leading slash or backslash is refused");
+}
+
+void test_accepts_gzip(void) {
+  request_internal* req =
+      to_request(YS_METHOD_GET, "/", "accept-encoding", "br, gzip");
+  ok(accepts_gzip(req) == true, "gzip is accepted by name");
+
+  req = to_request(YS_METHOD_GET, "/", "Accept-Encoding", "gzip;q=0, *");
+  ok(accepts_gzip(req) == false, "gzip is refused with a quality of 0");
+
+  req = to_request(YS_METHOD_GET, "/", "Accept-Encoding", "*;q=0.5");
+  ok(accepts_gzip(req) == true, "gzip is accepted by a wildcard");
+
+  req = to_request(YS_METHOD_GET, "/", NULL, NULL);
+  ok(accepts_gzip(req) == false, "gzip isn't presumed");
+}
+
+void test_static_serve(void) {
+  char dir[] = "/tmp/ys_static_testXXXXXX";
+  mkdtemp(dir);
+  write_file(dir, "index.html", "<p>hi</p>");
+  write_file(dir, "app.js", "let a = 1;");
+  write_file(dir, "app.js.gz", "gz");
+
+  static_mount* mount = static_mount_init("/static/", dir);
+  response_internal* res;
+
+  ok(serve(mount, to_request(YS_METHOD_GET, "/static/app.js", NULL, NULL),
+           &res) &&
+         res->status == YS_STATUS_OK && res->body_len == 10 &&
+         s_equals(get_first_header(res->headers, CONTENT_TYPE),
+                  YS_MIME_TYPE_JS),
+     "a file is served beneath the mount's prefix");
+  ok(get_first_header(res->headers, "ETag") &&
+         get_first_header(res->headers, "Last-Modified") &&
+         s_equals(get_first_header(res->headers, "Vary"), "Accept-Encoding"),
+     "the file's validators are set");
+  response_clear_body(res);
+
+  ok(serve(mount, to_request(YS_METHOD_GET, "/static/?q", NULL, NULL), &res) &&
+         res->body_len == 9,
+     "the index file is served for the mount's root");
+  response_clear_body(res);
+
+  ok(serve(mount, to_request(YS_METHOD_GET, "/static/app.js", "Accept-Encoding",
+                             "gzip"),
+           &res) &&
+         res->body_len == 2 &&
+         s_equals(get_first_header(res->headers, "Content-Encoding"), "gzip"),
+     "the .gz sibling is served to clients that accept gzip");
+  response_clear_body(res);
+
+  ok(!serve(mount, to_request(YS_METHOD_GET, "/staticfoo", NULL, NULL), &res) &&
+         !serve(mount, to_request(YS_METHOD_GET, "/static/nope.js", NULL, NULL),
+                &res),
+     "requests outside the prefix or for missing files aren't served");
+
+  char outside[] = "/tmp/ys_static_outsideXXXXXX";
+  mkdtemp(outside);
+  write_file(outside, "secret.txt", "secret");
+  char* secret = fmt_str("%s/secret.txt", outside);
+  char* link = fmt_str("%s/link.txt", dir);
+  symlink(secret, link);
+
+  ok(!serve(mount,
+            to_request(YS_METHOD_GET, "/static/%2Fetc/passwd", NULL, NULL),
+            &res) &&
+         !serve(mount,
+                to_request(YS_METHOD_GET, "/static/%2e%2e/etc/passwd", NULL,
+                           NULL),
+                &res),
+     "an encoded slash or .. can't escape the mount");
+  ok(!serve(mount, to_request(YS_METHOD_GET, "/static/link.txt", NULL, NULL),
+            &res),
+     "a symlink can't escape the mount");
+
+  unlink(link);
+  remove_file(outside, "secret.txt");
+  rmdir(outside);
+  free(link);
+  free(secret);
+
+  serve(mount, to_request(YS_METHOD_GET, "/static/index.html", NULL, NULL),
+        &res);
+  char* etag = get_first_header(res->headers, "ETag");
+  char* last_modified = get_first_header(res->headers, "Last-Modified");
+  response_clear_body(res);
+
+  ok(serve(mount,
+           to_request(YS_METHOD_GET, "/static/index.html", "If-None-Match",
+                      etag),
+           &res) &&
+         res->status == YS_STATUS_NOT_MODIFIED && res->body_fd == -1,
+     "a matching If-None-Match gets a 304");
+
+  ok(serve(mount,
+           to_request(YS_METHOD_GET, "/static/index.html", "If-Modified-Since",
+                      last_modified),
+           &res) &&
+         res->status == YS_STATUS_NOT_MODIFIED,
+     "an If-Modified-Since as of the last modification gets a 304");
+
+  ok(serve(mount,
+           to_request(YS_METHOD_GET, "/static/index.html", "If-None-Match",
+                      "\"stale\""),
+           &res) &&
+         res->status == YS_STATUS_OK,
+     "a stale If-None-Match gets the file");
+  response_clear_body(res);
+
+  ok(serve(mount, to_request(YS_METHOD_POST, "/static/index.html", NULL, NULL),
+           &res) &&
+         res->status == YS_STATUS_YS_METHOD_NOT_ALLOWED &&
+         s_equals(get_first_header(res->headers, "Allow"), "GET, HEAD"),
+     "methods other than GET and HEAD get a 405");
+
+  request_internal* head =
+      to_request(YS_METHOD_HEAD, "/static/index.html", NULL, NULL);
+  res = response_init();
+  ok(static_serve(mount, head, res) && res->status == YS_STATUS_OK &&
+         get_first_header(res->headers, "ETag"),
+     "HEAD is served the file's headers");
+
+  serialized_response* out = response_serialize(head, res);
+  ok(strstr(out->head, "Content-Length: 9") && res->body_fd == -1 &&
+         serialized_response_remaining(out) ==
+             strlen(out->msg.msg_iov[0].iov_base) + out->head_len,
+     "HEAD gets the file's Content-Length but not its body");
+  serialized_response_free(out);
+  free(head);
+
+  res->status = YS_STATUS_NOT_MODIFIED;
+  char* serialized = response_serialize(NULL, res)->head;
+  ok(strstr(serialized, "Content-Length") == NULL,
+     "a 304 has no Content-Length");
+
+  remove_file(dir, "index.html");
+  remove_file(dir, "app.js");
+  remove_file(dir, "app.js.gz");
+  rmdir(dir);
+}
+
+void run_static_tests(void) {
+  test_decode_path();
+  test_accepts_gzip();
+  test_static_serve();
+}
@@ -0,0 +1,42 @@
+#include "tls.h"
+
+#include <string.h>
+
+#include "tap.c/tap.h"
+#include "tests.h"
+
+void test_tls_ticket_keys_rotate(void) {
+  tls_ticket_keys tickets;
+  tls_ticket_key key;
+
+  ok(tls_ticket_keys_init(&tickets, 60, 1000) == true,
+     "generates the first ticket key");
+
+  tls_ticket_key first = tickets.keys[0];
+  ok(tls_ticket_keys_find(&tickets, first.name, &key) == 0,
+     "finds the current key by name");
+  ok(memcmp(key.aes_key, first.aes_key, TLS_TICKET_SECRET_LEN) == 0,
+     "copies out the key's secrets");
+
+  ok(tls_ticket_keys_rotate(&tickets, 1059) == false,
+     "does not rotate the key before the interval elapses");
+  ok(tls_ticket_keys_rotate(&tickets, 1060) == true,
+     "rotates the key once the interval elapses");
+
+  tls_ticket_key second = tickets.keys[0];
+  ok(memcmp(second.name, first.name, TLS_TICKET_KEY_NAME_LEN) != 0,
+     "the new key has a new name");
+  ok(tls_ticket_keys_find(&tickets, second.name, &key) == 0,
+     "the new key is current");
+  ok(tls_ticket_keys_find(&tickets, first.name, &key) == 1,
+     "the retired key still decrypts tickets");
+
+  ok(tls_ticket_keys_rotate(&tickets, 1120) == true,
+     "rotates the key again after another interval");
+  ok(tls_ticket_keys_find(&tickets, second.name, &key) == 1,
+     "the previous key is retired");
+  ok(tls_ticket_keys_find(&tickets, first.name, &key) == -1,
+     "the oldest key is discarded");
+}
+
+void run_tls_tests(void) { test_tls_ticket_keys_rotate(); }
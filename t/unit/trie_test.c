@@ -1,13 +1,17 @@
 #include "trie.h"
 
+#include "arena.h"
 #include "libutil/libutil.h"
 #include "path.h"
 #include "router.h"
 #include "tap.c/tap.h"
 #include "tests.h"
 
+// Backs the results of the trie searches
+static arena *test_arena;
+
 typedef struct {
-  const char *method;
+  ys_http_method method;
   const char *path;
 } search_query;
 
@@ -17,13 +21,13 @@ typedef struct {
   const unsigned int expected_flag;
 } test_case;
 
-array_t *collect_methods(ys_http_method method, ...) {
-  array_t *methods = array_init();
+unsigned int collect_methods(ys_http_method method, ...) {
+  unsigned int methods = 0;
   va_list args;
   va_start(args, method);
 
   while (method != 0) {
-    array_push(methods, s_copy(ys_http_method_names[method]));
+    methods |= METHOD_BIT(method);
     method = va_arg(args, ys_http_method);
   }
 
@@ -34,6 +38,17 @@ array_t *collect_methods(ys_http_method method, ...) {
 
 void *test_handler(void *a, void *b) { return NULL; }
 
+/**
+ * search runs trie_search into a result allocated from the test arena, or
+ * returns NULL if the search failed
+ */
+static route_result *search(route_trie *trie, ys_http_method method,
+                            const char *path, size_t len) {
+  route_result *result = arena_alloc(test_arena, sizeof(route_result));
+
+  return trie_search(trie, method, path, len, result) ? result : NULL;
+}
+
 void test_trie_init(void) {
   route_trie *trie;
 
@@ -45,25 +60,25 @@ void test_trie_init(void) {
 void test_trie_insert(void) {
   route_record records[] = {
       {.path = s_copy(PATH_ROOT),
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = s_copy(PATH_ROOT),
-       .methods = collect_methods(YS_METHOD_GET, YS_METHOD_POST, NULL),
+       .methods = collect_methods(YS_METHOD_GET, YS_METHOD_POST, 0),
        .handler = test_handler},
       {.path = "/test",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path",
-       .methods = collect_methods(YS_METHOD_POST, NULL),
+       .methods = collect_methods(YS_METHOD_POST, 0),
        .handler = test_handler},
       {.path = "/test/path/paths",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/foo/bar",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler}};
 
   route_trie *trie = trie_init();
@@ -71,68 +86,68 @@ void test_trie_insert(void) {
   for (int i = 0; i < sizeof(records) / sizeof(route_record); i++) {
     route_record route = records[i];
 
-    lives_ok({ trie_insert(trie, route.methods, route.path, route.handler); },
-             "inserts the trie node");
-
-    array_free(route.methods);
+    lives_ok(
+        { trie_insert(trie, route.methods, route.path, route.handler, 0, 0); },
+        "inserts the trie node");
   }
 }
 
 void test_trie_search_ok(void) {
   route_record records[] = {
       {.path = s_copy(PATH_ROOT),
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path",
-       .methods = collect_methods(YS_METHOD_POST, NULL),
+       .methods = collect_methods(YS_METHOD_POST, 0),
        .handler = test_handler},
       {.path = "/test/path/paths",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path/:id[^\\d+$]",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/foo",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/bar/:id[^\\d+$]/:user[^\\D+$]",
-       .methods = collect_methods(YS_METHOD_POST, NULL),
+       .methods = collect_methods(YS_METHOD_POST, 0),
        .handler = test_handler},
       {.path = "/:*[(.+)]",
-       .methods = collect_methods(YS_METHOD_OPTIONS, NULL),
+       .methods = collect_methods(YS_METHOD_OPTIONS, 0),
        .handler = test_handler},
       {.path = "/futon",
-       .methods = collect_methods(YS_METHOD_OPTIONS, NULL),
+       .methods = collect_methods(YS_METHOD_OPTIONS, 0),
        .handler = test_handler}};
 
   test_case tests[] = {
-      {.name = "SearchRoot", .search = {.method = "GET", .path = "/"}},
+      {.name = "SearchRoot", .search = {.method = YS_METHOD_GET, .path = "/"}},
       {.name = "SearchTrailingPath",
-       .search = {.method = "GET", .path = "/test/"}},
+       .search = {.method = YS_METHOD_GET, .path = "/test/"}},
       {.name = "SearchWithParams",
-       .search = {.method = "GET", .path = "/test/path/12"}},
+       .search = {.method = YS_METHOD_GET, .path = "/test/path/12"}},
       {.name = "SearchNestedPath",
-       .search = {.method = "GET", .path = "/test/path/paths"}},
+       .search = {.method = YS_METHOD_GET, .path = "/test/path/paths"}},
       {.name = "SearchPartialPath",
-       .search = {.method = "POST", .path = "/test/path"}},
+       .search = {.method = YS_METHOD_POST, .path = "/test/path"}},
       {.name = "SearchPartialPathOtherMethod",
-       .search = {.method = "GET", .path = "/test/path"}},
+       .search = {.method = YS_METHOD_GET, .path = "/test/path"}},
       {.name = "SearchAdditionalBasePath",
-       .search = {.method = "GET", .path = "/foo"}},
+       .search = {.method = YS_METHOD_GET, .path = "/foo"}},
       {.name = "SearchAdditionalBasePathTrailingSlash",
-       .search = {.method = "GET", .path = "/foo/"}},
+       .search = {.method = YS_METHOD_GET, .path = "/foo/"}},
       {.name = "SearchComplexRegex",
-       .search = {.method = "POST", .path = "/bar/123/alice"}},
+       .search = {.method = YS_METHOD_POST, .path = "/bar/123/alice"}},
       {.name = "SearchWildcardRegex",
-       .search = {.method = "OPTIONS", .path = "/wildcard"}},
+       .search = {.method = YS_METHOD_OPTIONS, .path = "/wildcard"}},
       {.name = "WithQueryStringIgnored",
-       .search = {.method = "OPTIONS", .path = "/futon/?ohno=1&heu=2"}}};
+       .search = {.method = YS_METHOD_OPTIONS,
+                  .path = "/futon/?ohno=1&heu=2"}}};
 
   route_trie *trie = trie_init();
 
@@ -140,16 +155,15 @@ void test_trie_search_ok(void) {
 
   for (i = 0; i < sizeof(records) / sizeof(route_record); i++) {
     route_record record = records[i];
-    trie_insert(trie, record.methods, record.path, record.handler);
-
-    array_free(record.methods);
+    trie_insert(trie, record.methods, record.path, record.handler, 0, 0);
   }
+  trie_compile(trie);
 
   for (i = 0; i < sizeof(tests) / sizeof(test_case); i++) {
     test_case test = tests[i];
 
-    route_result *result =
-        trie_search(trie, test.search.method, test.search.path);
+    route_result *result = search(trie, test.search.method, test.search.path,
+                                  strlen(test.search.path));
 
     void *(*h)(void *, void *);
 
@@ -166,42 +180,43 @@ void test_trie_search_ok(void) {
 void test_trie_search_no_match(void) {
   route_record records[] = {
       {.path = s_copy(PATH_ROOT),
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = s_copy(PATH_ROOT),
-       .methods = collect_methods(YS_METHOD_GET, YS_METHOD_POST, NULL),
+       .methods = collect_methods(YS_METHOD_GET, YS_METHOD_POST, 0),
        .handler = test_handler},
       {.path = "/test",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path",
-       .methods = collect_methods(YS_METHOD_POST, NULL),
+       .methods = collect_methods(YS_METHOD_POST, 0),
        .handler = test_handler},
       {.path = "/test/path/paths",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler},
       {.path = "/test/path/:id[^\\d+$]",
-       .methods = collect_methods(YS_METHOD_GET, NULL),
+       .methods = collect_methods(YS_METHOD_GET, 0),
        .handler = test_handler}};
 
-  test_case tests[] = {{.name = "SearchComplexRegex",
-                        .search = {.method = "GET", .path = "/test/path/12/31"},
-                        .expected_flag = NOT_FOUND_MASK},
-                       {.name = "SearchNestedPath",
-                        .search = {.method = "GET", .path = "/test/path/path"},
-                        .expected_flag = NOT_FOUND_MASK},
-                       {.name = "SearchSpaceInPath",
-                        .search = {.method = "POST", .path = "/test/pat h"},
-                        .expected_flag = NOT_FOUND_MASK},
-                       {.name = "SearchNestedPathAlt",
-                        .search = {.method = "GET", .path = "/test/path/world"},
-                        .expected_flag = NOT_FOUND_MASK},
-                       {.name = "SearchMethodNotRegistered",
-                        .search = {.method = "DELETE", .path = "/test/path"},
-                        .expected_flag = NOT_ALLOWED_MASK}};
+  test_case tests[] = {
+      {.name = "SearchComplexRegex",
+       .search = {.method = YS_METHOD_GET, .path = "/test/path/12/31"},
+       .expected_flag = NOT_FOUND_MASK},
+      {.name = "SearchNestedPath",
+       .search = {.method = YS_METHOD_GET, .path = "/test/path/path"},
+       .expected_flag = NOT_FOUND_MASK},
+      {.name = "SearchSpaceInPath",
+       .search = {.method = YS_METHOD_POST, .path = "/test/pat h"},
+       .expected_flag = NOT_FOUND_MASK},
+      {.name = "SearchNestedPathAlt",
+       .search = {.method = YS_METHOD_GET, .path = "/test/path/world"},
+       .expected_flag = NOT_FOUND_MASK},
+      {.name = "SearchMethodNotRegistered",
+       .search = {.method = YS_METHOD_DELETE, .path = "/test/path"},
+       .expected_flag = NOT_ALLOWED_MASK}};
 
   route_trie *trie = trie_init();
 
@@ -209,57 +224,69 @@ void test_trie_search_no_match(void) {
 
   for (i = 0; i < sizeof(records) / sizeof(route_record); i++) {
     route_record record = records[i];
-    trie_insert(trie, record.methods, record.path, record.handler);
+    trie_insert(trie, record.methods, record.path, record.handler, 0, 0);
   }
+  trie_compile(trie);
 
   for (i = 0; i < sizeof(tests) / sizeof(test_case); i++) {
     test_case test = tests[i];
 
-    route_result *result =
-        trie_search(trie, test.search.method, test.search.path);
+    route_result *result = search(trie, test.search.method, test.search.path,
+                                  strlen(test.search.path));
 
     ok(((result->flags & test.expected_flag) == test.expected_flag),
        "%s test - the record contains the appropriate no match flag",
        test.name);
   }
 
+  route_result *result = search(trie, YS_METHOD_DELETE, "/test/path", 10);
+  is(result->allow, "GET, POST",
+     "a method not allowed gets the methods that are, for an Allow header");
+
+  result = search(trie, 0, "/test/path", 10);
+  ok((result->flags & NOT_ALLOWED_MASK) == NOT_ALLOWED_MASK,
+     "an unknown method is not allowed");
+
   free(trie);
 }
 
 void test_trie_search_ignore_trailing_slash(void) {
   route_trie *trie = trie_init();
 
-  trie_insert(trie, array_collect("GET"), "/foo", test_handler);
-  route_result *r = trie_search(trie, "GET", "/foo/");
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/foo", test_handler, 0, 0);
+  trie_compile(trie);
+  route_result *r = search(trie, YS_METHOD_GET, "/foo/", 5);
   isnt(r, NULL, "trie search ignores trailing slash");
 
   lives_ok({ r->action->handler(NULL, NULL); },
            "TrieSearchIgnoreTrailingSlash - callable handler");
 
-  trie_insert(trie, array_collect("GET"), "/bar/", test_handler);
-  route_result *r2 = trie_search(trie, "GET", "/bar/");
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/bar/", test_handler, 0, 0);
+  trie_compile(trie);
+  route_result *r2 = search(trie, YS_METHOD_GET, "/bar/", 5);
   isnt(r2, NULL, "trie insert ignores trailing slash");
 
   lives_ok({ r2->action->handler(NULL, NULL); },
            "TrieSearchIgnoreTrailingSlash - callable handler");
 
+  route_result *r3 = search(trie, YS_METHOD_GET, "/bar HTTP/1.1", 4);
+  ok(r3 && (r3->flags & NOT_FOUND_MASK) != NOT_FOUND_MASK,
+     "trie search reads only the given length of the path");
+
   free(trie);
 }
 
 void test_trie_search_with_queries(void) {
   route_trie *trie = trie_init();
 
-  trie_insert(trie, array_collect("GET"), "/foo", test_handler);
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/foo", test_handler, 0, 0);
+  trie_compile(trie);
 
-  route_result *r = trie_search(trie, "GET", "/foo/?cookie=1&value=12");
+  route_result *r = search(trie, YS_METHOD_GET, "/foo/?cookie=1&value=12", 23);
 
-  ht_record *rr = ht_search(r->queries, "cookie");
-
-  is(array_get((array_t *)ht_get(r->queries, "cookie"), 0), "1",
-     "stores the query key/value pairs");
-  is(array_get((array_t *)ht_get(r->queries, "value"), 0), "12",
-     "stores the query key/value pairs");
-  ok(r->queries->count, "has only 2 query results");
+  ok(r->action && r->action->handler == test_handler,
+     "the query string is ignored");
+  ok(r->num_params == 0, "a route without parameters captures none");
 
   free(trie);
 }
@@ -267,26 +294,122 @@ void test_trie_search_with_queries(void) {
 void test_trie_search_april2023_bugs(void) {
   route_trie *trie = trie_init();
 
-  trie_insert(trie, array_collect("GET"), "/", test_handler);
-  route_result *r = trie_search(trie, "GET", "/?cookie");
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/", test_handler, 0, 0);
+  trie_compile(trie);
+  route_result *r = search(trie, YS_METHOD_GET, "/?cookie", 8);
 
-  ok(r->queries->count == 0,
-     "query count is zero when invalid query (missing value)");
   ok(r->action->handler == test_handler,
      "returns the root path handler, ignoring the query");
 
-  route_result *r2 = trie_search(trie, "GET", "/?cookie=1&noop&value=2");
-  ok(r2->queries->count == 2,
-     "query count is commensurate with number of valid queries");
+  route_result *r2 = search(trie, YS_METHOD_GET, "/?cookie=1&noop&value=2", 23);
+  ok(r2->action->handler == test_handler,
+     "returns the root path handler, ignoring a query with invalid settings");
+}
+
+void test_trie_insert_flags(void) {
+  route_trie *trie = trie_init();
+
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/heavy", test_handler,
+              YS_ROUTE_COMPUTE, 1024);
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/light", test_handler, 0, 0);
+  trie_compile(trie);
+
+  route_result *r = search(trie, YS_METHOD_GET, "/heavy", 6);
+  ok(r->action->flags == YS_ROUTE_COMPUTE && r->action->max_body_size == 1024,
+     "stores the options the route was registered with");
+
+  route_result *r2 = search(trie, YS_METHOD_GET, "/light", 6);
+  ok(r2->action->flags == 0 && r2->action->max_body_size == 0,
+     "routes have no flags or body limit by default");
+
+  free(trie);
+}
+
+void test_trie_compile(void) {
+  route_trie *trie = trie_init();
+
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/api/v1/users", test_handler, 0,
+              0);
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/files/:name[^\\D+$]",
+              test_handler, 0, 0);
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/files/:rest[(.+)]",
+              test_handler, 0, 0);
+  trie_compile(trie);
+
+  route_result *r = search(trie, YS_METHOD_GET, "/api/v1/users", 13);
+  ok(r->action && r->action->handler == test_handler,
+     "a chain of nodes without routes is matched as one");
+
+  ok(trie->radix->nodes[0].num_static == 2 &&
+         s_equals(trie->radix->labels + trie->radix->nodes[1].label,
+                  "api/v1/users"),
+     "a chain of nodes without routes is compiled into one");
+
+  r = search(trie, YS_METHOD_GET, "/api/v1", 7);
+  ok(r->flags & NOT_FOUND_MASK,
+     "a path ending within a chain matches no route");
+
+  r = search(trie, YS_METHOD_GET, "/files/abc", 10);
+  ok(r->num_params == 1 && s_equals(r->params[0].key, "name") &&
+         view_equals(r->params[0].value, "abc"),
+     "parameters are tried in the order they were inserted");
+
+  r = search(trie, YS_METHOD_GET, "/files/12", 9);
+  ok(r->num_params == 1 && s_equals(r->params[0].key, "rest") &&
+         view_equals(r->params[0].value, "12"),
+     "a parameter is tried when the one before it doesn't match");
+
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/users/:id<int>", test_handler,
+              0, 0);
+  trie_compile(trie);
+
+  r = search(trie, YS_METHOD_GET, "/users/-12", 10);
+  ok(r->num_params == 1 && r->params[0].is_int &&
+         r->params[0].int_value == -12,
+     "an integer parameter is captured along with its value");
+
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/v/:n<uint>", test_handler, 0,
+              0);
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/v/:short[^x\\d{2}$]",
+              test_handler, 0, 0);
+  trie_insert(trie, METHOD_BIT(YS_METHOD_GET), "/v/:long[^x\\d+$]",
+              test_handler, 0, 0);
+  trie_compile(trie);
+
+  bool combined = false;
+  for (uint32_t i = 0; i < trie->radix->num_nodes; i++) {
+    radix_node *node = &trie->radix->nodes[i];
+    combined |= node->num_params == 3 && node->param_set != NO_PARAM_SET;
+  }
+  ok(combined, "the patterns of a node's parameters are combined");
+
+  r = search(trie, YS_METHOD_GET, "/v/x12", 6);
+  ok(s_equals(r->params[0].key, "short"),
+     "of the parameters matched at once, the first inserted is matched");
+
+  r = search(trie, YS_METHOD_GET, "/v/x123", 7);
+  route_result *r2 = search(trie, YS_METHOD_GET, "/v/5", 4);
+  ok(s_equals(r->params[0].key, "long") && s_equals(r2->params[0].key, "n"),
+     "parameters matched at once are tried alongside the others");
+
+  r = search(trie, YS_METHOD_GET, "//api//v1/users/", 16);
+  ok(r->action && r->action->handler == test_handler,
+     "empty path segments are skipped");
 }
 
 void run_trie_tests(void) {
+  test_arena = arena_init();
+
   test_trie_init();
   test_trie_insert();
   test_trie_search_ok();
   test_trie_search_no_match();
   test_trie_search_ignore_trailing_slash();
   test_trie_search_with_queries();
+  test_trie_insert_flags();
+  test_trie_compile();
 
   test_trie_search_april2023_bugs();
+
+  arena_free(test_arena);
 }
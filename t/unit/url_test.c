@@ -74,6 +74,11 @@ void test_parse_query(void) {
        .ok = true},
       {.query = "a=1&b=2;",
        .expected = array_collect(topair("a", array_collect("1"))),
+       .ok = true},
+      {.query = "cookie", .expected = NULL, .ok = false},
+      {.query = "cookie=1&noop&value=2",
+       .expected = array_collect(topair("cookie", array_collect("1")),
+                                 topair("value", array_collect("2"))),
        .ok = true}};
 
   for (unsigned int i = 0; i < sizeof(tests) / sizeof(parse_test); i++) {
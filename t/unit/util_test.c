@@ -1,6 +1,7 @@
 #include "util.h"
 
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "path.h"
@@ -129,6 +130,19 @@ void test_str_contains_ctl_char(void) {
      "detects the control-byte");  // ENQ
 }
 
+void test_view_equals(void) {
+  const char *line = "GET /path HTTP/1.1";
+  str_view path = {line + 4, 5};
+
+  ok(view_equals(path, "/path") == true, "matches the viewed bytes exactly");
+  ok(view_equals(path, "/pat") == false && view_equals(path, "/path ") == false,
+     "does not match a prefix or an extension of the viewed bytes");
+
+  char *copy = view_copy(path);
+  is(copy, "/path", "copies the viewed bytes, NUL-terminated");
+  free(copy);
+}
+
 void test_ishex(void) {
   for (unsigned int i = 0; i < strlen(hex); i++) {
     char c = hex[i];
@@ -160,5 +174,6 @@ void run_util_tests(void) {
   test_str_cut_halfmatch();
 
   test_str_contains_ctl_char();
+  test_view_equals();
   test_ishex();
 }